@@ -0,0 +1,582 @@
+/** @file *//********************************************************************************************************
+
+                                                  zstream_bench.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/bench/zstream_bench.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+//! @file
+//!
+//! Measures the throughput of the stream classes and compares it with calling zlib directly.
+//!
+//! Every combination of corpus, compression level, class and access pattern is measured. The access patterns are:
+//!     - byte:     one character per call (put() and get())
+//!     - record:   RECORD_SIZE characters per call
+//!     - bulk:     BULK_SIZE characters per call
+//!
+//! Usage:
+//!     zstream_bench [--format json|csv] [--size <bytes>] [--levels <list>] [--corpora <list>] [--filter <text>]
+//!                   [--min-time <seconds>] [--dir <directory>]
+//!
+//! The results are written to stdout, one per case, with the throughput in MB/s of uncompressed data and the time
+//! per call in ns.
+
+#include "zfstream.h"
+#include "zmstream.h"
+#include "zlib/zlib.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef unsigned char char_type;
+typedef std::vector<char_type> buffer_type;
+
+size_t const RECORD_SIZE = 100;
+size_t const BULK_SIZE   = 64 * 1024;
+
+// Options
+struct Options
+{
+    std::string format      = "json";
+    size_t size             = 8 * 1024 * 1024;
+    std::vector<int> levels = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    std::vector<std::string> corpora = { "text", "random", "logs", "numeric" };
+    std::string filter;
+    double minTime          = 0.2;
+    std::string dir         = ".";
+};
+
+// A measurement
+struct Result
+{
+    std::string corpus;
+    int level;
+    std::string subject;    // Class or zlib API being measured
+    std::string operation;  // compress or decompress
+    std::string pattern;    // byte, record or bulk
+    size_t bytes;           // Uncompressed bytes per run
+    size_t compressed;      // Compressed bytes per run
+    size_t calls;           // Calls per run
+    double seconds;         // Best time of a run
+    int runs;               // Number of runs
+};
+
+//! @name Corpora
+//@{
+
+// English-like text
+buffer_type makeText(size_t size)
+{
+    static char const * const words[] =
+    {
+        "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as", "was", "with", "be", "by", "on",
+        "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have", "an", "had", "they", "you",
+        "were", "compression", "stream", "buffer", "window", "deflate", "inflate", "library", "performance"
+    };
+    std::mt19937 random(1);
+    std::string text;
+    text.reserve(size + 16);
+    while (text.size() < size)
+    {
+        text += words[random() % (sizeof(words) / sizeof(words[0]))];
+        text += (random() % 12 == 0) ? ".\n" : " ";
+    }
+    return buffer_type(text.begin(), text.begin() + size);
+}
+
+// Uniformly random bytes
+buffer_type makeRandom(size_t size)
+{
+    std::mt19937 random(2);
+    buffer_type data(size);
+    for (auto & c : data)
+    {
+        c = char_type(random());
+    }
+    return data;
+}
+
+// Server log lines
+buffer_type makeLogs(size_t size)
+{
+    static char const * const levels[]   = { "INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR" };
+    static char const * const messages[] =
+    {
+        "request completed", "cache miss", "connection opened", "connection closed", "retrying after timeout",
+        "user authenticated", "payload too large"
+    };
+    std::mt19937 random(3);
+    std::string text;
+    text.reserve(size + 256);
+    unsigned long long time = 1700000000000ULL;
+    char line[256];
+    while (text.size() < size)
+    {
+        time += random() % 50;
+        snprintf(line, sizeof(line), "%llu.%03llu %s [worker-%u] %s id=%08x latency=%ums\n",
+                 time / 1000, time % 1000, levels[random() % 6], unsigned(random() % 16), messages[random() % 7],
+                 unsigned(random()), unsigned(random() % 2000));
+        text += line;
+    }
+    return buffer_type(text.begin(), text.begin() + size);
+}
+
+// Little-endian 32-bit integers forming a slowly varying series
+buffer_type makeNumeric(size_t size)
+{
+    std::mt19937 random(4);
+    buffer_type data(size);
+    int value = 0;
+    for (size_t i = 0; i + 4 <= size; i += 4)
+    {
+        value += int(random() % 201) - 100;
+        for (int j = 0; j < 4; ++j)
+        {
+            data[i + j] = char_type(unsigned(value) >> (j * 8));
+        }
+    }
+    return data;
+}
+
+buffer_type makeCorpus(std::string const & name, size_t size)
+{
+    if (name == "text")
+    {
+        return makeText(size);
+    }
+    if (name == "random")
+    {
+        return makeRandom(size);
+    }
+    if (name == "logs")
+    {
+        return makeLogs(size);
+    }
+    if (name == "numeric")
+    {
+        return makeNumeric(size);
+    }
+    return buffer_type();
+}
+
+//@}
+
+// Returns the number of bytes transferred per call with a pattern
+size_t chunkSize(std::string const & pattern)
+{
+    return (pattern == "byte") ? 1 : (pattern == "record") ? RECORD_SIZE : BULK_SIZE;
+}
+
+// Returns the number of calls made to transfer @p size bytes with a pattern
+size_t callCount(std::string const & pattern, size_t size)
+{
+    size_t const chunk = chunkSize(pattern);
+    return (size + chunk - 1) / chunk;
+}
+
+// Runs a function repeatedly for at least the minimum time, and returns the best time of a run
+double measure(std::function<void()> const & run, double minTime, int & runs)
+{
+    typedef std::chrono::steady_clock clock;
+
+    double best  = 1e300;
+    double total = 0.0;
+    runs = 0;
+    do
+    {
+        clock::time_point start = clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        best   = std::min(best, seconds);
+        total += seconds;
+        ++runs;
+    }
+    while (total < minTime || runs < 3);
+    return best;
+}
+
+//! @name zlib
+//@{
+
+buffer_type zlibCompress(buffer_type const & data, int level, std::string const & pattern)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    deflateInit(&stream, level);
+
+    buffer_type out(deflateBound(&stream, uLong(data.size())));
+    stream.next_out  = out.data();
+    stream.avail_out = uInt(out.size());
+
+    size_t const chunk = chunkSize(pattern);
+    for (size_t i = 0; i < data.size(); i += chunk)
+    {
+        size_t const n = std::min(chunk, data.size() - i);
+        stream.next_in  = const_cast<char_type *>(data.data() + i);
+        stream.avail_in = uInt(n);
+        deflate(&stream, (i + n == data.size()) ? Z_FINISH : Z_NO_FLUSH);
+    }
+    if (data.empty())
+    {
+        deflate(&stream, Z_FINISH);
+    }
+    out.resize(out.size() - stream.avail_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+void zlibDecompress(buffer_type const & compressed, buffer_type & out, std::string const & pattern)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    inflateInit(&stream);
+
+    stream.next_in  = const_cast<char_type *>(compressed.data());
+    stream.avail_in = uInt(compressed.size());
+
+    size_t const chunk = chunkSize(pattern);
+    size_t total = 0;
+    while (total < out.size())
+    {
+        size_t const n = std::min(chunk, out.size() - total);
+        stream.next_out  = out.data() + total;
+        stream.avail_out = uInt(n);
+        int status = inflate(&stream, Z_NO_FLUSH);
+        total += n - stream.avail_out;
+        if (status != Z_OK)
+        {
+            break;
+        }
+    }
+    inflateEnd(&stream);
+}
+
+void gzipCompress(std::string const & name, buffer_type const & data, int level, std::string const & pattern)
+{
+    char mode[] = "wb0";
+    mode[2] = char('0' + level);
+    gzFile file = gzopen(name.c_str(), mode);
+
+    size_t const chunk = chunkSize(pattern);
+    for (size_t i = 0; i < data.size(); i += chunk)
+    {
+        gzwrite(file, data.data() + i, unsigned(std::min(chunk, data.size() - i)));
+    }
+    gzclose(file);
+}
+
+void gzipDecompress(std::string const & name, buffer_type & out, std::string const & pattern)
+{
+    gzFile file = gzopen(name.c_str(), "rb");
+
+    size_t const chunk = chunkSize(pattern);
+    for (size_t i = 0; i < out.size(); i += chunk)
+    {
+        gzread(file, out.data() + i, unsigned(std::min(chunk, out.size() - i)));
+    }
+    gzclose(file);
+}
+
+//@}
+
+//! @name Streams
+//@{
+
+template <class Stream>
+void put(Stream & stream, buffer_type const & data, std::string const & pattern)
+{
+    if (pattern == "byte")
+    {
+        for (char_type c : data)
+        {
+            stream.put(c);
+        }
+    }
+    else
+    {
+        size_t const chunk = chunkSize(pattern);
+        for (size_t i = 0; i < data.size(); i += chunk)
+        {
+            stream.write(data.data() + i, std::streamsize(std::min(chunk, data.size() - i)));
+        }
+    }
+}
+
+template <class Stream>
+void get(Stream & stream, buffer_type & out, std::string const & pattern)
+{
+    if (pattern == "byte")
+    {
+        for (auto & c : out)
+        {
+            c = char_type(stream.get());
+        }
+    }
+    else
+    {
+        size_t const chunk = chunkSize(pattern);
+        for (size_t i = 0; i < out.size(); i += chunk)
+        {
+            stream.read(out.data() + i, std::streamsize(std::min(chunk, out.size() - i)));
+        }
+    }
+}
+
+//@}
+
+// Returns the size of a file
+size_t fileSize(std::string const & name)
+{
+    FILE * file = fopen(name.c_str(), "rb");
+    if (!file)
+    {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size_t(std::max(size, 0L));
+}
+
+// Parses a comma-separated list
+std::vector<std::string> split(std::string const & text)
+{
+    std::vector<std::string> items;
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+void usage()
+{
+    fprintf(stderr,
+            "usage: zstream_bench [--format json|csv] [--size <bytes>] [--levels <list>] [--corpora <list>]\n"
+            "                     [--filter <text>] [--min-time <seconds>] [--dir <directory>]\n");
+}
+
+bool parse(int argc, char ** argv, Options & options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string const option = argv[i];
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        std::string const value = argv[++i];
+
+        if (option == "--format" && (value == "json" || value == "csv"))
+        {
+            options.format = value;
+        }
+        else if (option == "--size")
+        {
+            options.size = size_t(strtoull(value.c_str(), nullptr, 10));
+        }
+        else if (option == "--levels")
+        {
+            options.levels.clear();
+            for (auto const & level : split(value))
+            {
+                options.levels.push_back(std::min(std::max(atoi(level.c_str()), 0), 9));
+            }
+        }
+        else if (option == "--corpora")
+        {
+            options.corpora = split(value);
+        }
+        else if (option == "--filter")
+        {
+            options.filter = value;
+        }
+        else if (option == "--min-time")
+        {
+            options.minTime = atof(value.c_str());
+        }
+        else if (option == "--dir")
+        {
+            options.dir = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void print(Options const & options, std::vector<Result> const & results)
+{
+    if (options.format == "csv")
+    {
+        printf("corpus,level,subject,operation,pattern,bytes,compressed,ratio,calls,seconds,mb_per_s,ns_per_call,runs\n");
+        for (auto const & r : results)
+        {
+            printf("%s,%d,%s,%s,%s,%zu,%zu,%.4f,%zu,%.9f,%.2f,%.2f,%d\n",
+                   r.corpus.c_str(), r.level, r.subject.c_str(), r.operation.c_str(), r.pattern.c_str(), r.bytes,
+                   r.compressed, r.bytes ? double(r.compressed) / double(r.bytes) : 0.0, r.calls, r.seconds,
+                   double(r.bytes) / r.seconds / 1e6, r.seconds * 1e9 / double(r.calls), r.runs);
+        }
+        return;
+    }
+
+    printf("{\n");
+    printf("  \"context\": { \"zlib\": \"%s\", \"size\": %zu, \"record_size\": %zu, \"bulk_size\": %zu, "
+           "\"min_time\": %.3f },\n",
+           zlibVersion(), options.size, RECORD_SIZE, BULK_SIZE, options.minTime);
+    printf("  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        Result const & r = results[i];
+        printf("    { \"corpus\": \"%s\", \"level\": %d, \"subject\": \"%s\", \"operation\": \"%s\", "
+               "\"pattern\": \"%s\", \"bytes\": %zu, \"compressed\": %zu, \"ratio\": %.4f, \"calls\": %zu, "
+               "\"seconds\": %.9f, \"mb_per_s\": %.2f, \"ns_per_call\": %.2f, \"runs\": %d }%s\n",
+               r.corpus.c_str(), r.level, r.subject.c_str(), r.operation.c_str(), r.pattern.c_str(), r.bytes,
+               r.compressed, r.bytes ? double(r.compressed) / double(r.bytes) : 0.0, r.calls, r.seconds,
+               double(r.bytes) / r.seconds / 1e6, r.seconds * 1e9 / double(r.calls), r.runs,
+               (i + 1 < results.size()) ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    Options options;
+    if (!parse(argc, argv, options))
+    {
+        usage();
+        return 1;
+    }
+
+    std::string const fileName = options.dir + "/zstream_bench.tmp.gz";
+    char const * const patterns[] = { "byte", "record", "bulk" };
+    std::vector<Result> results;
+    bool ok = true;
+
+    for (auto const & corpus : options.corpora)
+    {
+        buffer_type const data = makeCorpus(corpus, options.size);
+        if (data.empty())
+        {
+            fprintf(stderr, "unknown corpus: %s\n", corpus.c_str());
+            return 1;
+        }
+        buffer_type out(data.size());
+
+        for (int level : options.levels)
+        {
+            for (char const * pattern : patterns)
+            {
+                // Adds a result if the case is selected by the filter. Returns false if it is not selected.
+                auto run = [&] (char const * subject, char const * operation, size_t compressed,
+                                std::function<void()> const & function)
+                {
+                    Result r = { corpus, level, subject, operation, pattern, data.size(), compressed,
+                                 callCount(pattern, data.size()), 0.0, 0 };
+                    std::string const name = corpus + "/" + std::to_string(level) + "/" + subject + "/" + operation +
+                                             "/" + pattern;
+                    if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+                    {
+                        return false;
+                    }
+                    std::fill(out.begin(), out.end(), char_type(0));
+                    r.seconds = measure(function, options.minTime, r.runs);
+                    results.push_back(r);
+                    fprintf(stderr, "%-48s %10.2f MB/s\n", name.c_str(), double(r.bytes) / r.seconds / 1e6);
+                    return true;
+                };
+
+                // Checks the output of a decompression
+                auto verify = [&] (bool ran)
+                {
+                    if (ran && out != data)
+                    {
+                        ok = false;
+                    }
+                };
+
+                // zlib
+                buffer_type compressed = zlibCompress(data, level, pattern);
+                run("zlib", "compress", compressed.size(), [&] { zlibCompress(data, level, pattern); });
+                verify(run("zlib", "decompress", compressed.size(), [&] { zlibDecompress(compressed, out, pattern); }));
+
+                // zlib gz functions
+                gzipCompress(fileName, data, level, pattern);
+                size_t const gzipSize = fileSize(fileName);
+                run("gzfile", "compress", gzipSize, [&] { gzipCompress(fileName, data, level, pattern); });
+                verify(run("gzfile", "decompress", gzipSize, [&] { gzipDecompress(fileName, out, pattern); }));
+
+                // ozmstream and izmstream
+                {
+                    ozmstream stream;
+                    stream.set_compression(level);
+                    put(stream, data, pattern);
+                    compressed = stream.release();
+                }
+                run("ozmstream", "compress", compressed.size(), [&] {
+                    ozmstream stream;
+                    stream.set_compression(level);
+                    put(stream, data, pattern);
+                    stream.release();
+                });
+                verify(run("izmstream", "decompress", compressed.size(), [&] {
+                    izmstream stream(compressed.data(), compressed.size());
+                    get(stream, out, pattern);
+                }));
+
+                // ozfstream and izfstream
+                auto write = [&] {
+                    ozfstream stream;
+                    stream.set_compression(level);
+                    stream.open(fileName.c_str());
+                    put(stream, data, pattern);
+                    stream.close();
+                };
+                write();
+                size_t const fileStreamSize = fileSize(fileName);
+                run("ozfstream", "compress", fileStreamSize, write);
+                verify(run("izfstream", "decompress", fileStreamSize, [&] {
+                    izfstream stream(fileName.c_str());
+                    get(stream, out, pattern);
+                }));
+            }
+        }
+    }
+
+    remove(fileName.c_str());
+
+    print(options, results);
+
+    if (!ok)
+    {
+        fprintf(stderr, "error: decompressed data does not match the original\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+/** @file *//********************************************************************************************************
+
+                                                    zadaptive.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zadaptive.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+
+//! Chooses the zlib compression level and strategy of each block of data from the ratio and speed of the previous
+//! blocks.
+//!
+//! The settings form a ladder from the slowest to the fastest: levels 9 to 1 (with Z_DEFAULT_STRATEGY or Z_FILTERED),
+//! then Z_RLE, Z_HUFFMAN_ONLY, and finally level 0 (stored). After each block, the controller moves one step faster
+//! if the block missed the target, or one step slower if it beat the target by a margin. A block that does not
+//! compress sends it straight to stored, and now and then a block of stored data is compressed with Z_HUFFMAN_ONLY
+//! (which is cheap) to find out if the data has become compressible again. Now and then, a block is also compressed
+//! with the other of Z_DEFAULT_STRATEGY and Z_FILTERED, which is kept if it compresses better.
+//!
+//! The buffers create a controller with set_adaptive(), pass it the size of each write, and apply its settings.
+//! Every change is recorded in decisions() (and counted in zstats::adaptations), so that the choices can be audited.
+//!
+//! incompressible() is a cheaper and finer test that the buffers use without a controller: with
+//! set_skip_incompressible(), each write that looks incompressible is stored instead of compressed.
+class zadaptive
+{
+public:
+    //! Sizes
+    enum
+    {
+        DEFAULT_BLOCK_SIZE = 1024 * 1024,   //!< Default amount of uncompressed data measured for each decision
+        MAX_DECISIONS      = 64,            //!< Number of decisions kept by decisions()
+        PROBE_SIZE         = 64 * 1024,     //!< Largest amount of data judged at once by incompressible(). The
+                                            //!< buffers judge larger writes a piece at a time.
+        MIN_PROBE_SIZE     = 1024           //!< Smallest amount of data worth judging with incompressible()
+    };
+
+    //! What the controller aims for. With neither limit, it only detects incompressible data and chooses the
+    //! strategy, and it keeps the initial level.
+    struct Target
+    {
+        double megabytesPerSecond;  //!< Minimum speed of the compressor in MB (10^6 bytes) of uncompressed data per
+                                    //!< second, or 0 for no minimum
+        double cpu;                 //!< Maximum fraction of the elapsed time spent compressing (0.5 is half of a
+                                    //!< core), or 0 for no maximum
+        size_t blockSize;           //!< Amount of uncompressed data measured for each decision
+
+        //! Constructor
+        Target(double megabytesPerSecond = 0.0, double cpu = 0.0, size_t blockSize = DEFAULT_BLOCK_SIZE)
+            : megabytesPerSecond(megabytesPerSecond)
+            , cpu(cpu)
+            , blockSize(blockSize)
+        {
+        }
+    };
+
+    //! Reasons for a decision
+    enum Reason
+    {
+        TOO_SLOW,       //!< The block missed the target, so a faster setting is used
+        FAST_ENOUGH,    //!< The block beat the target by a margin, so a slower setting is used
+        INCOMPRESSIBLE, //!< The block did not compress, so it is stored
+        COMPRESSIBLE,   //!< A probe of stored data compressed, so the previous setting is used again
+        FILTERED,       //!< A probe with Z_FILTERED compressed better than Z_DEFAULT_STRATEGY
+        UNFILTERED,     //!< A probe with Z_DEFAULT_STRATEGY compressed better than Z_FILTERED
+        PROBE           //!< A block is compressed with another setting to compare it with the current one
+    };
+
+    //! A change of the setting
+    struct Decision
+    {
+        unsigned long long position;    //!< Amount of uncompressed data before the change
+        int level;                      //!< New level
+        int strategy;                   //!< New zlib strategy
+        Reason reason;                  //!< Why it changed
+        double ratio;                   //!< Compressed size / uncompressed size of the block that led to it
+        double megabytesPerSecond;      //!< Speed of the compressor during that block
+        double cpu;                     //!< Fraction of the elapsed time spent compressing during that block
+    };
+
+    // Constructor
+    zadaptive(Target const & target, int level);
+
+    //! Records that @p in characters were compressed into @p out bytes in @p time. Returns true if the setting
+    //! changed, in which case level() and strategy() must be applied to the compressor before the next write.
+    bool update(size_t in, size_t out, std::chrono::nanoseconds time);
+
+    //! Returns the current level.
+    int level() const;
+
+    //! Returns the current zlib strategy.
+    int strategy() const;
+
+    //! Returns the amount of uncompressed data that completes the current block. The buffers split larger writes
+    //! there, so that every block gets its own decision.
+    size_t remaining() const { return target_.blockSize - in_; }
+
+    //! Returns the most recent changes, oldest first (at most MAX_DECISIONS).
+    std::deque<Decision> const & decisions() const { return decisions_; }
+
+    //! Returns true if data looks incompressible (already compressed, encrypted, or random).
+    static bool incompressible(unsigned char const * data, size_t size);
+
+private:
+
+    // Kinds of probes
+    enum Probe
+    {
+        NO_PROBE,       // The block is not a probe
+        STORED_PROBE,   // Stored data is compressed with Z_HUFFMAN_ONLY
+        FILTER_PROBE    // The other of Z_DEFAULT_STRATEGY and Z_FILTERED is used
+    };
+
+    // Chooses the setting for the next block. Returns true if it changed.
+    bool decide(double ratio, double speed, double cpu);
+
+    // Changes the setting and records the decision. Returns true if the setting changed.
+    bool change(int rung, bool filtered, Reason reason, double ratio, double speed, double cpu);
+
+    Target target_;                                     // What the controller aims for
+    int rung_;                                          // Current setting (index into the ladder)
+    bool filtered_;                                     // True if levels use Z_FILTERED
+    int resume_;                                        // Setting to probe or resume when the data is stored
+    Probe probe_;                                       // Kind of probe the current block is
+    unsigned blocks_;                                   // Number of blocks since the setting last changed
+    double lastRatio_;                                  // Ratio of the last block that was not a probe
+    size_t in_;                                         // Uncompressed size of the current block so far
+    size_t out_;                                        // Compressed size of the current block so far
+    std::chrono::nanoseconds time_;                     // Time spent compressing the current block so far
+    std::chrono::steady_clock::time_point start_;       // When the current block started
+    unsigned long long position_;                       // Amount of uncompressed data before the current block
+    std::deque<Decision> decisions_;                    // Most recent changes
+};
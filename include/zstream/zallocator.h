@@ -0,0 +1,38 @@
+/** @file *//********************************************************************************************************
+
+                                                    zallocator.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zallocator.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include "zlib/zlib.h"
+#include <memory_resource>
+
+//! Connects zlib's memory allocation to a memory resource.
+//!
+//! Any memory resource can be used, for example an arena (@c std::pmr::monotonic_buffer_resource), a pool
+//! (@c std::pmr::unsynchronized_pool_resource), or a custom class derived from @c std::pmr::memory_resource.
+class zallocator
+{
+public:
+
+    //! Makes a zlib stream allocate its state from a memory resource. This must be done before the stream is
+    //! initialized. If @p resource is nullptr, zlib's default allocation is used.
+    static void attach(z_stream & stream, std::pmr::memory_resource * resource);
+
+private:
+
+    // zlib allocation function
+    static voidpf allocate(voidpf opaque, uInt items, uInt size);
+
+    // zlib deallocation function
+    static void deallocate(voidpf opaque, voidpf address);
+};
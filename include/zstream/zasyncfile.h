@@ -0,0 +1,123 @@
+/** @file *//********************************************************************************************************
+
+                                                    zasyncfile.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zasyncfile.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! A file that is read or written by a worker thread, so that the I/O overlaps the work of the caller.
+//!
+//! The data passes through a small set of buffers. When writing, full buffers are queued and written by the worker
+//! while the caller fills the next one. When reading, the worker reads ahead into the free buffers while the caller
+//! consumes the oldest one.
+class zasyncfile
+{
+public:
+    typedef unsigned char char_type;    //!< Element type
+    typedef long long off_type;         //!< Holds a file offset
+
+    //! Buffer sizes
+    enum
+    {
+        DEFAULT_BUFFER_SIZE  = 256 * 1024,  //!< Default size of each buffer
+        DEFAULT_BUFFER_COUNT = 3            //!< Default number of buffers
+    };
+
+    // Constructor
+    explicit zasyncfile(size_t bufferSize = DEFAULT_BUFFER_SIZE, unsigned bufferCount = DEFAULT_BUFFER_COUNT);
+
+    // Destructor
+    ~zasyncfile();
+
+    //! Opens a file for reading or for writing and starts the worker. Returns false if it could not be opened.
+    bool open(char const * name, bool write);
+
+    //! Waits for the worker to finish and closes the file. Returns false if there was an error.
+    bool close();
+
+    //! Returns true if a file is open.
+    bool is_open() const { return file_ != nullptr; }
+
+    //! Reads up to @p n bytes. Returns the number of bytes read, which is less than @p n only at the end of the file
+    //! or if there was an error.
+    size_t read(char_type * s, size_t n);
+
+    //! Writes @p n bytes. Returns false if there was an error.
+    bool write(char_type const * s, size_t n);
+
+    //! Waits until everything written so far is in the file. Returns false if there was an error.
+    bool flush();
+
+    //! Sets the offset of the next read. Returns false if the file is being written.
+    bool seek(off_type offset);
+
+    //! Returns the offset of the next byte read or written.
+    off_type tell() const { return position_; }
+
+    //! Returns the size of the file when it was opened for reading.
+    off_type size() const { return size_; }
+
+    //! Returns true if there was an error.
+    bool error() const;
+
+private:
+
+    // A buffer passed between the caller and the worker
+    struct Buffer
+    {
+        std::vector<char_type> data;    // Contents
+        size_t size;                    // Amount of data in the buffer
+        size_t consumed;                // Amount of data read by the caller
+        off_type offset;                // Offset of the data in the file
+    };
+
+    // Non-copyable
+    zasyncfile(zasyncfile const &) = delete;
+    zasyncfile & operator =(zasyncfile const &) = delete;
+
+    // Queues the current buffer and gets an empty one, waiting if necessary
+    bool submit();
+
+    // Returns the current buffer to the free list and gets the next one that has been read, waiting if necessary
+    bool next();
+
+    // Worker thread
+    void worker();
+
+    size_t bufferSize_;                                 // Size of each buffer
+    unsigned bufferCount_;                              // Number of buffers
+    FILE * file_;                                       // The file (only the worker uses it while it is running)
+    bool write_;                                        // True if the file is being written
+    off_type position_;                                 // Offset of the next byte read or written by the caller
+    off_type size_;                                     // Size of the file when it was opened for reading
+    std::unique_ptr<Buffer> current_;                   // Buffer being filled or consumed by the caller
+
+    mutable std::mutex mutex_;                          // Guards everything below
+    std::condition_variable workReady_;                 // Signaled when there is work for the worker
+    std::condition_variable bufferReady_;               // Signaled when the worker is done with a buffer
+    std::deque<std::unique_ptr<Buffer> > free_;         // Buffers that are not in use
+    std::deque<std::unique_ptr<Buffer> > queued_;       // Buffers waiting to be written, or that have been read
+    size_t busy_;                                       // Number of buffers held by the worker
+    off_type fetch_;                                    // Offset of the next read by the worker
+    unsigned generation_;                               // Incremented by a seek to discard reads in progress
+    bool end_;                                          // True if the worker has reached the end of the file
+    bool error_;                                        // True if there was an error
+    bool stop_;                                         // True when the worker must exit
+    std::thread worker_;                                // Worker thread
+};
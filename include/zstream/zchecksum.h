@@ -0,0 +1,98 @@
+/** @file *//********************************************************************************************************
+
+                                                    zchecksum.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zchecksum.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//! A running checksum of uncompressed data, either CRC-32 (the checksum of gzip) or Adler-32 (the checksum of the zlib
+//! format). The values are the same as those of zlib's crc32() and adler32().
+//!
+//! The functions use the fastest implementation that the CPU supports, chosen when they are first called: on x86,
+//! CRC-32 folds 64 bytes at a time with PCLMULQDQ, and Adler-32 sums 32 bytes at a time with AVX2. Otherwise, zlib's
+//! functions are used. The checksums of consecutive pieces of data can be computed separately (for example, by several
+//! threads) and then joined with combine().
+//!
+//! @code
+//!     zchecksum first(zchecksum::CRC32);
+//!     zchecksum second(zchecksum::CRC32);
+//!     first.update(data, n);
+//!     second.update(data + n, size - n);
+//!     first.combine(second);      // first.value() is the CRC-32 of all the data
+//! @endcode
+class zchecksum
+{
+public:
+    //! Kinds of checksums
+    enum Type
+    {
+        CRC32,      //!< CRC-32, as in gzip
+        ADLER32     //!< Adler-32, as in the zlib format
+    };
+
+    //! Constructor
+    explicit zchecksum(Type type = CRC32)
+        : type_(type)
+        , value_(initial(type))
+        , length_(0)
+    {
+    }
+
+    //! Adds data to the checksum.
+    void update(void const * data, size_t size);
+
+    //! Appends the checksum of the data that follows the data of this one. The types must be the same.
+    void combine(zchecksum const & next);
+
+    //! Restarts the checksum with no data, and optionally changes its type.
+    void reset() { reset(type_); }
+    void reset(Type type)
+    {
+        type_   = type;
+        value_  = initial(type);
+        length_ = 0;
+    }
+
+    //! Returns the type of the checksum.
+    Type type() const { return type_; }
+
+    //! Returns the value of the checksum.
+    uint32_t value() const { return value_; }
+
+    //! Returns the amount of data added to the checksum.
+    unsigned long long length() const { return length_; }
+
+    //! Returns the checksum of no data (0 for CRC-32, 1 for Adler-32).
+    static uint32_t initial(Type type) { return (type == ADLER32) ? 1 : 0; }
+
+    //! Returns the CRC-32 @p crc updated with data.
+    static uint32_t crc32(uint32_t crc, void const * data, size_t size);
+
+    //! Returns the Adler-32 @p adler updated with data.
+    static uint32_t adler32(uint32_t adler, void const * data, size_t size);
+
+    //! Returns the CRC-32 of two consecutive pieces of data, given their CRC-32s and the size of the second piece.
+    static uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, unsigned long long size2);
+
+    //! Returns the Adler-32 of two consecutive pieces of data, given their Adler-32s and the size of the second piece.
+    static uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, unsigned long long size2);
+
+    //! Returns the name of the implementation used for a type of checksum ("pclmul", "avx2", or "zlib").
+    static char const * implementation(Type type);
+
+private:
+    Type type_;                     // Kind of checksum
+    uint32_t value_;                // Value of the checksum
+    unsigned long long length_;     // Amount of data in the checksum
+};
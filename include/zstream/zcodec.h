@@ -0,0 +1,172 @@
+/** @file *//********************************************************************************************************
+
+                                                      zcodec.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zcodec.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+class zdictionary;
+
+//! A streaming compressor or decompressor.
+//!
+//! This is the interface through which zmembuf and the file classes compress and decompress data, so that the same
+//! streams can use any of the supported formats. zlib is always available. zstd and lz4 are available if the library
+//! is built with them (ZSTREAM_HAVE_ZSTD and ZSTREAM_HAVE_LZ4); see available().
+//!
+//! Data is passed in and out through pointers and sizes that are advanced as the data is consumed and produced,
+//! like the fields of a @c z_stream.
+class zcodec
+{
+public:
+    typedef unsigned char char_type;    //!< Element type
+
+    //! Compressed data formats
+    enum Type
+    {
+        AUTO,       //!< Detected when decompressing (see detect()), or the stream's default format when compressing
+        GZIP,       //!< gzip (RFC 1952) with zlib
+        ZLIB,       //!< zlib (RFC 1950) with zlib
+        DEFLATE,    //!< Raw deflate data (RFC 1951) with zlib. This cannot be detected.
+        ZSTD,       //!< zstd frames
+        LZ4         //!< lz4 frames
+    };
+
+    //! Flush modes
+    enum Flush
+    {
+        NO_FLUSH,       //!< Compress as much as is efficient
+        PARTIAL_FLUSH,  //!< Produce all the output so far without aligning it (zlib's Z_PARTIAL_FLUSH). The others
+                        //!< treat it as SYNC_FLUSH.
+        SYNC_FLUSH,     //!< Produce all the output so far, so that a reader can decompress everything written
+        FULL_FLUSH,     //!< Like SYNC_FLUSH, and the data that follows does not refer to the data before it, so a
+                        //!< reader can start there (zlib's Z_FULL_FLUSH). The others treat it as SYNC_FLUSH.
+        FINISH          //!< End the compressed data
+    };
+
+    //! Results of compress() and decompress()
+    enum Status
+    {
+        OK,         //!< Progress was made, or there is nothing to do until there is more input or output space
+        END,        //!< The end of the compressed data (or the current frame or member) was reached or written
+        INVALID     //!< The data is invalid, or the codec failed
+    };
+
+    //! Levels
+    enum
+    {
+        DEFAULT_LEVEL = -1  //!< Selects the codec's default level
+    };
+
+    //! Settings of a compressor. The meaning of each setting depends on the codec.
+    struct Options
+    {
+        int level;      //!< Compression level. zlib: 0 to 9. zstd: 1 to 22. lz4: 0 to 12 (above 2 is lz4hc).
+        int window;     //!< Base 2 logarithm of the window size, or 0 for the default. zlib: 9 to 15. zstd: 10 to 31.
+        int strategy;   //!< zlib strategy (for example, Z_FILTERED). Ignored by the others.
+        bool checksum;  //!< zstd and lz4: include a checksum of the content. zlib formats always have one (except raw
+                        //!< deflate).
+        std::shared_ptr<zdictionary const> dictionary;  //!< Preset dictionary, or nullptr. Supported by zlib, raw
+                                                        //!< deflate, and zstd. It is used by every frame or message
+                                                        //!< after a reset too.
+
+        Options() : level(DEFAULT_LEVEL), window(0), strategy(0), checksum(true) {}
+    };
+
+    // Destructor
+    virtual ~zcodec() {}
+
+    //! Creates a compressor or decompressor. Returns nullptr if the type is not available.
+    //!
+    //! @param	type        Format (not AUTO)
+    //! @param	compress    True to compress, false to decompress
+    //! @param	options     Settings (a decompressor uses only the window setting of the zlib formats and the
+    //!                     dictionary). If the type does not support the dictionary, nullptr is returned.
+    //! @param	resource    Memory resource that provides the zlib state, or nullptr to use the default allocation.
+    //!                     zstd and lz4 use their default allocation.
+    static std::unique_ptr<zcodec> create(Type                        type,
+                                          bool                        compress,
+                                          Options const &             options  = Options(),
+                                          std::pmr::memory_resource * resource = nullptr);
+
+    //! Returns true if the library was built with support for the type.
+    static bool available(Type type);
+
+    //! Returns the format of compressed data from its first bytes, or AUTO if it is not recognized.
+    static Type detect(char_type const * data, size_t size);
+
+    //! Returns the format of a compressed file from its first bytes, or AUTO if it is not recognized or the file
+    //! cannot be read.
+    static Type detect(char const * name);
+
+    //! Returns the size of the uncompressed data recorded in compressed data, or 0 if it is not recorded.
+    static size_t content_size(char_type const * data, size_t size);
+
+    //! Returns a level limited to the range supported by the type. DEFAULT_LEVEL is unchanged.
+    static int clamp_level(Type type, int level);
+
+    //! Returns the format.
+    Type type() const { return type_; }
+
+    //! Compresses data. Returns END when @p flush is FINISH and all the output has been produced.
+    //!
+    //! @param	in          Uncompressed data. Advanced past the data consumed.
+    //! @param	inSize      Amount of uncompressed data. Reduced by the amount consumed.
+    //! @param	out         Where to put the compressed data. Advanced past the data produced.
+    //! @param	outSize     Amount of space at @p out. Reduced by the amount produced.
+    //! @param	flush       Flush mode. When it is not NO_FLUSH, the call is complete if all the input has been
+    //!                     consumed and some output space is left; otherwise, it must be called again with more space.
+    virtual Status compress(char_type const * & in,
+                            size_t &            inSize,
+                            char_type * &       out,
+                            size_t &            outSize,
+                            Flush               flush) = 0;
+
+    //! Decompresses data. Returns END at the end of a frame or member. If more data follows it, reset() must be
+    //! called before it can be decompressed.
+    //!
+    //! @param	in          Compressed data. Advanced past the data consumed.
+    //! @param	inSize      Amount of compressed data. Reduced by the amount consumed.
+    //! @param	out         Where to put the uncompressed data. Advanced past the data produced.
+    //! @param	outSize     Amount of space at @p out. Reduced by the amount produced.
+    virtual Status decompress(char_type const * & in, size_t & inSize, char_type * & out, size_t & outSize) = 0;
+
+    //! Prepares for new data, keeping the settings and reusing the state. Returns false if it failed.
+    virtual bool reset() = 0;
+
+    //! Returns the largest amount of compressed data that compressing @p size bytes with FINISH can produce,
+    //! including the header and trailer. Only a compressor supports this.
+    virtual size_t bound(size_t size) = 0;
+
+    //! Changes the compression level of the data that follows. Depending on the codec, the change may take effect at
+    //! the next block or at the next frame.
+    virtual void set_level(int level) = 0;
+
+    //! Changes the zlib strategy (for example, Z_FILTERED) of the data that follows. The change takes effect at the
+    //! next block. The other codecs ignore it.
+    virtual void set_strategy(int strategy) { (void)strategy; }
+
+protected:
+
+    //! Constructor
+    explicit zcodec(Type type) : type_(type) {}
+
+private:
+
+    // Non-copyable
+    zcodec(zcodec const &) = delete;
+    zcodec & operator =(zcodec const &) = delete;
+
+    Type type_;     // Format
+};
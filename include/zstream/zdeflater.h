@@ -0,0 +1,75 @@
+/** @file *//********************************************************************************************************
+
+                                                    zdeflater.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zdeflater.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include "zasyncfile.h"
+#include "zcodec.h"
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+//! Compresses data into a file, writing the file asynchronously.
+//!
+//! The data is compressed by the caller while a zasyncfile writes the previously compressed data, so compression
+//! and disk I/O overlap. The file is a gzip file unless another format is given (see zcodec).
+class zdeflater
+{
+public:
+    typedef unsigned char char_type;    //!< Element type
+
+    // Constructor
+    explicit zdeflater(std::pmr::memory_resource * resource = nullptr);
+
+    // Destructor
+    ~zdeflater();
+
+    //! Creates a file. Returns false if it could not be created, or if the format is not available.
+    bool open(char const * name, zcodec::Type type, zcodec::Options const & options);
+
+    //! Finishes the compressed data and closes the file. Returns false if there was an error.
+    bool close();
+
+    //! Returns true if a file is open.
+    bool is_open() const { return file_.is_open(); }
+
+    //! Compresses @p n characters. Returns false if there was an error.
+    bool write(char_type const * s, size_t n);
+
+    //! Writes everything compressed so far to the file. Returns false if there was an error.
+    bool flush(zcodec::Flush flush = zcodec::SYNC_FLUSH);
+
+    //! Sets the compression level of subsequent data. Returns false if there was an error.
+    bool set_compression(int level);
+
+    //! Sets the zlib strategy of subsequent data. Returns false if there was an error.
+    bool set_strategy(int strategy);
+
+    //! Returns the number of uncompressed characters written so far.
+    size_t tell() const { return written_; }
+
+    //! Returns the number of compressed bytes written to the file so far.
+    size_t compressed() const { return size_t(file_.tell()); }
+
+private:
+
+    // Compresses the input with the given flush mode and passes the output to the file
+    bool compress(char_type const * s, size_t n, zcodec::Flush flush);
+
+    zasyncfile file_;                       // Output file
+    std::pmr::memory_resource * resource_;  // Provides the zlib state
+    std::unique_ptr<zcodec> codec_;         // Compressor
+    std::vector<char_type> output_;         // Compressed data
+    size_t written_;                        // Number of uncompressed characters written
+    bool error_;                            // True if there was an error
+};
@@ -0,0 +1,86 @@
+/** @file *//********************************************************************************************************
+
+                                                   zdictionary.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zdictionary.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+//! A preset dictionary, which primes the compressor and decompressor with data that is likely to appear in the
+//! messages.
+//!
+//! Small messages compress poorly because there is no earlier data for the matches to refer to. A dictionary made of
+//! strings that are common in the messages provides it. The same dictionary must be used to decompress.
+//!
+//! A dictionary is immutable, so one object can be shared by any number of buffers and threads. It is attached to a
+//! buffer with zmembuf::set_dictionary() (or through zcodec::Options). The zlib format records the ID of the
+//! dictionary, so the decompressor checks it, and required() tells which dictionary a message needs. Raw deflate
+//! and zstd data do not record it. gzip and lz4 do not support dictionaries.
+//!
+//! @code
+//!     std::shared_ptr<zdictionary const> dictionary = zdictionary::load("records.dict");
+//!     ozmstream out;
+//!     out.set_dictionary(dictionary);
+//! @endcode
+class zdictionary
+{
+public:
+    typedef unsigned char char_type;    //!< Element type
+
+    //! Sizes
+    enum
+    {
+        MAX_DEFLATE_SIZE = 32 * 1024,   //!< Largest dictionary that deflate can use. Only the end of a larger one is
+                                        //!< used by zlib.
+        DEFAULT_SIZE     = 16 * 1024,   //!< Default size of a trained dictionary
+        DEFAULT_SEGMENT  = 48           //!< Default length of the pieces of the samples that a trained dictionary is
+                                        //!< made of
+    };
+
+    //! Constructor
+    //!
+    //! @param	data	Contents. The most useful strings should be at the end, because they are the closest to the
+    //!                 data and so the cheapest to refer to.
+    //! @param	size	Size of the contents
+    zdictionary(char_type const * data, size_t size);
+
+    //! Returns the contents.
+    char_type const * data() const { return data_.data(); }
+
+    //! Returns the size of the contents.
+    size_t size() const { return data_.size(); }
+
+    //! Returns the ID of the dictionary, which is the Adler-32 checksum of its contents (as in the zlib format).
+    unsigned long id() const { return id_; }
+
+    //! Saves the contents to a file. Returns false if the file could not be written.
+    bool save(char const * name) const;
+
+    //! Loads a dictionary from a file holding its contents. Returns nullptr if the file could not be read.
+    static std::shared_ptr<zdictionary const> load(char const * name);
+
+    //! Builds a dictionary from samples of the messages that it will be used for.
+    static std::shared_ptr<zdictionary const> train(char_type const *            samples,
+                                                    std::vector<size_t> const &  sizes,
+                                                    size_t                       size    = DEFAULT_SIZE,
+                                                    size_t                       segment = DEFAULT_SEGMENT);
+
+    //! Returns the ID of the dictionary needed to decompress zlib data, or 0 if it does not need one.
+    static unsigned long required(char_type const * data, size_t size);
+
+private:
+
+    std::vector<char_type> data_;   // Contents
+    unsigned long id_;              // Adler-32 checksum of the contents
+};
@@ -14,21 +14,46 @@
 
 #pragma once
 
+#include "zadaptive.h"
+#include "zchecksum.h"
+#include "zcodec.h"
+#include "zflushpolicy.h"
+#include "zstats.h"
 #include "zlib/zlib.h"
+#include <chrono>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <streambuf>
+#include <vector>
+
+class zdeflater;
+class zflushtimer;
+class zinflater;
+class zmembers;
+class zparallel;
+class zreadahead;
+class zspeculative;
 
 //! A file stream buffer that compresses and decompresses the data using @c zlib.
-class zfilebuf : public std::basic_streambuf<unsigned char, std::char_traits<unsigned char> >
+//!
+//! @param	CharT   Element type. It must be the size of a byte (@c char, @c signed @c char, or @c unsigned @c char).
+//! @param	Traits  The element type's traits
+//!
+//! @note   The members are instantiated in the library for the zfilebuf and czfilebuf types.
+template <class CharT, class Traits = std::char_traits<CharT> >
+class basic_zfilebuf : public std::basic_streambuf<CharT, Traits>
 {
+    static_assert(sizeof(CharT) == 1, "basic_zfilebuf only supports elements the size of a byte");
+
 public:
-    typedef unsigned char char_type;                                    //!< Element type
-    typedef std::char_traits<unsigned char>               traits_type;  //!< The element's traits (not used, included for
-                                                                        //!< completeness.
+    typedef CharT char_type;                                            //!< Element type
+    typedef Traits                                        traits_type;  //!< The element's traits
     typedef std::basic_streambuf<char_type, traits_type>  base_type;    //!< The streambuf base class
 
-    typedef traits_type::int_type int_type;     //!< Holds info not representable by char_type
-    typedef traits_type::pos_type pos_type;     //!< Holds a buffer position
-    typedef traits_type::off_type off_type;     //!< Holds a buffer offset
+    typedef typename traits_type::int_type int_type;    //!< Holds info not representable by char_type
+    typedef typename traits_type::pos_type pos_type;    //!< Holds a buffer position
+    typedef typename traits_type::off_type off_type;    //!< Holds a buffer offset
 
     //! Reasons for a call to _Init
     enum InitializeReason
@@ -38,24 +63,142 @@ public:
         CLOSED  //!< File closed
     };
 
+    //! Buffer sizes
+    enum
+    {
+        DEFAULT_BUFFER_SIZE = 64 * 1024,    //!< Size of the I/O buffer if one is not provided with setbuf()
+        PUTBACK_SIZE        = 16            //!< Number of characters that can always be put back after a read
+    };
+
     // Constructor
-    zfilebuf(gzFile file = nullptr);
+    basic_zfilebuf(gzFile file = nullptr);
 
     // Destructor
-    virtual ~zfilebuf();
+    virtual ~basic_zfilebuf();
 
     //! Returns @c true if the file has been opened
-    bool is_open() const { return file_ != nullptr; }
+    bool is_open() const
+    {
+        return file_ != nullptr || parallel_ != nullptr || writer_ != nullptr || reader_ != nullptr ||
+               members_ != nullptr || speculative_ != nullptr;
+    }
 
     //! Opens a file. Returns @c this.
-    zfilebuf * open(char const * name, std::ios_base::openmode mode);
+    //!
+    //! @note   If a file is opened for input and it has a sidecar index (see zindex::sidecar()), then the index is
+    //!         used to seek.
+    basic_zfilebuf * open(char const * name, std::ios_base::openmode mode);
 
-    //! Closes the file. Returns @c this.
-    zfilebuf * close();
+    //! Closes the file. Returns @c this, or nullptr if it failed.
+    basic_zfilebuf * close();
 
     //! Sets the compression level.
     void set_compression(int level);
 
+    //! Sets the number of threads used to compress files opened for output, and to decompress files opened for
+    //! input that have several gzip members. If 0, the number of hardware threads is used.
+    void set_threads(unsigned threads) { threads_ = threads; }
+
+    //! Sets the memory resource that provides the zlib state of files opened after this call.
+    //!
+    //! @note   Files read and written through zlib's gz functions do not use it, because zlib does not allow their
+    //!         allocation to be replaced. It is used when reading a file with an index, and when compressing with
+    //!         threads. In the latter case, it must be thread-safe.
+    void set_allocator(std::pmr::memory_resource * resource) { resource_ = resource; }
+
+    //! Sets whether files opened for reading after this call are mapped into memory instead of being read.
+    //!
+    //! @note   Only gzip files are mapped. Other files are read normally.
+    void set_memory_mapped(bool mapped) { mapped_ = mapped; }
+
+    //! Sets whether files opened after this call are read or written by a worker thread, so that the disk I/O
+    //! overlaps compression and decompression.
+    //!
+    //! @note   Only gzip files are read this way. When compressing with threads, the compressed data is always
+    //!         written by a separate thread, so this has no effect.
+    void set_async_io(bool async) { async_ = async; }
+
+    //! Sets whether files opened for reading after this call are decompressed ahead of the reader by a helper
+    //! thread, so that decompression overlaps the processing of the data.
+    //!
+    //! @note   A seek outside the buffer discards the data decompressed ahead, so this is meant for sequential
+    //!         reading. With read-ahead, the compressed size in the statistics includes the data decompressed ahead,
+    //!         and the time spent in zlib is the time spent waiting for the helper.
+    void set_read_ahead(bool readAhead) { readAhead_ = readAhead; }
+
+    //! Sets whether files opened for reading with threads after this call are decompressed in parallel even if they
+    //! have only one gzip member. See zspeculative.
+    //!
+    //! @note   This uses a decompressor of its own instead of zlib, and it does not use the memory resource.
+    void set_speculative(bool speculate) { speculate_ = speculate; }
+
+    //! Sets the format of files opened after this call, and the settings of the compressor.
+    //!
+    //! @note   When reading, AUTO detects gzip, zstd, and lz4 files, and other files are passed through. Files in the
+    //!         other formats are always decompressed by the reader, and they are always written asynchronously.
+    void set_codec(zcodec::Type type, zcodec::Options const & options = zcodec::Options())
+    {
+        codec_        = type;
+        codecOptions_ = options;
+        level_        = options.level;
+    }
+
+    //! Enables or disables adaptive compression of files opened for output after this call. It chooses the level and
+    //! strategy of each block of data from the ratio and speed of the previous blocks. See zadaptive.
+    //!
+    //! @note   The controller starts from the level set with set_compression(). Only gzip and the other zlib formats
+    //!         are adapted, and not when compressing with threads.
+    void set_adaptive(bool adaptive, zadaptive::Target const & target = zadaptive::Target())
+    {
+        adaptive_       = adaptive;
+        adaptiveTarget_ = target;
+    }
+
+    //! Returns the adaptive controller of the open file (for its decisions), or nullptr if there is none.
+    zadaptive const * adaptive() const { return controller_.get(); }
+
+    //! Sets whether output that looks incompressible (already compressed, encrypted, or random) is stored instead of
+    //! compressed in files opened for output after this call. Each write is judged separately (a large write, a piece
+    //! at a time), and compression resumes with the first write that looks compressible. See
+    //! zadaptive::incompressible().
+    //!
+    //! @note   Only gzip and the other zlib formats are supported, and not when compressing with threads. Writes of
+    //!         less than zadaptive::MIN_PROBE_SIZE characters keep the setting of the previous write.
+    void set_skip_incompressible(bool skip) { skipIncompressible_ = skip; }
+
+    //! Sets how a flush request (sync()) is handled, and when the compressor is flushed on its own. See zflushpolicy.
+    //! By default, each request flushes the compressor with zcodec::SYNC_FLUSH.
+    //!
+    //! @note   A timer (zflushpolicy::milliseconds) starts with the next file opened for output. When compressing with
+    //!         threads, every flush of the compressor is a sync flush.
+    //! @note   With a timer, the buffered output is flushed too, so every write takes a lock: characters written one
+    //!         at a time each call overflow().
+    void set_flush_policy(zflushpolicy const & policy) { flushPolicy_ = policy; }
+
+    //! Sets whether the data decompressed from files opened after this call is checksummed. See checksum().
+    void set_running_checksum(bool enable) { runningChecksum_ = enable; }
+
+    //! Returns the checksum of the data decompressed from the open file so far, if set_running_checksum() enabled it.
+    //! It is an Adler-32 for the zlib format, and a CRC-32 for the others, so for a gzip file with one member, it
+    //! matches the CRC in the trailer.
+    //!
+    //! @note   The checksum runs ahead of the reader by the data in the buffer, so it covers the whole file once the
+    //!         end is reached. A seek outside the buffer restarts it at the new position.
+    zchecksum const & checksum() const { return checksum_; }
+
+    //! Decompresses the rest of the open file without returning the data, and checks it. Returns true if the file is
+    //! intact, or false if it is damaged or truncated.
+    bool verify();
+
+    //! Returns the statistics collected so far. See zstats.
+    //!
+    //! @note   For a file written with zlib's gz functions, output that zlib has not written to the file yet is not
+    //!         included in the compressed size.
+    zstats stats() const;
+
+    //! Resets the statistics.
+    void reset_stats();
+
 protected:
 
     //! @name Overrides basic_streambuf
@@ -72,9 +215,6 @@ protected:
     //! Returns the current character from the buffer (primarily when it is empty).
     virtual int_type underflow() override;
 
-    //! Returns the current character from the buffer (primarily when it is empty) and points to the next character.
-    virtual int_type uflow() override;
-
     //! Reads @p n characters from the buffer. Returns the number of characters actually read.
     virtual std::streamsize xsgetn(char_type * s, std::streamsize n) override;
 
@@ -106,7 +246,108 @@ protected:
     void initialize(gzFile file, InitializeReason reason);
 
 private:
-    char_type putback_; // putback buffer
-    bool needsClose_;   // True if file must be closed
-    gzFile file_;       // gz file pointer
+
+    // Returns the I/O buffer, allocating it if necessary
+    char_type * ioBuffer();
+
+    // Returns the size of the I/O buffer
+    std::streamsize ioBufferSize() const { return (bufferSize_ > 0) ? bufferSize_ : 1; }
+
+    // Refills the get area from the file, preserving the putback characters. Returns false if no data was read.
+    bool fill();
+
+    // Saves the last characters of a direct read in the putback area
+    void savePutback(char_type const * end, std::streamsize n);
+
+    // Writes the contents of the put area to the file and resets it. Returns false if the write failed.
+    bool flushBuffer();
+
+    // Adds output to the I/O buffer when there is a flush timer. Returns false if the output could not be written.
+    bool hold(char_type const * s, std::streamsize n);
+
+    // Reads data from the file. Returns the number of characters read, or -1 if there was an error.
+    int read(char_type * s, unsigned n);
+
+    // Writes data to the file. Returns false if the write failed.
+    bool write(char_type const * s, std::streamsize n);
+
+    // Decompresses up to n bytes without collecting statistics. Returns the number of bytes, or -1 if it failed.
+    int decompress(char_type * s, unsigned n);
+
+    // Returns the number of compressed bytes read from or written to the file so far
+    off_type compressedOffset() const;
+
+    // Returns the number of uncompressed characters written to the compressor
+    off_type uncompressedOffset() const;
+
+    // Adds the compressed data read or written since the last count to the statistics
+    void countCompressed();
+
+    // Starts decompressing ahead of the reader if read-ahead is enabled
+    void startReadAhead();
+
+    // Starts the flush timer if the flush policy has one
+    void startTimer();
+
+    // Creates the adaptive controller and starts judging writes, if they are enabled and the format is supported
+    void startAdaptive(zcodec::Type type);
+
+    // Passes a measurement to the adaptive controller, and applies its decision
+    void adapt(size_t in, size_t out, std::chrono::nanoseconds time);
+
+    // Sets the compressor's level and strategy from the adaptive controller and whether the output is stored
+    void applySettings();
+
+    // Flushes the compressor. Returns false if it failed.
+    bool flushCodec(zcodec::Flush flush);
+
+    // Locks the compressor so that the flush timer does not use it at the same time (if there is a timer)
+    std::unique_lock<std::recursive_mutex> lockOutput() const;
+
+    char_type * buffer_;                    // I/O buffer (the get or put area is in this buffer)
+    std::streamsize bufferSize_;            // Size of the I/O buffer (0 means unbuffered)
+    std::vector<char_type> ownBuffer_;      // Storage for the I/O buffer if it was not provided by setbuf()
+    bool needsClose_;                       // True if file must be closed
+    gzFile file_;                           // gz file pointer
+    std::unique_ptr<zparallel> parallel_;   // Parallel compressor (replaces file_ when compressing with threads)
+    std::unique_ptr<zdeflater> writer_;     // Compressor (replaces file_ when writing asynchronously)
+    std::unique_ptr<zinflater> reader_;     // Decompressor (replaces file_ when reading with an index, a mapping, or
+                                            // asynchronously)
+    std::unique_ptr<zmembers> members_;     // Parallel decompressor (replaces file_ when decompressing with threads)
+    std::unique_ptr<zspeculative> speculative_; // Parallel decompressor of single members (replaces file_ when
+                                                // decompressing speculatively)
+    std::unique_ptr<zreadahead> ahead_;     // Decompresses ahead of the reader (reads from the decompressor)
+    std::unique_ptr<zflushtimer> timer_;    // Flushes the compressor when the output is idle
+    unsigned threads_;                      // Number of threads used to compress or decompress
+    int level_;                             // Compression level
+    std::pmr::memory_resource * resource_;  // Provides the zlib state (nullptr means the default)
+    bool mapped_;                           // True if files opened for reading are mapped into memory
+    bool async_;                            // True if files are read or written by a worker thread
+    bool readAhead_;                        // True if files opened for reading are decompressed ahead
+    bool speculate_;                        // True if files opened for reading with threads are decompressed
+                                            // speculatively
+    zcodec::Type codec_;                    // Format of files opened (AUTO means detected, or gzip)
+    zcodec::Options codecOptions_;          // Settings of the compressor of files in other formats
+    zflushpolicy flushPolicy_;              // How flush requests are handled
+    bool adaptive_;                         // True if files opened for output are compressed adaptively
+    zadaptive::Target adaptiveTarget_;      // What the adaptive controller aims for
+    std::unique_ptr<zadaptive> controller_; // Chooses the level and strategy of the open file (if adaptive)
+    bool skipIncompressible_;               // True if files opened for output store writes that look incompressible
+    bool probing_;                          // True if writes to the open file are judged
+    bool storing_;                          // True if the compressor of the open file is storing
+    off_type unflushed_;                    // Characters passed to the compressor since it was last flushed
+    std::streamsize held_;                  // Characters in the I/O buffer outside the put area (with a flush timer)
+    bool runningChecksum_;                  // True if the data decompressed from files is checksummed
+    zchecksum checksum_;                    // Checksum of the data decompressed from the open file
+    zstats stats_;                          // Statistics (not including the compressed size of the open file)
+    off_type compressedStart_;              // Compressed offset in the open file when the statistics were reset
 };
+
+//! A file stream buffer of unsigned bytes
+typedef basic_zfilebuf<unsigned char> zfilebuf;
+
+//! A file stream buffer of @c char
+typedef basic_zfilebuf<char> czfilebuf;
+
+extern template class basic_zfilebuf<unsigned char>;
+extern template class basic_zfilebuf<char>;
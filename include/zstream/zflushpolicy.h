@@ -0,0 +1,78 @@
+/** @file *//********************************************************************************************************
+
+                                                   zflushpolicy.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zflushpolicy.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include "zcodec.h"
+
+#include <cstddef>
+
+//! How a compressing stream buffer responds to a request to flush (@c flush() or @c std::endl), and when it flushes
+//! on its own.
+//!
+//! Each flush of the compressor costs ratio and time (zlib ends the block and, for a sync flush, writes an empty
+//! stored block), so a writer that flushes after every line pays for it on every line. A policy can ignore the
+//! requests, or make them cheaper, and instead flush every few bytes or once the output has been idle for a while,
+//! which bounds how long a reader of a file that is being written waits for the data.
+//!
+//! @code
+//!     ozfstream out;
+//!     out.set_flush_policy(zflushpolicy(zflushpolicy::NO_FLUSH, 0, 100)); // Flush 100 ms after the last write
+//! @endcode
+struct zflushpolicy
+{
+    //! What a flush request does
+    enum Mode
+    {
+        IGNORE_REQUEST, //!< Nothing. The buffered output stays in the buffer.
+        NO_FLUSH,       //!< The buffered output is passed to the compressor, but the compressor is not flushed.
+        PARTIAL_FLUSH,  //!< The compressor is flushed with zcodec::PARTIAL_FLUSH
+        SYNC_FLUSH,     //!< The compressor is flushed with zcodec::SYNC_FLUSH
+        FULL_FLUSH      //!< The compressor is flushed with zcodec::FULL_FLUSH
+    };
+
+    Mode mode;              //!< What a flush request does
+    size_t bytes;           //!< If not 0, the compressor is flushed each time this many characters have been passed to
+                            //!< it since the last flush
+    unsigned milliseconds;  //!< If not 0, the compressor is flushed by a background timer once no characters have been
+                            //!< passed to it for this long. Only file buffers support it.
+
+    //! Constructor
+    //!
+    //! @param	mode            What a flush request does
+    //! @param	bytes           Flush every time this many characters have been compressed, or 0 for never
+    //! @param	milliseconds    Flush once the output has been idle this long, or 0 for never
+    zflushpolicy(Mode mode = SYNC_FLUSH, size_t bytes = 0, unsigned milliseconds = 0)
+        : mode(mode)
+        , bytes(bytes)
+        , milliseconds(milliseconds)
+    {
+    }
+
+    //! Returns the compressor's flush mode for a flush request (zcodec::NO_FLUSH if it does not flush the compressor).
+    zcodec::Flush requested() const
+    {
+        return (mode == PARTIAL_FLUSH) ? zcodec::PARTIAL_FLUSH
+             : (mode == SYNC_FLUSH)    ? zcodec::SYNC_FLUSH
+             : (mode == FULL_FLUSH)    ? zcodec::FULL_FLUSH
+                                       : zcodec::NO_FLUSH;
+    }
+
+    //! Returns the compressor's flush mode for the flushes after @c bytes or @c milliseconds. It is the mode of a
+    //! request, or zcodec::SYNC_FLUSH if a request does not flush the compressor.
+    zcodec::Flush automatic() const
+    {
+        zcodec::Flush const flush = requested();
+        return (flush != zcodec::NO_FLUSH) ? flush : zcodec::SYNC_FLUSH;
+    }
+};
@@ -0,0 +1,63 @@
+/** @file *//********************************************************************************************************
+
+                                                   zflushtimer.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zflushtimer.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+//! Performs an action on a helper thread once its owner has been idle for a while.
+//!
+//! The owner calls touch() whenever it is active, and the action is performed when touch() has not been called for
+//! the delay. The action is performed with the lock held, and the owner holds the lock (see lock()) while it uses
+//! anything that the action uses, so the two never run at the same time.
+class zflushtimer
+{
+public:
+    //! The action. It is called by the helper with the lock held.
+    typedef std::function<void()> action_type;
+
+    // Constructor
+    zflushtimer(std::chrono::milliseconds delay, action_type action);
+
+    // Destructor
+    ~zflushtimer();
+
+    //! Locks the owner's state, waiting until the action is not being performed. The lock is recursive.
+    std::unique_lock<std::recursive_mutex> lock() { return std::unique_lock<std::recursive_mutex>(mutex_); }
+
+    //! Restarts the delay. The lock must be held.
+    void touch();
+
+private:
+
+    // Non-copyable
+    zflushtimer(zflushtimer const &) = delete;
+    zflushtimer & operator =(zflushtimer const &) = delete;
+
+    // Helper thread
+    void helper();
+
+    std::chrono::milliseconds delay_;                   // Idle time before the action is performed
+    action_type action_;                                // The action
+
+    std::recursive_mutex mutex_;                        // Guards everything below and the owner's state
+    std::condition_variable_any changed_;               // Signaled when the timer is started or must stop
+    std::chrono::steady_clock::time_point deadline_;    // When the action is due
+    bool armed_;                                        // True if the action is due at the deadline
+    bool stop_;                                         // True when the helper must exit
+    std::thread helper_;                                // Helper thread
+};
@@ -14,25 +14,29 @@
 #pragma once
 
 #include "zfilebuf.h"
+#include "zindex.h"
 
 #include <istream>
 #include <ostream>
 
 //! An input stream that decompresses the data using @c zlib from a file.
-class izfstream : public std::basic_istream<unsigned char, std::char_traits<unsigned char> >
+//!
+//! The template parameters are those of basic_zfilebuf.
+template <class CharT, class Traits = std::char_traits<CharT> >
+class basic_izfstream : public std::basic_istream<CharT, Traits>
 {
 public:
-    typedef unsigned char char_type;                                    //!< Element type
-    typedef std::char_traits<unsigned char>             traits_type;    //!< The element type's traits (not used, included for
-                                                                        // completeness)
+    typedef CharT char_type;                                            //!< Element type
+    typedef Traits                                      traits_type;    //!< The element type's traits
     typedef std::basic_istream<char_type, traits_type>  base_type;      //!< Base class type
     typedef std::basic_ios<char_type, traits_type>      ios_type;       //!< IOS type
+    typedef basic_zfilebuf<char_type, traits_type>      buf_type;       //!< The file buffer class
 
     // Constructor
-    explicit izfstream(char const * name = nullptr);
+    explicit basic_izfstream(char const * name = nullptr);
 
     //! Returns a pointer to the file buffer
-    zfilebuf * rdbuf() const { return const_cast<zfilebuf *>(&fileBuffer_); }
+    buf_type * rdbuf() const { return const_cast<buf_type *>(&fileBuffer_); }
 
     //! Returns true if the file is open
     bool is_open() const { return fileBuffer_.is_open();  }
@@ -43,22 +47,93 @@ public:
     //! Closes the file
     void close();
 
+    //! Builds the index of a file and saves it as its sidecar file, so that it is used when the file is opened.
+    //!
+    //! @param	name	Name of the file
+    //! @param	span	Amount of decompressed data between access points. A seek decompresses at most this much data.
+    //!
+    //! @return false if the index could not be built or saved
+    static bool build_index(char const * name, std::streamoff span = zindex::DEFAULT_SPAN);
+
+    //! Sets the memory resource that provides the zlib state. This must be called before the file is opened.
+    //!
+    //! @param	resource	Memory resource, or nullptr to use the default allocation. It must outlive the stream. If
+    //!                     decompressing with threads, it must be thread-safe.
+    void set_allocator(std::pmr::memory_resource * resource) { fileBuffer_.set_allocator(resource); }
+
+    //! Sets the number of threads used to decompress a file with several gzip members. This must be called before
+    //! the file is opened.
+    //!
+    //! @param	threads	Number of threads. If 0, the number of hardware threads is used. If 1, the file is
+    //!                 decompressed by the reader. A file with a sidecar index is always decompressed by the reader.
+    void set_threads(unsigned threads) { fileBuffer_.set_threads(threads); }
+
+    //! Sets whether the file is mapped into memory instead of being read. This must be called before the file is
+    //! opened.
+    //!
+    //! Mapping avoids copying the compressed data. Only gzip files are mapped; other files are read normally.
+    void set_memory_mapped(bool mapped) { fileBuffer_.set_memory_mapped(mapped); }
+
+    //! Sets whether the file is read ahead by a worker thread while the data is decompressed. This must be called
+    //! before the file is opened.
+    void set_async_io(bool async) { fileBuffer_.set_async_io(async); }
+
+    //! Sets whether the data is decompressed ahead of the reader by a helper thread. This must be called before the
+    //! file is opened.
+    //!
+    //! Sequential reading then takes about as long as the slower of decompressing and processing the data, rather
+    //! than the sum of the two.
+    void set_read_ahead(bool readAhead) { fileBuffer_.set_read_ahead(readAhead); }
+
+    //! Sets whether a file with a single gzip member is also decompressed with threads (see set_threads()). This
+    //! must be called before the file is opened.
+    //!
+    //! The compressed data is split into chunks that are decompressed concurrently, starting at positions that are
+    //! guessed to be the start of a deflate block. The output is verified against the chain of blocks, so a wrong
+    //! guess only costs time.
+    void set_speculative(bool speculate) { fileBuffer_.set_speculative(speculate); }
+
+    //! Sets the format of the file. This must be called before the file is opened.
+    //!
+    //! @param	type	Format. AUTO (the default) detects gzip, zstd, and lz4 files from their first bytes, and passes
+    //!                 other files through. zlib and raw deflate files must be specified.
+    void set_codec(zcodec::Type type) { fileBuffer_.set_codec(type); }
+
+    //! Sets whether the decompressed data is checksummed, so that it does not have to be checksummed again. This
+    //! must be called before the file is opened.
+    //!
+    //! @param	enable	True to checksum it. See checksum().
+    void set_running_checksum(bool enable) { fileBuffer_.set_running_checksum(enable); }
+
+    //! Returns the checksum of the data decompressed so far: a CRC-32, or an Adler-32 for the zlib format. It runs
+    //! ahead of the reader by the buffered data, so it covers the whole file once the end is reached.
+    zchecksum const & checksum() const { return fileBuffer_.checksum(); }
+
+    //! Decompresses the rest of the file without returning the data, and checks it. This is faster than reading it.
+    //!
+    //! @return true if the file is intact, or false if it is damaged or truncated
+    bool verify() { return fileBuffer_.verify(); }
+
 private:
-    zfilebuf fileBuffer_;
+    buf_type fileBuffer_;
 };
 
 //! A output stream that compresses the data using @c zlib to a file.
-class ozfstream : public std::basic_ostream<unsigned char, std::char_traits<unsigned char> >
+//!
+//! The template parameters are those of basic_zfilebuf.
+template <class CharT, class Traits = std::char_traits<CharT> >
+class basic_ozfstream : public std::basic_ostream<CharT, Traits>
 {
 public:
-    typedef unsigned char char_type;                        //!< Element type
-    typedef std::char_traits<unsigned char> traits_type;    //!< The element type's traits (not used, included for completeness)
+    typedef CharT char_type;                                    //!< Element type
+    typedef Traits traits_type;                                 //!< The element type's traits
+    typedef basic_zfilebuf<char_type, traits_type> buf_type;    //!< The file buffer class
 
     // Constructor
-    explicit ozfstream(const char * name = nullptr);
+    explicit basic_ozfstream(const char * name = nullptr);
 
     //! Returns a pointer to filebuffer
-    zfilebuf * rdbuf() const { return const_cast<zfilebuf *>(&fileBuffer_); }
+    buf_type * rdbuf() const { return const_cast<buf_type *>(&fileBuffer_); }
 
     //! Returns true if a file is opened
     bool is_open() const { return fileBuffer_.is_open();  }
@@ -74,8 +149,82 @@ public:
     //! @param	level	Compression level. 0 is no compression, 9 is maximum compression.
     void set_compression(int level) { fileBuffer_.set_compression(level); }
 
+    //! Sets the number of threads used to compress.
+    //!
+    //! @param	threads	Number of threads. 1 (the default) compresses on the calling thread, and 0 uses all the
+    //!                 hardware threads. With more than one thread, the data is compressed in blocks in parallel,
+    //!                 and the file is still a single gzip member.
+    //!
+    //! @note   This must be called before the file is opened.
+    void set_threads(unsigned threads) { fileBuffer_.set_threads(threads); }
+
+    //! Sets whether the compressed data is written by a worker thread while more data is compressed. This must be
+    //! called before the file is opened.
+    //!
+    //! @note   When compressing with threads, the compressed data is always written by a separate thread.
+    void set_async_io(bool async) { fileBuffer_.set_async_io(async); }
+
+    //! Sets the format of the file and the settings of the compressor. This must be called before the file is opened.
+    //!
+    //! @param	type	Format. AUTO (the default) is gzip.
+    //! @param	options	Settings, including the level. A file in another format is compressed on the calling thread
+    //!                 and written asynchronously.
+    void set_codec(zcodec::Type type, zcodec::Options const & options = zcodec::Options())
+    {
+        fileBuffer_.set_codec(type, options);
+    }
+
+    //! Sets the memory resource that provides the zlib state. This must be called before the file is opened.
+    //!
+    //! @param	resource	Memory resource, or nullptr to use the default allocation. It must outlive the stream. If
+    //!                     compressing with threads, it must be thread-safe.
+    void set_allocator(std::pmr::memory_resource * resource) { fileBuffer_.set_allocator(resource); }
+
+    //! Sets how @c flush() and @c std::endl are handled, and when the compressor is flushed on its own.
+    //!
+    //! @param	policy	Flush policy. See zflushpolicy. By default, each flush flushes the compressor. A timer
+    //!                 (zflushpolicy::milliseconds) starts when the file is opened, so it must be set before that.
+    void set_flush_policy(zflushpolicy const & policy) { fileBuffer_.set_flush_policy(policy); }
+
+    //! Enables or disables adaptive compression, which chooses the level and strategy of each block of data from the
+    //! ratio and speed of the previous blocks. This must be called before the file is opened.
+    //!
+    //! @param	adaptive    True to enable it
+    //! @param	target      What it aims for. See zadaptive. The file must be gzip or another zlib format, compressed
+    //!                     without threads.
+    void set_adaptive(bool adaptive, zadaptive::Target const & target = zadaptive::Target())
+    {
+        fileBuffer_.set_adaptive(adaptive, target);
+    }
+
+    //! Returns the adaptive controller (for its decisions), or nullptr if there is none.
+    zadaptive const * adaptive() const { return fileBuffer_.adaptive(); }
+
+    //! Sets whether output that looks incompressible (already compressed, encrypted, or random) is stored instead of
+    //! compressed. This must be called before the file is opened.
+    //!
+    //! @param	skip    True to store it. The file must be gzip or another zlib format, compressed without threads.
+    void set_skip_incompressible(bool skip) { fileBuffer_.set_skip_incompressible(skip); }
+
 private:
     typedef std::basic_ios<char_type, traits_type> ios_type;
 
-    zfilebuf fileBuffer_;
+    buf_type fileBuffer_;
 };
+
+//! An input stream of unsigned bytes from a compressed file
+typedef basic_izfstream<unsigned char> izfstream;
+
+//! An output stream of unsigned bytes to a compressed file
+typedef basic_ozfstream<unsigned char> ozfstream;
+
+//! An input stream of @c char from a compressed file. It can be passed to code that reads a @c std::istream.
+typedef basic_izfstream<char> iczfstream;
+
+//! An output stream of @c char to a compressed file. It can be passed to code that writes a @c std::ostream.
+typedef basic_ozfstream<char> oczfstream;
+
+extern template class basic_izfstream<unsigned char>;
+extern template class basic_ozfstream<unsigned char>;
+extern template class basic_izfstream<char>;
+extern template class basic_ozfstream<char>;
@@ -0,0 +1,83 @@
+/** @file *//********************************************************************************************************
+
+                                                      zindex.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zindex.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include <ios>
+#include <string>
+#include <vector>
+
+//! An index of access points into a gzip file, allowing random access to the decompressed data.
+//!
+//! An access point is a place where decompression can be started without decompressing the data before it. It is
+//! made at a deflate block boundary and includes the 32 KB of decompressed data preceding it. The index is built in
+//! one pass through the file and can be saved as a sidecar file, which izfstream loads when it opens the file. A seek
+//! then costs at most the decompression of the data between two access points.
+class zindex
+{
+public:
+    typedef unsigned char   char_type;  //!< Element type
+    typedef std::streamoff  off_type;   //!< Holds a file offset
+
+    //! Sizes
+    enum
+    {
+        DEFAULT_SPAN = 1024 * 1024, //!< Default amount of decompressed data between access points
+        WINDOW_SIZE  = 32 * 1024    //!< Amount of decompressed data preceding an access point that it needs
+    };
+
+    //! An access point
+    struct point
+    {
+        off_type out;                   //!< Offset of the access point in the decompressed data
+        off_type in;                    //!< Offset of the first full byte of the access point in the file
+        int bits;                       //!< Number of bits of the preceding byte in the file that belong to it
+        std::vector<char_type> window;  //!< Preceding decompressed data (compressed)
+    };
+
+    // Constructor
+    zindex();
+
+    //! Builds the index of a gzip file. Returns false if the file could not be read or is not valid.
+    bool build(char const * name, off_type span = DEFAULT_SPAN);
+
+    //! Loads an index. Returns false if the index could not be read.
+    bool load(char const * name);
+
+    //! Saves the index. Returns false if the index could not be written.
+    bool save(char const * name) const;
+
+    //! Returns the last access point at or before an offset in the decompressed data, or nullptr if there is none.
+    point const * locate(off_type offset) const;
+
+    //! Decompresses the data preceding an access point. Returns false if it could not be decompressed.
+    bool window(point const & p, char_type * window) const;
+
+    //! Returns the size of the decompressed data.
+    off_type length() const { return length_; }
+
+    //! Returns the size of the gzip file the index was built from.
+    off_type compressed_size() const { return compressedSize_; }
+
+    //! Returns the number of access points.
+    size_t size() const { return points_.size(); }
+
+    //! Returns the name of the sidecar file holding the index of a file.
+    static std::string sidecar(char const * name) { return std::string(name) + ".zidx"; }
+
+private:
+
+    std::vector<point> points_; // Access points, in order
+    off_type length_;           // Size of the decompressed data
+    off_type compressedSize_;   // Size of the gzip file
+};
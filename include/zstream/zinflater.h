@@ -0,0 +1,128 @@
+/** @file *//********************************************************************************************************
+
+                                                     zinflater.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zinflater.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include "zasyncfile.h"
+#include "zcodec.h"
+#include "zindex.h"
+#include "zmapping.h"
+#include "zlib/zlib.h"
+#include <cstdio>
+#include <ios>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+//! Decompresses a gzip file, using a zindex to seek.
+//!
+//! Without an index, it behaves like @c gzread() and @c gzseek(): a backward seek restarts from the beginning of the
+//! file. With an index, a seek restarts from the nearest access point before the target.
+//!
+//! The file is read with @c fread(), read ahead by a worker thread, or mapped into memory and decompressed directly
+//! from the mapping.
+//!
+//! Files in the other formats of zcodec are also decompressed, but an index cannot be used with them.
+//!
+//! @note	When decompression is restarted from an access point, the CRC of that gzip member cannot be checked.
+class zinflater
+{
+public:
+    typedef unsigned char   char_type;  //!< Element type
+    typedef std::streamoff  off_type;   //!< Holds a file offset
+
+    //! How the compressed data is obtained
+    enum Input
+    {
+        READ_INPUT,     //!< Read with fread()
+        ASYNC_INPUT,    //!< Read ahead by a worker thread while the data is decompressed (see zasyncfile)
+        MAPPED_INPUT    //!< Mapped into memory (see zmapping)
+    };
+
+    // Constructor
+    explicit zinflater(std::pmr::memory_resource * resource = nullptr);
+
+    // Destructor
+    ~zinflater();
+
+    //! Opens a compressed file. Returns false if it could not be opened.
+    //!
+    //! @param	name	Name of the file
+    //! @param	input	How the compressed data is obtained. Unless it is READ_INPUT, a gzip file must start with a
+    //!                 gzip header.
+    //! @param	type	Format of the file. If it is AUTO, a zstd or lz4 file is detected from its first bytes.
+    bool open(char const * name, Input input = READ_INPUT, zcodec::Type type = zcodec::GZIP);
+
+    //! Closes the file. Returns false if there was an error.
+    bool close();
+
+    //! Returns true if a file is open.
+    bool is_open() const { return file_ != nullptr || async_.is_open() || mapping_.is_open(); }
+
+    //! Sets the index used to seek. Returns false if the index was not built from this file.
+    bool set_index(std::shared_ptr<zindex const> index);
+
+    //! Returns the index used to seek, or nullptr if there is none.
+    zindex const * index() const { return index_.get(); }
+
+    //! Reads up to @p n characters. Returns the number read, or -1 if there was an error.
+    int read(char_type * s, unsigned n);
+
+    //! Moves to an offset in the decompressed data. Returns false if it failed.
+    bool seek(off_type offset);
+
+    //! Returns the current offset in the decompressed data.
+    off_type tell() const { return position_; }
+
+    //! Returns the number of compressed bytes consumed so far.
+    off_type offset() const;
+
+    //! Returns the total number of characters decompressed and discarded by seeks.
+    off_type skipped() const { return skipped_; }
+
+private:
+
+    // Restarts decompression at the beginning of the file
+    bool rewind();
+
+    // Restarts decompression at an access point
+    bool restart(zindex::point const & p);
+
+    // Decompresses and discards @p n characters
+    bool skip(off_type n);
+
+    // Reads compressed data until at least @p n characters are available. Returns false if there are fewer.
+    bool refill(unsigned n);
+
+    // Moves the file pointer
+    bool position(off_type offset);
+
+    // Reads the next byte of the file. Returns EOF if there are no more.
+    int next();
+
+    FILE * file_;                           // Compressed file (if it is read with fread())
+    zasyncfile async_;                      // Compressed file (if it is read ahead)
+    zmapping mapping_;                      // Compressed file (if it is mapped)
+    off_type mapped_;                       // Offset of the mapped data not yet handed to zlib
+    z_stream stream_;                       // zlib state (its input fields also track the input of codec_)
+    std::unique_ptr<zcodec> codec_;         // Decompressor of the other formats (nullptr for gzip)
+    std::pmr::memory_resource * resource_;  // Provides the zlib state
+    bool raw_;                              // True if decompressing raw deflate data from an access point
+    bool end_;                              // True if the end of the data has been reached
+    bool error_;                            // True if there was an error
+    off_type position_;                     // Offset in the decompressed data
+    off_type size_;                         // Size of the file
+    off_type skipped_;                      // Characters decompressed and discarded by seeks
+    std::vector<char_type> input_;          // Compressed data read from the file
+    std::shared_ptr<zindex const> index_;   // Access points
+};
@@ -0,0 +1,59 @@
+/** @file *//********************************************************************************************************
+
+                                                     zmapping.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zmapping.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+
+//! A read-only memory mapping of a file.
+class zmapping
+{
+public:
+    typedef unsigned char char_type;    //!< Element type
+
+    // Constructor
+    zmapping();
+
+    // Destructor
+    ~zmapping();
+
+    //! Maps a file. Returns false if it could not be mapped (for example, if it is empty or not a regular file).
+    bool open(char const * name);
+
+    //! Unmaps the file.
+    void close();
+
+    //! Returns true if a file is mapped.
+    bool is_open() const { return data_ != nullptr; }
+
+    //! Returns the contents of the file.
+    char_type const * data() const { return data_; }
+
+    //! Returns the size of the file.
+    size_t size() const { return size_; }
+
+    //! Tells the system that a range of the file will be needed soon, so it can start reading it.
+    void prefetch(size_t offset, size_t size) const;
+
+private:
+
+    // Non-copyable
+    zmapping(zmapping const &) = delete;
+    zmapping & operator =(zmapping const &) = delete;
+
+    char_type const * data_;    // Mapped contents
+    size_t size_;               // Size of the file
+#if defined(_WIN32)
+    void * mapping_;            // Handle of the file mapping object
+#endif
+};
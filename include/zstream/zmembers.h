@@ -0,0 +1,154 @@
+/** @file *//********************************************************************************************************
+
+                                                     zmembers.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zmembers.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include "zmapping.h"
+#include "zlib/zlib.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <ios>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! Decompresses the members of a multi-member gzip file concurrently, using a pool of threads.
+//!
+//! The file is mapped into memory and scanned for gzip headers. Each header starts a job that decompresses the
+//! member following it. The data is delivered in order by following the chain of members from the beginning of the
+//! file, so a header that turns out to be inside the compressed data of another member is simply ignored. zlib
+//! checks the CRC and size of each member.
+//!
+//! A member that decompresses to more than a limit is not held in memory. Its job stops at the limit and the rest
+//! of the member is decompressed by the reader as it is read.
+class zmembers
+{
+public:
+    typedef unsigned char   char_type;  //!< Element type
+    typedef std::streamoff  off_type;   //!< Holds a file offset
+
+    //! Sizes
+    enum
+    {
+        DEFAULT_MAX_MEMBER_SIZE = 8 * 1024 * 1024   //!< Default limit on the data held for a member
+    };
+
+    // Constructor
+    zmembers(unsigned                    threads,
+             size_t                      maxMemberSize = DEFAULT_MAX_MEMBER_SIZE,
+             std::pmr::memory_resource * resource      = nullptr);
+
+    // Destructor
+    ~zmembers();
+
+    //! Opens a gzip file. Returns false if it could not be opened, or if it is not a gzip file.
+    bool open(char const * name);
+
+    //! Closes the file. Returns false if there was an error.
+    bool close();
+
+    //! Returns true if a file is open.
+    bool is_open() const { return mapping_.is_open(); }
+
+    //! Reads up to @p n characters. Returns the number read, or -1 if there was an error.
+    int read(char_type * s, unsigned n);
+
+    //! Moves to an offset in the decompressed data. Returns false if it failed.
+    //!
+    //! @note	A backward seek restarts from the beginning of the file.
+    bool seek(off_type offset);
+
+    //! Returns the current offset in the decompressed data.
+    off_type tell() const { return position_; }
+
+    //! Returns the number of compressed bytes consumed so far.
+    off_type offset() const;
+
+    //! Returns the total number of characters decompressed and discarded by seeks.
+    off_type skipped() const { return skipped_; }
+
+private:
+
+    // Job status
+    enum Status
+    {
+        PENDING,    // Waiting to be decompressed, or being decompressed
+        DONE,       // The member has been decompressed
+        PARTIAL,    // The member is larger than the limit and the rest must be decompressed by the reader
+        FAILED      // The data is not a valid member
+    };
+
+    // Decompresses the member starting at an offset
+    struct Job
+    {
+        size_t start;                   // Offset of the member
+        size_t end;                     // Offset following the member (if DONE)
+        std::vector<char_type> output;  // Decompressed data
+        z_stream stream;                // State of the decompression (if PARTIAL)
+        Status status;                  // Status
+        std::atomic<bool> cancelled;    // True if the result is no longer needed
+
+        Job(size_t start);
+        ~Job();
+    };
+
+    // Non-copyable
+    zmembers(zmembers const &) = delete;
+    zmembers & operator =(zmembers const &) = delete;
+
+    // Returns true if a gzip header may start at the offset
+    bool isHeader(size_t offset) const;
+
+    // Queues jobs for the member at next_ and for the headers following it. The mutex must be held.
+    void schedule();
+
+    // Waits for the job decompressing the member at next_ and makes it current. Returns false at the end of the data.
+    bool advance();
+
+    // Gives a stream the rest of the input
+    void supply(z_stream & stream) const;
+
+    // Stops the workers and discards the jobs
+    void stop();
+
+    // Starts the workers at the beginning of the file
+    void start();
+
+    // Worker thread
+    void worker();
+
+    unsigned threads_;                                      // Number of worker threads
+    size_t maxMemberSize_;                                  // Limit on the data held for a member
+    std::pmr::memory_resource * resource_;                  // Provides the zlib state
+    zmapping mapping_;                                      // The compressed file
+    size_t maxPending_;                                     // Maximum number of jobs ahead of the reader
+    size_t next_;                                           // Offset of the next member to be read
+    size_t scan_;                                           // Offset where the search for headers continues
+    std::shared_ptr<Job> current_;                          // Job being read
+    size_t consumed_;                                       // Amount of the current job's output that has been read
+    off_type position_;                                     // Offset in the decompressed data
+    off_type skipped_;                                      // Characters decompressed and discarded by seeks
+    bool error_;                                            // True if there was an error
+
+    std::mutex mutex_;                                      // Guards everything below
+    std::condition_variable jobReady_;                      // Signaled when a job is queued
+    std::condition_variable jobDone_;                       // Signaled when a job is finished
+    std::map<size_t, std::shared_ptr<Job> > jobs_;          // Jobs ahead of the reader, by offset
+    std::deque<std::shared_ptr<Job> > queue_;               // Jobs waiting for a worker
+    bool stop_;                                             // True when the workers must exit
+    std::vector<std::thread> workers_;                      // Worker threads
+};
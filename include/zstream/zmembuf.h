@@ -13,48 +13,155 @@
 
 #pragma once
 
+#include "zadaptive.h"
+#include "zchecksum.h"
+#include "zcodec.h"
+#include "zdictionary.h"
+#include "zflushpolicy.h"
+#include "zstats.h"
 #include "zlib/zlib.h"
+#include <chrono>
+#include <memory>
+#include <memory_resource>
 #include <streambuf>
+#include <string>
 #include <vector>
 
-//! A memory stream buffer that compresses and decompresses data using @c zlib
-class zmembuf : public std::basic_streambuf<unsigned char, std::char_traits<unsigned char> >
+//! A memory stream buffer that compresses and decompresses data using @c zlib, or another codec (see zcodec)
+//!
+//! @param	CharT       Element type. It must be the size of a byte (@c char, @c signed @c char, or @c unsigned
+//!                     @c char).
+//! @param	Traits      The element type's traits
+//! @param	Container   Holds the compressed data. It must provide @c data(), @c size(), @c capacity(), @c resize(),
+//!                     @c clear(), @c assign(first, last), @c shrink_to_fit() and @c swap(), like @c std::vector and
+//!                     @c std::basic_string.
+//!
+//! @note   The members are instantiated in the library for the zmembuf and czmembuf types, and for @c char with
+//!         @c std::vector<char>.
+template <class CharT, class Traits = std::char_traits<CharT>, class Container = std::vector<CharT> >
+class basic_zmembuf : public std::basic_streambuf<CharT, Traits>
 {
+    static_assert(sizeof(CharT) == 1, "basic_zmembuf only supports elements the size of a byte");
+
 public:
-    typedef unsigned char char_type;                    //!< Element type
-    typedef std::char_traits<char_type> traits_type;    //!< The element's traits
+    typedef CharT char_type;                            //!< Element type
+    typedef Traits traits_type;                         //!< The element's traits
 
     typedef std::basic_streambuf<char_type, traits_type>    streambuf_type; //!< The streambuf base class
-    typedef std::vector<char_type>                          container_type; //!< The data container class
+    typedef Container                                       container_type; //!< The data container class
+
+    typedef typename traits_type::int_type int_type;    //!< Holds values not representable by char_type
+    typedef typename traits_type::pos_type pos_type;    //!< Holds a buffer position
+    typedef typename traits_type::off_type off_type;    //!< Holds a buffer offset
 
-    typedef traits_type::int_type int_type;     //!< Holds values not representable by char_type
-    typedef traits_type::pos_type pos_type;     //!< Holds a buffer position
-    typedef traits_type::off_type off_type;     //!< Holds a buffer offset
+    //! Buffer sizes
+    enum
+    {
+        WINDOW_SIZE  = 64 * 1024,   //!< Size of the window holding uncompressed data
+        PUTBACK_SIZE = 16           //!< Number of characters that can always be put back after a read
+    };
 
     // Constructor
-    explicit zmembuf(std::ios_base::openmode mode);
+    explicit basic_zmembuf(std::ios_base::openmode mode, std::pmr::memory_resource * resource = nullptr);
 
     // Constructor
-    zmembuf(container_type const & data, std::ios_base::openmode mode);
+    basic_zmembuf(container_type const &      data,
+                  std::ios_base::openmode     mode,
+                  std::pmr::memory_resource * resource = nullptr);
 
     // Constructor
-    zmembuf(char_type const * data, size_t size, std::ios_base::openmode mode);
+    basic_zmembuf(char_type const *           data,
+                  size_t                      size,
+                  std::ios_base::openmode     mode,
+                  std::pmr::memory_resource * resource = nullptr);
 
     // Destructor
-    virtual ~zmembuf();
+    virtual ~basic_zmembuf();
 
     //! Returns a reference to the data in the buffer.
     container_type const & buffer() const;
 
+    //! Moves the data out of the buffer and resets it.
+    container_type release();
+
+    //! Moves the data out of the buffer into a container and resets it.
+    void release(container_type & data);
+
     //! Replaces the current data in the buffer.
     void buffer(container_type const & data);
 
     //! Replaces the current data in the buffer.
     void buffer(char_type const * data, size_t size);
 
+    //! Replaces the current data in the buffer with data that is decompressed in place, without copying it.
+    void borrow(char_type const * data, size_t size);
+
+    //! Empties the buffer so it can be reused, without releasing the zlib state or the storage.
+    void reset();
+
     //! Sets the compression level.
     void set_compression(int level);
 
+    //! Sets the format of the compressed data and the settings of the compressor.
+    void set_codec(zcodec::Type type, zcodec::Options const & options = zcodec::Options());
+
+    //! Sets the preset dictionary used to compress or decompress the data. See zdictionary.
+    void set_dictionary(std::shared_ptr<zdictionary const> dictionary);
+
+    //! Returns the preset dictionary, or nullptr if there is none.
+    std::shared_ptr<zdictionary const> const & dictionary() const { return options_.dictionary; }
+
+    //! Enables or disables adaptive compression, which chooses the level and strategy of each block of data from the
+    //! ratio and speed of the previous blocks. See zadaptive.
+    //!
+    //! @note   The controller starts from the current level, and it is kept across resets, so it learns from all the
+    //!         messages. Only the zlib formats are adapted.
+    void set_adaptive(bool adaptive, zadaptive::Target const & target = zadaptive::Target());
+
+    //! Returns the adaptive controller (for its decisions), or nullptr if adaptive compression is disabled.
+    zadaptive const * adaptive() const { return controller_.get(); }
+
+    //! Sets whether output that looks incompressible (already compressed, encrypted, or random) is stored instead of
+    //! compressed. Each write is judged separately (a large write, a piece at a time), and compression resumes with
+    //! the first write that looks compressible. See zadaptive::incompressible().
+    //!
+    //! @note   Only the zlib formats are supported. Writes of less than zadaptive::MIN_PROBE_SIZE characters keep the
+    //!         setting of the previous write.
+    void set_skip_incompressible(bool skip) { skipIncompressible_ = skip; }
+
+    //! Sets how a flush request (sync()) is handled, and when the compressor is flushed on its own. See zflushpolicy.
+    //! By default, a request only passes the buffered output to the compressor (zflushpolicy::NO_FLUSH).
+    //!
+    //! @note   zflushpolicy::milliseconds is not supported, because the data is only read through this buffer.
+    void set_flush_policy(zflushpolicy const & policy) { flushPolicy_ = policy; }
+
+    //! Sets whether the decompressed data is checksummed. See checksum().
+    void set_running_checksum(bool enable) { runningChecksum_ = enable; }
+
+    //! Returns the checksum of the data decompressed so far, if set_running_checksum() enabled it. It is an Adler-32
+    //! for the zlib format, and a CRC-32 for the others, so it matches the checksum in the trailer of zlib data and
+    //! of a gzip member.
+    //!
+    //! @note   The checksum runs ahead of the reader by the data in the window, so it covers all the data once the
+    //!         end is reached. Data skipped by a seek is included, and a seek backward restarts it at the beginning.
+    zchecksum const & checksum() const { return checksum_; }
+
+    //! Decompresses the rest of the data without returning it, and checks it. Returns true if the data is intact, or
+    //! false if it is damaged or truncated.
+    bool verify();
+
+    //! Returns the format of the compressed data. For an input buffer, this is the format detected in the data.
+    zcodec::Type codec() const { return codec_ ? codec_->type() : type_; }
+
+    //! Returns the memory resource that provides the zlib state, or nullptr if zlib's default allocation is used.
+    std::pmr::memory_resource * resource() const { return resource_; }
+
+    //! Returns the statistics collected so far. See zstats.
+    zstats const & stats() const { return stats_; }
+
+    //! Resets the statistics.
+    void reset_stats() { stats_ = zstats(); }
+
 protected:
 
     //! @name Overrides basic_streambuf
@@ -66,6 +173,7 @@ protected:
     //! Puts a character back into the buffer. Returns the character or traits_type::eof() if it failed.
     virtual int_type pbackfail(int_type meta = traits_type::eof()) override;
 
+    //! Returns the number of characters that can be read without decompressing, or -1 if there are no more.
     virtual std::streamsize showmanyc() override;
 
     //! Returns the current character from the buffer (primarily when it is empty).
@@ -92,6 +200,9 @@ protected:
 
     //	virtual streambuf_type * setbuf( char_type * _Buffer, std::streamsize _Count ) override;
 
+    //! Compresses any buffered output. Returns 0 if successful.
+    virtual int sync() override;
+
     //	virtual void imbue(const locale&);
 
     //@}
@@ -101,30 +212,136 @@ private:
     // Stream state bits
     enum StreamStateBit
     {
-        RO_BIT = 0, // Character array is immutable
-        WO_BIT = 1  // Character array cannot be read
+        RO_BIT = 1 << 0,    // Character array is immutable
+        WO_BIT = 1 << 1     // Character array cannot be read
     };
     typedef int StreamState;  //!< Stream state
 
     // Initialization
-    void initialize(container_type const & data, StreamState state);
+    void initialize(char_type const * data, size_t size, StreamState state, bool copy);
 
     // Cleanup
     void tidy();
 
-    // Syncs the buffer, ensuring that all the data has been compressed/decompressed.
-    void sync() const;
+    // Finishes the compressed data, ensuring that all the data has been compressed.
+    void finish();
 
     // Returns a stream state converted from an open mode
     StreamState streamState(std::ios_base::openmode mode);
 
-    // Make sure there is enough room in the container to hold this many bytes of additional output
-    void grow(size_t size);
+    // Makes room in the container for at least the given amount of output. The container grows geometrically.
+    void grow(size_t needed);
+
+    // Creates the codec for the data, or resets the current one if it is the right one
+    void prepare(zcodec::char_type const * data, size_t size);
+
+    // Compresses n characters. Returns false if the data could not be compressed.
+    bool compress(char_type const * s, size_t n, zcodec::Flush flush);
+
+    // Compresses the contents of the put area and resets it. Returns false if the data could not be compressed.
+    bool compressBuffer(zcodec::Flush flush);
+
+    // Decompresses up to n characters into s. Returns the number of characters decompressed.
+    std::streamsize decompress(char_type * s, std::streamsize n);
+
+    // Refills the get area, preserving the putback characters. Returns false if there is no more data.
+    bool fill();
+
+    // Saves the last characters of a direct read in the putback area
+    void savePutback(char_type const * end, std::streamsize n);
+
+    // Passes a measurement to the adaptive controller, and applies its decision
+    void adapt(size_t in, size_t out, std::chrono::nanoseconds time);
+
+    // Stores or compresses the data that follows, depending on whether it looks incompressible
+    void judge(char_type const * s, size_t n);
+
+    // Resets the codec for new data without reallocating it
+    void restart(zcodec::char_type const * data, size_t size);
+
+    // Restarts decompression at the beginning of the data
+    void rewind();
+
+    std::pmr::memory_resource * resource_;  // Provides the zlib state (nullptr means zlib's default allocation)
+    StreamState state_;                     // The stream state
+    mutable container_type data_;           // Memory buffer holding the compressed/decompressed data
+    std::unique_ptr<zcodec> codec_;         // Compressor or decompressor (nullptr if the format is not available)
+    zcodec::Type type_;                     // Requested format (AUTO means detected, or zlib)
+    zcodec::Options options_;               // Settings of the compressor
+    zflushpolicy flushPolicy_;              // How flush requests are handled
+    std::unique_ptr<zadaptive> controller_; // Chooses the level and strategy (nullptr if adaptive compression is
+                                            // disabled)
+    bool skipIncompressible_;               // True if writes that look incompressible are stored
+    bool storing_;                          // True if the compressor is storing
+    std::vector<char_type> window_;         // Uncompressed data (the get or put area is in this buffer)
+    zcodec::char_type const * source_;      // Compressed data being decompressed (data_ or borrowed data)
+    size_t sourceSize_;                     // Size of the compressed data being decompressed
+    zcodec::char_type const * next_;        // Compressed data not yet handed to the codec
+    size_t remaining_;                      // Amount of compressed data not yet handed to the codec
+    size_t length_;                         // Amount of compressed output in data_
+    off_type position_;                     // Number of characters decompressed or compressed so far
+    off_type flushed_;                      // Number of characters compressed when the compressor was last flushed
+    bool presized_;                         // True if the output was sized for the worst case of a large write
+    bool end_;                              // True if the end of the compressed data has been reached or written
+    bool failed_;                           // True if the compressed data is bad
+    bool runningChecksum_;                  // True if the decompressed data is checksummed
+    zchecksum checksum_;                    // Checksum of the data decompressed so far
+    zstats stats_;                          // Statistics
+};
 
-    void flushInput();
+//! A memory stream buffer of unsigned bytes, holding the compressed data in a @c std::vector
+typedef basic_zmembuf<unsigned char> zmembuf;
+
+//! A memory stream buffer of @c char, holding the compressed data in a @c std::string
+typedef basic_zmembuf<char, std::char_traits<char>, std::string> czmembuf;
+
+extern template class basic_zmembuf<unsigned char>;
+extern template class basic_zmembuf<char>;
+extern template class basic_zmembuf<char, std::char_traits<char>, std::string>;
+
+
+//! Compresses a buffer in one step. This is faster than ozmstream when all the data is in memory, because the output
+//! is allocated once, with room for the largest possible result, and the data is compressed in a single call.
+//!
+//! @param	data        Data to compress
+//! @param	size        Size of the data
+//! @param	out         Receives the compressed data. Its previous contents are discarded, but its storage is reused.
+//!                     It is any of the containers of basic_zmembuf.
+//! @param	type        Format. AUTO selects zlib, like ozmstream.
+//! @param	options     Settings of the compressor
+//! @param	resource    Memory resource that provides the zlib state, or nullptr to use the default allocation
+//!
+//! @return	True if successful, or false if the format is not available or the codec failed
+//!
+//! @note	The capacity of @p out is left at the largest possible result, so reusing it for the next message avoids
+//!         allocating.
+template <class Container>
+bool zcompress(void const *                data,
+               size_t                      size,
+               Container &                 out,
+               zcodec::Type                type     = zcodec::AUTO,
+               zcodec::Options const &     options  = zcodec::Options(),
+               std::pmr::memory_resource * resource = nullptr);
+
+//! Decompresses a buffer in one step. This is faster than izmstream when the result is wanted in one piece, because
+//! the output is allocated from the size recorded in the data (the gzip ISIZE trailer, or the content size of a zstd
+//! or lz4 frame) or from a hint, and the data is decompressed in a single call when the size is right.
+//!
+//! @param	data        Data to decompress. Concatenated gzip members and zstd or lz4 frames are decompressed as one.
+//! @param	size        Size of the data
+//! @param	out         Receives the decompressed data. Its previous contents are discarded, but its storage is
+//!                     reused. It is any of the containers of basic_zmembuf.
+//! @param	sizeHint    Expected size of the decompressed data, or 0 to use the size recorded in the data
+//! @param	type        Format. AUTO detects it, and zlib is assumed if it is not recognized.
+//! @param	resource    Memory resource that provides the zlib state, or nullptr to use the default allocation
+//!
+//! @return	True if the end of the compressed data was reached, or false if the data is invalid or truncated. In
+//!         either case, @p out holds the data decompressed.
+template <class Container>
+bool zdecompress(void const *                data,
+                 size_t                      size,
+                 Container &                 out,
+                 size_t                      sizeHint = 0,
+                 zcodec::Type                type     = zcodec::AUTO,
+                 std::pmr::memory_resource * resource = nullptr);
 
-    StreamState state_;     // The stream state
-    mutable container_type data_;   // Memory buffer holding the compressed/decompressed data
-    mutable z_stream stream_;      // The zlib stream state
-    char_type putback_;      // putback buffer
-};
@@ -18,25 +18,40 @@
 #include <istream>
 #include <ostream>
 
-//! An input stream that decompresses the data from a buffer using @c zlib.
+//! An input stream that decompresses the data from a buffer using @c zlib, or another codec (see zcodec).
+//!
+//! The template parameters are those of basic_zmembuf.
 
-class izmstream : public std::basic_istream<unsigned char, std::char_traits<unsigned char> >
+template <class CharT, class Traits = std::char_traits<CharT>, class Container = std::vector<CharT> >
+class basic_izmstream : public std::basic_istream<CharT, Traits>
 {
 public:
 
-    typedef unsigned char char_type;                    //!< Element type
-    typedef zmembuf::container_type container_type;     //!< The container class
+    typedef CharT char_type;                                    //!< Element type
+    typedef basic_zmembuf<CharT, Traits, Container> buf_type;   //!< The stream buffer class
+    typedef Container container_type;                           //!< The container class
 
     // Constructor
-    izmstream();
+    //!
+    //! @param   resource   Memory resource that provides the zlib state, or nullptr to use the default allocation
+    explicit basic_izmstream(std::pmr::memory_resource * resource = nullptr);
+
+    // Constructor
+    //!
+    //! @param   buf        buffer to decompress
+    //! @param   resource   Memory resource that provides the zlib state, or nullptr to use the default allocation
+    explicit basic_izmstream(container_type const & buf, std::pmr::memory_resource * resource = nullptr);
 
     // Constructor
     //!
-    //! @param   buf     buffer to decompress
-    explicit izmstream(container_type const & buf);
+    //! @param   data       Buffer to decompress. It is not copied, so it must remain valid and unchanged while it is
+    //!                     being read.
+    //! @param   size       Size of the buffer
+    //! @param   resource   Memory resource that provides the zlib state, or nullptr to use the default allocation
+    basic_izmstream(char_type const * data, size_t size, std::pmr::memory_resource * resource = nullptr);
 
     //! Returns a pointer to the stream buffer.
-    zmembuf * rdbuf() const { return const_cast<zmembuf *>(&membuf_); }
+    buf_type * rdbuf() const { return const_cast<buf_type *>(&membuf_); }
 
     //! Returns the contents of the memory buffer.
     container_type const & buffer() const { return membuf_.buffer(); }
@@ -44,25 +59,63 @@ public:
     //! Replaces the contents of the memory buffer.
     void buffer(container_type const & buf) { membuf_.buffer(buf); }
 
+    //! Replaces the contents of the memory buffer with data that is decompressed in place, without copying it.
+    void borrow(char_type const * data, size_t size) { membuf_.borrow(data, size); }
+
+    //! Sets the format of the compressed data. By default, it is detected (gzip, zlib, zstd, or lz4).
+    //!
+    //! @param	type	Format. Raw deflate data cannot be detected, so it must be specified.
+    void set_codec(zcodec::Type type) { membuf_.set_codec(type); }
+
+    //! Returns the format of the compressed data.
+    zcodec::Type codec() const { return membuf_.codec(); }
+
+    //! Sets the preset dictionary that the data was compressed with. See zdictionary.
+    //!
+    //! @param	dictionary	Dictionary, or nullptr for none. If the data is in the zlib format, zdictionary::required()
+    //!                     returns the ID of the dictionary it needs.
+    void set_dictionary(std::shared_ptr<zdictionary const> dictionary) { membuf_.set_dictionary(dictionary); }
+
+    //! Sets whether the decompressed data is checksummed, so that it does not have to be checksummed again. This
+    //! should be called before anything is read.
+    //!
+    //! @param	enable	True to checksum it. See checksum().
+    void set_running_checksum(bool enable) { membuf_.set_running_checksum(enable); }
+
+    //! Returns the checksum of the data decompressed so far: a CRC-32, or an Adler-32 for the zlib format. It runs
+    //! ahead of the reader by the buffered data, so it covers all the data once the end is reached.
+    zchecksum const & checksum() const { return membuf_.checksum(); }
+
+    //! Decompresses the rest of the data without returning it, and checks it. This is faster than reading it.
+    //!
+    //! @return true if the data is intact, or false if it is damaged or truncated
+    bool verify() { return membuf_.verify(); }
+
 private:
 
-    zmembuf membuf_;     // The memory buffer
+    buf_type membuf_;   // The memory buffer
 };
 
-//! An output stream that compresses the data into a buffer using @c zlib
+//! An output stream that compresses the data into a buffer using @c zlib, or another codec (see zcodec)
+//!
+//! The template parameters are those of basic_zmembuf.
 
-class ozmstream : public std::basic_ostream<unsigned char, std::char_traits<unsigned char> >
+template <class CharT, class Traits = std::char_traits<CharT>, class Container = std::vector<CharT> >
+class basic_ozmstream : public std::basic_ostream<CharT, Traits>
 {
 public:
 
-    typedef unsigned char char_type;                    //!< Element type
-    typedef zmembuf::container_type container_type;     //!< The container class
+    typedef CharT char_type;                                    //!< Element type
+    typedef basic_zmembuf<CharT, Traits, Container> buf_type;   //!< The stream buffer class
+    typedef Container container_type;                           //!< The container class
 
     //! Constructor
-    ozmstream();
+    //!
+    //! @param   resource   Memory resource that provides the zlib state, or nullptr to use the default allocation
+    explicit basic_ozmstream(std::pmr::memory_resource * resource = nullptr);
 
     //! Returns a pointer to the stream buffer.
-    zmembuf * rdbuf() const { return const_cast<zmembuf *>(&membuf_); }
+    buf_type * rdbuf() const { return const_cast<buf_type *>(&membuf_); }
 
     //! Returns the contents of the memory buffer.
     container_type const & buffer() const { return membuf_.buffer(); }
@@ -70,12 +123,80 @@ public:
     //! Replaces the contents of the memory buffer.
     void buffer(container_type const & buf)  { membuf_.buffer(buf); }
 
+    //! Finishes the compressed data and moves it out. The stream is then ready for the next message.
+    container_type release() { return membuf_.release(); }
+
+    //! Finishes the compressed data and moves it into @p buf, reusing the storage of @p buf for the next message.
+    void release(container_type & buf) { membuf_.release(buf); }
+
     //! Sets the compression level.
     //!
     //! @param	level	Compression level. 0 is no compression, 9 is maximum compression.
     void set_compression(int level) { membuf_.set_compression(level); }
 
+    //! Sets the format of the compressed data and the settings of the compressor. This must be called before anything
+    //! is written.
+    //!
+    //! @param	type	Format. The default is zlib (AUTO).
+    //! @param	options	Settings, including the level
+    void set_codec(zcodec::Type type, zcodec::Options const & options = zcodec::Options())
+    {
+        membuf_.set_codec(type, options);
+    }
+
+    //! Sets the preset dictionary used to compress the data. This must be called before anything is written. See
+    //! zdictionary.
+    //!
+    //! @param	dictionary	Dictionary, or nullptr for none. It must be given to the input stream that decompresses the
+    //!                     data. The format must be zlib (the default), raw deflate, or zstd.
+    void set_dictionary(std::shared_ptr<zdictionary const> dictionary) { membuf_.set_dictionary(dictionary); }
+
+    //! Sets how @c flush() and @c std::endl are handled, and when the compressor is flushed on its own.
+    //!
+    //! @param	policy	Flush policy. See zflushpolicy. By default, a flush only passes the buffered output to the
+    //!                 compressor. The timer (zflushpolicy::milliseconds) is not supported.
+    void set_flush_policy(zflushpolicy const & policy) { membuf_.set_flush_policy(policy); }
+
+    //! Enables or disables adaptive compression, which chooses the level and strategy of each block of data from the
+    //! ratio and speed of the previous blocks.
+    //!
+    //! @param	adaptive    True to enable it
+    //! @param	target      What it aims for. See zadaptive. Only the zlib formats are adapted.
+    void set_adaptive(bool adaptive, zadaptive::Target const & target = zadaptive::Target())
+    {
+        membuf_.set_adaptive(adaptive, target);
+    }
+
+    //! Returns the adaptive controller (for its decisions), or nullptr if adaptive compression is disabled.
+    zadaptive const * adaptive() const { return membuf_.adaptive(); }
+
+    //! Sets whether output that looks incompressible (already compressed, encrypted, or random) is stored instead of
+    //! compressed.
+    //!
+    //! @param	skip    True to store it. Only the zlib formats are supported.
+    void set_skip_incompressible(bool skip) { membuf_.set_skip_incompressible(skip); }
+
 private:
 
-    zmembuf membuf_;     // The memory buffer
+    buf_type membuf_;   // The memory buffer
 };
+
+//! An input stream of unsigned bytes, decompressing a @c std::vector
+typedef basic_izmstream<unsigned char> izmstream;
+
+//! An output stream of unsigned bytes, compressing into a @c std::vector
+typedef basic_ozmstream<unsigned char> ozmstream;
+
+//! An input stream of @c char, decompressing a @c std::string. It can be passed to code that reads a @c std::istream.
+typedef basic_izmstream<char, std::char_traits<char>, std::string> iczmstream;
+
+//! An output stream of @c char, compressing into a @c std::string. It can be passed to code that writes a
+//! @c std::ostream.
+typedef basic_ozmstream<char, std::char_traits<char>, std::string> oczmstream;
+
+extern template class basic_izmstream<unsigned char>;
+extern template class basic_ozmstream<unsigned char>;
+extern template class basic_izmstream<char>;
+extern template class basic_ozmstream<char>;
+extern template class basic_izmstream<char, std::char_traits<char>, std::string>;
+extern template class basic_ozmstream<char, std::char_traits<char>, std::string>;
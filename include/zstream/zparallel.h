@@ -0,0 +1,122 @@
+/** @file *//********************************************************************************************************
+
+                                                     zparallel.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zparallel.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include "zlib/zlib.h"
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! Compresses data into a gzip file using a pool of threads.
+//!
+//! The data is split into blocks that are compressed independently. Each block is primed with the 32 KB of data
+//! preceding it, so the compression ratio is close to that of a single stream. The blocks are written in order as
+//! a single gzip member, with the CRC and size combined from the values of the blocks.
+class zparallel
+{
+public:
+    typedef unsigned char char_type;    //!< Element type
+
+    //! Sizes
+    enum
+    {
+        DEFAULT_BLOCK_SIZE = 128 * 1024,    //!< Default amount of uncompressed data in each block
+        DICTIONARY_SIZE    = 32 * 1024      //!< Amount of preceding data used to prime each block
+    };
+
+    // Constructor
+    zparallel(FILE *                      file,
+              int                         level,
+              unsigned                    threads,
+              size_t                      blockSize = DEFAULT_BLOCK_SIZE,
+              std::pmr::memory_resource * resource  = nullptr);
+
+    // Destructor
+    ~zparallel();
+
+    //! Compresses @p n characters. Returns false if there was an error.
+    bool write(char_type const * s, size_t n);
+
+    //! Writes everything compressed so far to the file. Returns false if there was an error.
+    bool flush();
+
+    //! Finishes the gzip data and closes the file. Returns false if there was an error.
+    bool close();
+
+    //! Sets the compression level of subsequent blocks.
+    void set_compression(int level) { level_ = level; }
+
+    //! Returns the number of uncompressed characters written so far.
+    size_t tell() const { return total_ + block_.size(); }
+
+    //! Returns the number of compressed bytes written to the file so far.
+    size_t compressed();
+
+private:
+
+    // A block of data to compress
+    struct Job
+    {
+        size_t sequence;                    // Order of the block in the stream
+        std::vector<char_type> input;       // Uncompressed data
+        std::vector<char_type> dictionary;  // Data preceding the block
+        std::vector<char_type> output;      // Compressed data
+        int level;                          // Compression level
+        int flush;                          // zlib flush mode that ends the block
+        uLong crc;                          // CRC of the uncompressed data
+        bool ok;                            // True if the block was compressed successfully
+    };
+
+    // Sends the current block to the compressors
+    void submit(int flush);
+
+    // Waits until everything that has been submitted has been written
+    void wait();
+
+    // Compressor thread
+    void compressor(int level);
+
+    // Writer thread
+    void writer();
+
+    FILE * file_;                                       // Output file
+    std::pmr::memory_resource * resource_;              // Provides the zlib state of the compressors
+    size_t blockSize_;                                  // Amount of uncompressed data in each block
+    int level_;                                         // Compression level of subsequent blocks
+    size_t maxPending_;                                 // Maximum number of blocks in flight
+    std::vector<char_type> block_;                      // Block being filled
+    std::vector<char_type> history_;                    // Last DICTIONARY_SIZE characters submitted
+    size_t total_;                                      // Number of uncompressed characters submitted
+    size_t submitted_;                                  // Number of blocks submitted
+    size_t written_;                                    // Number of blocks written
+    uLong crc_;                                         // CRC of the blocks written
+    size_t compressed_;                                 // Number of bytes written to the file
+    bool ok_;                                           // False if there was an error
+    bool stop_;                                         // True when the threads must exit
+
+    std::mutex mutex_;                                  // Guards everything below and the counters above
+    std::condition_variable jobReady_;                  // Signaled when a job is queued
+    std::condition_variable resultReady_;               // Signaled when a job is compressed
+    std::condition_variable blockWritten_;              // Signaled when a block is written
+    std::deque<std::unique_ptr<Job> > jobs_;            // Blocks waiting to be compressed
+    std::map<size_t, std::unique_ptr<Job> > results_;   // Compressed blocks waiting to be written
+    std::vector<std::thread> compressors_;              // Compressor threads
+    std::thread writer_;                                // Writer thread
+};
@@ -0,0 +1,70 @@
+/** @file *//********************************************************************************************************
+
+                                                      zpool.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zpool.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include "zmembuf.h"
+#include <ios>
+#include <memory>
+
+//! A thread-local pool of zmembuf objects that are ready to use.
+//!
+//! Creating a zmembuf allocates the zlib state (about 256 KB for compression and 44 KB for decompression) and
+//! initializes it. A pooled buffer is only reset when it is reused, so the cost of setting up a buffer for a small
+//! message is negligible.
+//!
+//! A buffer returned to the pool gets the settings of a new buffer again: the default format, level, and strategy,
+//! no dictionary, the default flush policy, no adaptive controller (so its decisions are discarded), and
+//! incompressible output is compressed, and the decompressed data is not checksummed. Its statistics start over.
+//!
+//! @code
+//!     zpool::pointer buffer = zpool::acquire(std::ios_base::out);
+//!     std::basic_ostream<unsigned char> out(buffer.get());
+//!     out.write(data, size);
+//!     zmembuf::container_type compressed = buffer->release();
+//! @endcode
+class zpool
+{
+public:
+
+    //! Returns a buffer to the pool of the thread that destroys the pointer.
+    class recycler
+    {
+    public:
+        //! Constructor
+        explicit recycler(bool output = false) : output_(output) {}
+
+        //! Resets the buffer and returns it to the pool, or deletes it if the pool is full.
+        void operator()(zmembuf * buffer) const;
+
+    private:
+        bool output_;   // True if the buffer compresses
+    };
+
+    //! Owns a buffer from the pool, and returns it to the pool when it is destroyed
+    typedef std::unique_ptr<zmembuf, recycler> pointer;
+
+    //! Limits
+    enum
+    {
+        MAX_SIZE = 16   //!< Maximum number of idle buffers of each direction kept by a thread
+    };
+
+    //! Returns an empty buffer from the calling thread's pool, or a new one if the pool is empty.
+    static pointer acquire(std::ios_base::openmode mode);
+
+private:
+
+    // Returns the idle buffers of the calling thread
+    static std::vector<std::unique_ptr<zmembuf> > & idle(bool output);
+};
@@ -0,0 +1,105 @@
+/** @file *//********************************************************************************************************
+
+                                                    zreadahead.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zreadahead.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! Decompresses ahead of the reader on a helper thread.
+//!
+//! The helper fills a bounded ring of chunks from a source of decompressed data while the reader consumes the oldest
+//! chunk, so the time spent decompressing overlaps the time the reader spends processing the data.
+class zreadahead
+{
+public:
+    typedef unsigned char   char_type;  //!< Element type
+    typedef std::streamoff  off_type;   //!< Holds an offset in the decompressed data
+
+    //! Reads up to the given number of decompressed characters. Returns the number read, 0 at the end of the data,
+    //! or -1 if there was an error.
+    typedef std::function<int(char_type * s, unsigned n)> source_type;
+
+    //! Sizes
+    enum
+    {
+        DEFAULT_CHUNK_SIZE  = 256 * 1024,   //!< Default size of each chunk
+        DEFAULT_CHUNK_COUNT = 4             //!< Default number of chunks
+    };
+
+    // Constructor
+    explicit zreadahead(source_type source,
+                        size_t      chunkSize  = DEFAULT_CHUNK_SIZE,
+                        unsigned    chunkCount = DEFAULT_CHUNK_COUNT);
+
+    // Destructor
+    ~zreadahead();
+
+    //! Starts the helper. The next character of the source is at @p position in the decompressed data.
+    void start(off_type position);
+
+    //! Stops the helper and discards the data it has read ahead. The source can then be used directly (to seek, for
+    //! example).
+    void stop();
+
+    //! Reads up to @p n characters. Returns the number read, 0 at the end of the data, or -1 if there was an error.
+    int read(char_type * s, unsigned n);
+
+    //! Returns the offset of the next character to be read.
+    off_type tell() const { return position_; }
+
+    //! Locks the source, waiting until the helper is not using it.
+    std::unique_lock<std::mutex> lock_source() const { return std::unique_lock<std::mutex>(sourceMutex_); }
+
+private:
+
+    // A chunk of decompressed data
+    struct Chunk
+    {
+        std::vector<char_type> data;    // Contents
+        size_t size;                    // Amount of data in the chunk
+        size_t consumed;                // Amount of data read
+    };
+
+    // Non-copyable
+    zreadahead(zreadahead const &) = delete;
+    zreadahead & operator =(zreadahead const &) = delete;
+
+    // Returns the current chunk to the free list and gets the next one, waiting if necessary
+    bool next();
+
+    // Helper thread
+    void helper();
+
+    source_type source_;                            // Source of the decompressed data
+    size_t chunkSize_;                              // Size of each chunk
+    off_type position_;                             // Offset of the next character to be read
+    std::unique_ptr<Chunk> current_;                // Chunk being read
+    mutable std::mutex sourceMutex_;                // Held by the helper while it uses the source
+
+    std::mutex mutex_;                              // Guards everything below
+    std::condition_variable workReady_;             // Signaled when a chunk is free or the helper must stop
+    std::condition_variable chunkReady_;            // Signaled when a chunk has been filled
+    std::deque<std::unique_ptr<Chunk> > free_;      // Chunks waiting to be filled
+    std::deque<std::unique_ptr<Chunk> > ready_;     // Chunks waiting to be read
+    bool end_;                                      // True if the helper has reached the end of the data
+    bool error_;                                    // True if the source failed
+    bool stop_;                                     // True when the helper must exit
+    std::thread helper_;                            // Helper thread
+};
@@ -0,0 +1,156 @@
+/** @file *//********************************************************************************************************
+
+                                                   zspeculative.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zspeculative.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+#include "zmapping.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <ios>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! Decompresses a gzip file using a pool of threads, even if it has only one member.
+//!
+//! The compressed data is divided into chunks. A worker searches each chunk for the first position that looks like
+//! the start of a deflate block with dynamic Huffman codes, and decompresses from there to the first block that
+//! ends after the chunk. The data preceding the chunk is not known yet, so a back-reference into it is recorded as a
+//! marker. The chunks are delivered in order by following the chain of blocks from the beginning of the file: a
+//! chunk is used only if it starts exactly where the previous one ended, and its markers are then replaced by the
+//! data they refer to. Otherwise, the chunk is decompressed again from the right position.
+//!
+//! The output is identical to that of @c gzread(), and the CRC and size of each member are checked.
+class zspeculative
+{
+public:
+    typedef unsigned char   char_type;  //!< Element type
+    typedef std::streamoff  off_type;   //!< Holds a file offset
+
+    //! Sizes
+    enum
+    {
+        DEFAULT_CHUNK_SIZE = 1024 * 1024,       //!< Default amount of compressed data in each chunk
+        MAX_CHUNK_OUTPUT   = 16 * 1024 * 1024   //!< Amount of decompressed data that ends a chunk early
+    };
+
+    // Constructor
+    explicit zspeculative(unsigned threads, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    // Destructor
+    ~zspeculative();
+
+    //! Opens a gzip file. Returns false if it could not be opened, or if it is not a gzip file.
+    bool open(char const * name);
+
+    //! Closes the file. Returns false if there was an error.
+    bool close();
+
+    //! Returns true if a file is open.
+    bool is_open() const { return mapping_.is_open(); }
+
+    //! Reads up to @p n characters. Returns the number read, or -1 if there was an error.
+    int read(char_type * s, unsigned n);
+
+    //! Moves to an offset in the decompressed data. Returns false if it failed.
+    //!
+    //! @note	A backward seek restarts from the beginning of the file.
+    bool seek(off_type offset);
+
+    //! Returns the current offset in the decompressed data.
+    off_type tell() const { return position_; }
+
+    //! Returns the number of compressed bytes consumed so far.
+    off_type offset() const { return off_type(next_ / 8); }
+
+    //! Returns the total number of characters decompressed and discarded by seeks.
+    off_type skipped() const { return skipped_; }
+
+private:
+
+    // Job status
+    enum Status
+    {
+        PENDING,    // Waiting to be decompressed, or being decompressed
+        DONE,       // The chunk has been decompressed
+        FAILED      // No block was found, or the data is invalid
+    };
+
+    // Decompresses a chunk
+    struct Job
+    {
+        size_t chunk;                       // Index of the chunk
+        bool known;                         // True if start is known to be a block boundary
+        std::uint64_t start;                // Bit offset of the first block
+        std::uint64_t end;                  // Bit offset following the last block (if DONE)
+        bool final;                         // True if the last block ends the member (if DONE)
+        std::vector<std::uint16_t> output;  // Decompressed data. Values above 255 are markers.
+        size_t size;                        // Amount of decompressed data
+        Status status;                      // Status
+        std::atomic<bool> cancelled;        // True if the result is no longer needed
+
+        Job(size_t chunk, bool known, std::uint64_t start);
+    };
+
+    // Non-copyable
+    zspeculative(zspeculative const &) = delete;
+    zspeculative & operator =(zspeculative const &) = delete;
+
+    // Returns the offset of the data following a gzip header, or 0 if there is no valid header at the offset
+    size_t parseHeader(size_t offset) const;
+
+    // Queues jobs for the chunks following the current one. The mutex must be held.
+    void schedule(size_t chunk);
+
+    // Decompresses the next chunk in the chain into output_. Returns false at the end of the data or if it failed.
+    bool advance();
+
+    // Decompresses a job's chunk. Returns false if it failed.
+    bool decompress(Job & job) const;
+
+    // Stops the workers and discards the jobs
+    void stop();
+
+    // Starts the workers at the beginning of the file
+    void start();
+
+    // Worker thread
+    void worker();
+
+    unsigned threads_;                                  // Number of worker threads
+    size_t chunkSize_;                                  // Amount of compressed data in each chunk
+    zmapping mapping_;                                  // The compressed file
+    size_t maxPending_;                                 // Maximum number of jobs ahead of the reader
+    std::uint64_t next_;                                // Bit offset of the next block in the chain
+    std::vector<char_type> output_;                     // Decompressed data of the current chunk
+    size_t consumed_;                                   // Amount of output_ that has been read
+    std::vector<char_type> history_;                    // Last 32 KB of decompressed data of the member
+    unsigned long crc_;                                 // CRC of the member so far
+    unsigned long size_;                                // Size of the member so far (mod 2^32)
+    off_type position_;                                 // Offset in the decompressed data
+    off_type skipped_;                                  // Characters decompressed and discarded by seeks
+    bool end_;                                          // True if the end of the data has been reached
+    bool error_;                                        // True if there was an error
+
+    std::mutex mutex_;                                  // Guards everything below
+    std::condition_variable jobReady_;                  // Signaled when a job is queued
+    std::condition_variable jobDone_;                   // Signaled when a job is finished
+    std::map<size_t, std::shared_ptr<Job> > jobs_;      // Jobs ahead of the reader, by chunk
+    std::deque<std::shared_ptr<Job> > queue_;           // Jobs waiting for a worker
+    bool stop_;                                         // True when the workers must exit
+    std::vector<std::thread> workers_;                  // Worker threads
+};
@@ -0,0 +1,54 @@
+/** @file *//********************************************************************************************************
+
+                                                      zstats.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zstats.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+//! Statistics collected by a stream buffer.
+//!
+//! The statistics are only collected if the library is built with @c ZSTREAM_STATS defined as nonzero (the CMake
+//! option @c zstream_ENABLE_STATS). Otherwise, they are always 0 and collecting them costs nothing.
+struct zstats
+{
+    unsigned long long uncompressedBytes;   //!< Uncompressed characters written or read
+    unsigned long long compressedBytes;     //!< Compressed bytes produced or consumed
+    unsigned long long deflateCalls;        //!< Number of calls to compress data (deflate() or gzwrite())
+    unsigned long long inflateCalls;        //!< Number of calls to decompress data (inflate() or gzread())
+    unsigned long long syncs;               //!< Number of flushes requested with sync()
+    unsigned long long reallocations;       //!< Number of times the output buffer was enlarged
+    unsigned long long seeks;               //!< Number of seeks that changed the position
+    unsigned long long seekBytes;           //!< Characters decompressed and discarded, or zeros written, by seeks
+    unsigned long long adaptations;         //!< Number of times the adaptive controller changed the level or strategy
+                                            //!< (see zadaptive)
+    unsigned long long storedBytes;         //!< Uncompressed characters stored instead of compressed because they
+                                            //!< looked incompressible (see zadaptive::incompressible())
+    unsigned long long zlibNanoseconds;     //!< Time spent in zlib
+
+    //! Constructor
+    zstats()
+        : uncompressedBytes(0)
+        , compressedBytes(0)
+        , deflateCalls(0)
+        , inflateCalls(0)
+        , syncs(0)
+        , reallocations(0)
+        , seeks(0)
+        , seekBytes(0)
+        , adaptations(0)
+        , storedBytes(0)
+        , zlibNanoseconds(0)
+    {
+    }
+
+    //! Returns the compressed size as a fraction of the uncompressed size, or 0 if nothing has been compressed.
+    double ratio() const { return (uncompressedBytes > 0) ? double(compressedBytes) / double(uncompressedBytes) : 0.0; }
+};
@@ -0,0 +1,154 @@
+/** @file *//********************************************************************************************************
+
+                                               zstream_test_adaptive.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/test/zstream_test_adaptive.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+//! @file
+//!
+//! Tests the adaptive controller (set_adaptive()) together with the storing of incompressible writes
+//! (set_skip_incompressible()).
+//!
+//! The data alternates between compressible text and random bytes. With both options, the compressible parts must
+//! still be compressed, so the output must be no larger than with neither option, and it must decompress to the
+//! original data. The file and memory streams are both tested.
+//!
+//! Returns 0 if every test passes.
+
+#include "zfstream.h"
+#include "zmstream.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef unsigned char char_type;
+typedef std::vector<char_type> buffer_type;
+
+// Size of each stretch of text or random data
+size_t const SEGMENT_SIZE = 2 * 1024 * 1024;
+
+// Number of stretches
+int const SEGMENTS = 4;
+
+// Size of each write
+size_t const WRITE_SIZE = 64 * 1024;
+
+// The output with both options may be this much larger than the output with neither (the stored blocks have headers)
+double const TOLERANCE = 1.01;
+
+char const * const FILE_NAME = "zstream_test_adaptive.gz";
+
+// Returns stretches of log lines alternating with stretches of random bytes
+buffer_type mixedData()
+{
+    std::mt19937 random(3);
+    buffer_type  data;
+    for (int i = 0; i < SEGMENTS; ++i)
+    {
+        size_t const end = (i + 1) * SEGMENT_SIZE;
+        if (i % 2 == 0)
+        {
+            for (int second = 0; data.size() < end; ++second)
+            {
+                std::string const line = "2003-01-01T00:00:" + std::to_string(second % 60) + " INFO request "
+                                       + std::to_string(random() % 100000) + " status=200\n";
+                data.insert(data.end(), line.begin(), line.end());
+            }
+            data.resize(end);
+        }
+        else
+        {
+            while (data.size() < end)
+            {
+                data.push_back(char_type(random()));
+            }
+        }
+    }
+    return data;
+}
+
+// Compresses the data to a file and returns the size of the file, or 0 if it does not decompress to the data
+size_t compressFile(buffer_type const & data, bool adaptive, bool skip)
+{
+    {
+        ozfstream out;
+        out.set_adaptive(adaptive);
+        out.set_skip_incompressible(skip);
+        out.open(FILE_NAME);
+        for (size_t offset = 0; offset < data.size(); offset += WRITE_SIZE)
+        {
+            out.write(data.data() + offset, std::streamsize(std::min(WRITE_SIZE, data.size() - offset)));
+        }
+    }
+
+    FILE * file = fopen(FILE_NAME, "rb");
+    if (!file)
+    {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    size_t const size = size_t(ftell(file));
+    fclose(file);
+
+    izfstream   in(FILE_NAME);
+    buffer_type decompressed(data.size() + 1);
+    in.read(decompressed.data(), std::streamsize(decompressed.size()));
+    decompressed.resize(size_t(in.gcount()));
+    remove(FILE_NAME);
+    return (decompressed == data) ? size : 0;
+}
+
+// Compresses the data in memory and returns its compressed size, or 0 if it does not decompress to the data
+size_t compressMemory(buffer_type const & data, bool adaptive, bool skip)
+{
+    ozmstream out;
+    out.set_adaptive(adaptive);
+    out.set_skip_incompressible(skip);
+    for (size_t offset = 0; offset < data.size(); offset += WRITE_SIZE)
+    {
+        out.write(data.data() + offset, std::streamsize(std::min(WRITE_SIZE, data.size() - offset)));
+    }
+    buffer_type const compressed = out.release();
+
+    izmstream   in(compressed);
+    buffer_type decompressed(data.size() + 1);
+    in.read(decompressed.data(), std::streamsize(decompressed.size()));
+    decompressed.resize(size_t(in.gcount()));
+    return (decompressed == data) ? compressed.size() : 0;
+}
+
+// Compares the output with both options against the output with neither. Returns true if the test passes.
+bool test(char const * name, size_t (* compress)(buffer_type const &, bool, bool), buffer_type const & data)
+{
+    size_t const plain = compress(data, false, false);
+    size_t const both  = compress(data, true, true);
+    bool const   ok    = plain > 0 && both > 0 && double(both) <= double(plain) * TOLERANCE;
+    printf("%-8s neither %10zu bytes, adaptive and skip %10zu bytes: %s\n", name, plain, both, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+} // anonymous namespace
+
+int main()
+{
+    buffer_type const data = mixedData();
+
+    bool ok = true;
+    ok = test("file", compressFile, data) && ok;
+    ok = test("memory", compressMemory, data) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
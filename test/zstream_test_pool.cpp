@@ -0,0 +1,190 @@
+/** @file *//********************************************************************************************************
+
+                                                 zstream_test_pool.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/test/zstream_test_pool.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+//! @file
+//!
+//! Tests that a buffer returned to zpool comes back with the default settings.
+//!
+//! Each test acquires a buffer, changes a setting, compresses a message, and releases the buffer. The buffer is then
+//! acquired again (the pool returns the same one), and the message it compresses must be decompressed by a plain
+//! izmstream.
+//!
+//! Returns 0 if every test passes.
+
+#include "zdictionary.h"
+#include "zmstream.h"
+#include "zpool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef zmembuf::char_type char_type;
+typedef zmembuf::container_type buffer_type;
+
+// Returns a message of log lines
+buffer_type message()
+{
+    std::string text;
+    for (int i = 0; i < 2000; ++i)
+    {
+        text += "2003-01-01T00:00:" + std::to_string(i % 60) + " INFO request " + std::to_string(i * 7919 % 100003)
+              + " status=200\n";
+    }
+    return buffer_type(text.begin(), text.end());
+}
+
+// Compresses the message with a buffer from the pool, after changing its settings
+template <class Setup>
+buffer_type compress(buffer_type const & data, Setup setup)
+{
+    zpool::pointer buffer = zpool::acquire(std::ios_base::out);
+    setup(*buffer);
+    buffer->sputn(data.data(), std::streamsize(data.size()));
+    return buffer->release();
+}
+
+// Returns true if the compressed data decompresses to the message
+bool decompresses(buffer_type const & compressed,
+                  buffer_type const & data,
+                  std::shared_ptr<zdictionary const> dictionary = nullptr)
+{
+    izmstream in(compressed);
+    in.set_dictionary(dictionary);
+    buffer_type decompressed(data.size() + 1);
+    in.read(decompressed.data(), std::streamsize(decompressed.size()));
+    decompressed.resize(size_t(in.gcount()));
+    return decompressed == data;
+}
+
+// Prints the result of a test
+bool report(char const * name, bool ok)
+{
+    printf("%-12s %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// A dictionary set by one user of a buffer is not used by the next
+bool testDictionary(buffer_type const & data)
+{
+    std::shared_ptr<zdictionary const> const dictionary(new zdictionary(data.data(), data.size() / 4));
+
+    buffer_type const first = compress(data, [&](zmembuf & buffer) { buffer.set_dictionary(dictionary); });
+    bool              clear = false;
+    buffer_type const next  = compress(data, [&](zmembuf & buffer) { clear = (buffer.dictionary() == nullptr); });
+    return report("dictionary", decompresses(first, data, dictionary) && clear && decompresses(next, data));
+}
+
+// A format set by one user of a buffer is not used by the next, and neither is the level
+bool testCodec(buffer_type const & data)
+{
+    zcodec::Options options;
+    options.level = 1;
+
+    buffer_type const plain = compress(data, [](zmembuf &) {});
+    buffer_type const first = compress(data, [&](zmembuf & buffer) { buffer.set_codec(zcodec::GZIP, options); });
+    zcodec::Type      type  = zcodec::AUTO;
+    buffer_type const next  = compress(data, [&](zmembuf & buffer) { type = buffer.codec(); });
+    return report("codec",
+                  decompresses(first, data) && type == zcodec::ZLIB && next == plain && decompresses(next, data));
+}
+
+// A flush policy set by one user of a buffer is not used by the next
+bool testFlushPolicy(buffer_type const & data)
+{
+    buffer_type const plain = compress(data, [](zmembuf &) {});
+    buffer_type const first = compress(data, [](zmembuf & buffer) {
+        buffer.set_flush_policy(zflushpolicy(zflushpolicy::FULL_FLUSH, 1000));
+    });
+    buffer_type const next = compress(data, [](zmembuf &) {});
+    return report("flush policy", first != plain && decompresses(first, data) && next == plain);
+}
+
+// An adaptive controller set by one user of a buffer is not used by the next
+bool testAdaptive(buffer_type const & data)
+{
+    buffer_type const plain = compress(data, [](zmembuf &) {});
+    compress(data, [](zmembuf & buffer) { buffer.set_adaptive(true, zadaptive::Target(0.0, 0.0, 1024)); });
+    bool              off  = false;
+    buffer_type const next = compress(data, [&](zmembuf & buffer) { off = (buffer.adaptive() == nullptr); });
+    return report("adaptive", off && next == plain);
+}
+
+// Storing incompressible output, set by one user of a buffer, is not done for the next
+bool testSkipIncompressible()
+{
+    std::mt19937 random(3);
+    buffer_type  data(256 * 1024);
+    for (char_type & c : data)
+    {
+        c = char_type(random());
+    }
+
+    buffer_type const plain = compress(data, [](zmembuf &) {});
+    buffer_type const first = compress(data, [](zmembuf & buffer) { buffer.set_skip_incompressible(true); });
+    buffer_type const next  = compress(data, [](zmembuf &) {});
+    return report("skip", first != plain && decompresses(first, data) && next == plain);
+}
+
+// A running checksum enabled by one user of a buffer is not computed for the next
+bool testRunningChecksum(buffer_type const & data)
+{
+    buffer_type const compressed = compress(data, [](zmembuf &) {});
+    buffer_type       decompressed(data.size());
+    bool              first = false;
+    {
+        zpool::pointer buffer = zpool::acquire(std::ios_base::in);
+        buffer->set_running_checksum(true);
+        buffer->buffer(compressed);
+        buffer->sgetn(decompressed.data(), std::streamsize(decompressed.size()));
+        first = (buffer->checksum().length() == data.size());
+    }
+
+    zpool::pointer buffer = zpool::acquire(std::ios_base::in);
+    buffer->buffer(compressed);
+    bool const read = buffer->sgetn(decompressed.data(), std::streamsize(decompressed.size())) ==
+                      std::streamsize(data.size());
+    return report("checksum", first && read && decompressed == data && buffer->checksum().length() == 0);
+}
+
+// The statistics of one user of a buffer are not counted for the next. Without ZSTREAM_STATS, they are always 0.
+bool testStats(buffer_type const & data)
+{
+    compress(data, [](zmembuf &) {});
+    bool clear = false;
+    compress(data, [&](zmembuf & buffer) { clear = (buffer.stats().uncompressedBytes == 0); });
+    return report("stats", clear);
+}
+
+} // anonymous namespace
+
+int main()
+{
+    buffer_type const data = message();
+
+    bool ok = true;
+    ok = testDictionary(data) && ok;
+    ok = testCodec(data) && ok;
+    ok = testFlushPolicy(data) && ok;
+    ok = testAdaptive(data) && ok;
+    ok = testSkipIncompressible() && ok;
+    ok = testRunningChecksum(data) && ok;
+    ok = testStats(data) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,240 @@
+/** @file *//********************************************************************************************************
+
+                                                  zstream_dict.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/tools/zstream_dict.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+//! @file
+//!
+//! Builds a preset dictionary (see zdictionary) from sample messages.
+//!
+//! Usage:
+//!     zstream_dict --output <file> [--size <bytes>] [--segment <bytes>] [--lines] [--level <0-9>] <sample>...
+//!
+//! Each sample file is one message, or with --lines, each line of the files is a message. Every tenth message is
+//! held out of the training and used to report the compression of the messages with and without the dictionary.
+
+#include "zdictionary.h"
+#include "zmstream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef unsigned char char_type;
+typedef std::vector<char_type> buffer_type;
+
+// One message in this many is used to test the dictionary instead of training it
+size_t const TEST_INTERVAL = 10;
+
+// Options
+struct Options
+{
+    std::string output;
+    size_t size    = zdictionary::DEFAULT_SIZE;
+    size_t segment = zdictionary::DEFAULT_SEGMENT;
+    bool lines     = false;
+    int level      = zcodec::DEFAULT_LEVEL;
+    std::vector<std::string> samples;
+};
+
+// A set of messages, one after the other
+struct Messages
+{
+    buffer_type data;
+    std::vector<size_t> sizes;
+};
+
+void usage()
+{
+    fprintf(stderr,
+            "usage: zstream_dict --output <file> [--size <bytes>] [--segment <bytes>] [--lines] [--level <0-9>] "
+            "<sample>...\n");
+}
+
+bool parse(int argc, char ** argv, Options & options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string const option = argv[i];
+        if (option == "--lines")
+        {
+            options.lines = true;
+            continue;
+        }
+        if (option.compare(0, 2, "--") != 0)
+        {
+            options.samples.push_back(option);
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        std::string const value = argv[++i];
+
+        if (option == "--output")
+        {
+            options.output = value;
+        }
+        else if (option == "--size")
+        {
+            options.size = size_t(strtoull(value.c_str(), nullptr, 10));
+        }
+        else if (option == "--segment")
+        {
+            options.segment = size_t(strtoull(value.c_str(), nullptr, 10));
+        }
+        else if (option == "--level")
+        {
+            options.level = std::min(std::max(atoi(value.c_str()), 0), 9);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return !options.output.empty() && !options.samples.empty() && options.size > 0;
+}
+
+// Reads a file. Returns false if it could not be read.
+bool readFile(std::string const & name, buffer_type & data)
+{
+    FILE * file = fopen(name.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    data.clear();
+    char_type buffer[64 * 1024];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    bool const ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+// Adds a message to the training set or the test set
+void add(char_type const * message, size_t size, Messages & training, Messages & test, size_t & count)
+{
+    Messages & messages = (++count % TEST_INTERVAL == 0) ? test : training;
+    messages.data.insert(messages.data.end(), message, message + size);
+    messages.sizes.push_back(size);
+}
+
+// Compresses each message with a fresh buffer state, and returns the total compressed size and the time it took
+size_t compressAll(Messages const & messages, std::shared_ptr<zdictionary const> const & dictionary, int level,
+                   double & seconds)
+{
+    typedef std::chrono::steady_clock clock;
+
+    ozmstream stream;
+    stream.set_compression(level);
+    stream.set_dictionary(dictionary);
+
+    clock::time_point const start = clock::now();
+    size_t total = 0;
+    size_t offset = 0;
+    ozmstream::container_type compressed;
+    for (size_t size : messages.sizes)
+    {
+        stream.write(messages.data.data() + offset, std::streamsize(size));
+        stream.release(compressed);
+        total  += compressed.size();
+        offset += size;
+    }
+    seconds = std::chrono::duration<double>(clock::now() - start).count();
+    return total;
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv)
+{
+    Options options;
+    if (!parse(argc, argv, options))
+    {
+        usage();
+        return 1;
+    }
+
+    // Collect the messages
+    Messages training;
+    Messages test;
+    size_t count = 0;
+    buffer_type data;
+    for (auto const & name : options.samples)
+    {
+        if (!readFile(name, data))
+        {
+            fprintf(stderr, "cannot read %s\n", name.c_str());
+            return 1;
+        }
+
+        if (!options.lines)
+        {
+            add(data.data(), data.size(), training, test, count);
+            continue;
+        }
+
+        size_t begin = 0;
+        while (begin < data.size())
+        {
+            size_t end = begin;
+            while (end < data.size() && data[end] != '\n')
+            {
+                ++end;
+            }
+            end = std::min(end + 1, data.size());
+            add(data.data() + begin, end - begin, training, test, count);
+            begin = end;
+        }
+    }
+
+    // If there are too few messages to hold some out, the dictionary is tested on the training set
+    if (test.sizes.empty())
+    {
+        test = training;
+    }
+
+    std::shared_ptr<zdictionary const> dictionary = zdictionary::train(training.data.data(), training.sizes,
+                                                                       options.size, options.segment);
+    if (!dictionary->save(options.output.c_str()))
+    {
+        fprintf(stderr, "cannot write %s\n", options.output.c_str());
+        return 1;
+    }
+
+    double before;
+    double after;
+    size_t const raw        = test.data.size();
+    size_t const plain      = compressAll(test, nullptr, options.level, before);
+    size_t const primed     = compressAll(test, dictionary, options.level, after);
+    size_t const n          = std::max(test.sizes.size(), size_t(1));
+
+    printf("%zu messages (%zu bytes) trained a dictionary of %zu bytes, id %08lx\n",
+           training.sizes.size(), training.data.size(), dictionary->size(), dictionary->id());
+    printf("%zu test messages (%zu bytes):\n", test.sizes.size(), raw);
+    printf("    without dictionary: %zu bytes (ratio %.2f), %.2f us per message\n",
+           plain, double(raw) / double(std::max(plain, size_t(1))), before * 1e6 / double(n));
+    printf("    with dictionary:    %zu bytes (ratio %.2f), %.2f us per message\n",
+           primed, double(raw) / double(std::max(primed, size_t(1))), after * 1e6 / double(n));
+    return 0;
+}
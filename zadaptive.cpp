@@ -0,0 +1,298 @@
+/** @file *//********************************************************************************************************
+
+                                                   zadaptive.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zadaptive.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zadaptive.h"
+
+#include "zlib/zlib.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+
+// The ladder of settings, from the slowest to the fastest. The first rungs are levels 9 to 1.
+int const LEVEL_RUNGS  = 9;
+int const RLE_RUNG     = LEVEL_RUNGS;
+int const HUFFMAN_RUNG = LEVEL_RUNGS + 1;
+int const STORED_RUNG  = LEVEL_RUNGS + 2;
+
+// A block that compresses to at least this fraction of its size is incompressible
+double const INCOMPRESSIBLE_RATIO = 0.98;
+
+// A probe of stored data must compress to less than this fraction for the data to be compressed again. The gap
+// between this and INCOMPRESSIBLE_RATIO keeps the controller from switching back and forth.
+double const COMPRESSIBLE_RATIO = 0.95;
+
+// A strategy is kept after a probe only if it compresses better by at least this fraction
+double const STRATEGY_GAIN = 0.01;
+
+// A slower setting is used only if the target is beaten by this factor. Adjacent levels differ in speed by less than
+// this, so the controller settles instead of alternating between them.
+double const HEADROOM = 1.5;
+
+// Number of blocks between probes of the strategy
+unsigned const PROBE_INTERVAL = 8;
+
+// Number of blocks between probes of stored data. Such a probe uses Z_HUFFMAN_ONLY, which is cheap even on data that
+// does not compress, and which still shows whether the data compresses.
+unsigned const STORED_PROBE_INTERVAL = 2;
+
+// The sample is this many runs of SAMPLE_RUN bytes, spread evenly over the data. Runs are cheaper to read than
+// scattered bytes.
+size_t const SAMPLE_RUNS = 64;
+size_t const SAMPLE_RUN  = 64;
+
+// Data whose bytes have at least this entropy (in bits per byte) is incompressible. The entropy of a sample is
+// corrected for its size, so random bytes measure about 8 at any size. Data compressed by deflate or zstd, and
+// encrypted data, look the same, while text and most binary formats are below 7.
+double const INCOMPRESSIBLE_ENTROPY = 7.8;
+
+// Returns the rung of a level
+int rungOf(int level)
+{
+    if (level == Z_DEFAULT_COMPRESSION)
+    {
+        level = 6;
+    }
+    return (level <= 0) ? STORED_RUNG : LEVEL_RUNGS - std::min(level, 9);
+}
+
+} // anonymous namespace
+
+//! @param	target  What the controller aims for
+//! @param	level   Initial level (Z_DEFAULT_COMPRESSION is 6)
+
+zadaptive::zadaptive(Target const & target, int level)
+    : target_(target)
+    , rung_(rungOf(level))
+    , filtered_(false)
+    , resume_(rungOf(Z_DEFAULT_COMPRESSION))
+    , probe_(NO_PROBE)
+    , blocks_(0)
+    , lastRatio_(1.0)
+    , in_(0)
+    , out_(0)
+    , time_(0)
+    , start_(std::chrono::steady_clock::now())
+    , position_(0)
+{
+    target_.blockSize = std::max(target_.blockSize, size_t(1));
+}
+
+//! @param	in      Number of uncompressed characters
+//! @param	out     Number of compressed bytes produced (including output of earlier writes that the compressor held)
+//! @param	time    Time spent compressing
+
+bool zadaptive::update(size_t in, size_t out, std::chrono::nanoseconds time)
+{
+    in_   += in;
+    out_  += out;
+    time_ += time;
+    if (in_ < target_.blockSize)
+    {
+        return false;
+    }
+
+    // The speed is measured in the compressor, and the CPU usage against the time since the block started
+    std::chrono::steady_clock::time_point const now = std::chrono::steady_clock::now();
+    double const seconds = std::max(std::chrono::duration<double>(time_).count(), 1e-9);
+    double const elapsed = std::max(std::chrono::duration<double>(now - start_).count(), seconds);
+    double const ratio   = double(out_) / double(in_);
+    double const speed   = double(in_) / seconds / 1e6;
+    double const cpu     = seconds / elapsed;
+
+    position_ += in_;
+    in_        = 0;
+    out_       = 0;
+    time_      = std::chrono::nanoseconds(0);
+    start_     = now;
+
+    return decide(ratio, speed, cpu);
+}
+
+int zadaptive::level() const
+{
+    return (rung_ < LEVEL_RUNGS) ? LEVEL_RUNGS - rung_ : (rung_ == STORED_RUNG) ? 0 : 1;
+}
+
+int zadaptive::strategy() const
+{
+    return (rung_ < LEVEL_RUNGS)    ? (filtered_ ? Z_FILTERED : Z_DEFAULT_STRATEGY)
+         : (rung_ == RLE_RUNG)      ? Z_RLE
+         : (rung_ == HUFFMAN_RUNG)  ? Z_HUFFMAN_ONLY
+                                    : Z_DEFAULT_STRATEGY;
+}
+
+//! @param	data    Data to judge
+//! @param	size    Size of the data. Only a sample of 4 KB is read, so the cost does not depend on the size.
+//!
+//! The data is judged by the entropy of its bytes, which is how well a Huffman code alone could compress them. Data
+//! that does not compress that way may still have long repeated strings, but data that is already compressed or
+//! encrypted does not, and that is what this is for.
+
+bool zadaptive::incompressible(unsigned char const * data, size_t size)
+{
+    uint32_t counts[256] = { 0 };
+    size_t   sampled     = 0;
+    if (size <= SAMPLE_RUNS * SAMPLE_RUN)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            ++counts[data[i]];
+        }
+        sampled = size;
+    }
+    else
+    {
+        size_t const stride = (size - SAMPLE_RUN) / (SAMPLE_RUNS - 1);
+        for (size_t run = 0; run < SAMPLE_RUNS; ++run)
+        {
+            unsigned char const * p = data + run * stride;
+            for (size_t i = 0; i < SAMPLE_RUN; ++i)
+            {
+                ++counts[p[i]];
+            }
+        }
+        sampled = SAMPLE_RUNS * SAMPLE_RUN;
+    }
+    if (sampled == 0)
+    {
+        return false;
+    }
+
+    // H = log2(n) - sum(c * log2(c)) / n
+    double   sum      = 0.0;
+    unsigned observed = 0;
+    for (uint32_t count : counts)
+    {
+        if (count > 0)
+        {
+            sum += double(count) * std::log2(double(count));
+            ++observed;
+        }
+    }
+
+    // A sample underestimates the entropy by about (m - 1) / (2 n ln 2), where m is the number of different bytes in
+    // it (the Miller-Madow correction). For 1 KB of random bytes, that is 0.18 bits, enough to reach the threshold.
+    double const bias    = double(observed - 1) / (2.0 * double(sampled) * std::log(2.0));
+    double const entropy = std::log2(double(sampled)) - sum / double(sampled) + bias;
+    return entropy >= INCOMPRESSIBLE_ENTROPY;
+}
+
+//! @param	ratio   Compressed size / uncompressed size of the block
+//! @param	speed   Speed of the compressor in MB per second
+//! @param	cpu     Fraction of the elapsed time spent compressing
+
+bool zadaptive::decide(double ratio, double speed, double cpu)
+{
+    Probe const probe = probe_;
+    probe_ = NO_PROBE;
+    ++blocks_;
+
+    bool const slow = (target_.megabytesPerSecond > 0.0 && speed < target_.megabytesPerSecond) ||
+                      (target_.cpu > 0.0 && cpu > target_.cpu);
+    bool const fast = (target_.megabytesPerSecond > 0.0 || target_.cpu > 0.0) &&
+                      (target_.megabytesPerSecond <= 0.0 || speed > target_.megabytesPerSecond * HEADROOM) &&
+                      (target_.cpu <= 0.0 || cpu * HEADROOM < target_.cpu);
+
+    // Stored data gives no measure of how compressible it is, so now and then it is compressed to find out
+    if (probe == STORED_PROBE)
+    {
+        return (ratio < COMPRESSIBLE_RATIO) ? change(resume_, filtered_, COMPRESSIBLE, ratio, speed, cpu)
+                                            : change(STORED_RUNG, filtered_, INCOMPRESSIBLE, ratio, speed, cpu);
+    }
+    if (rung_ == STORED_RUNG)
+    {
+        if (blocks_ < STORED_PROBE_INTERVAL)
+        {
+            return false;
+        }
+        probe_ = STORED_PROBE;
+        return change(HUFFMAN_RUNG, filtered_, PROBE, ratio, speed, cpu);
+    }
+
+    // Data that does not compress is stored, whatever the speed. A failed probe of Z_FILTERED is undone first.
+    if (ratio >= INCOMPRESSIBLE_RATIO)
+    {
+        if (probe == FILTER_PROBE)
+        {
+            filtered_ = !filtered_;
+        }
+        resume_ = rung_;
+        return change(STORED_RUNG, filtered_, INCOMPRESSIBLE, ratio, speed, cpu);
+    }
+
+    // The strategy that was probed is kept only if it is better
+    if (probe == FILTER_PROBE)
+    {
+        bool const better = !slow && ratio < lastRatio_ * (1.0 - STRATEGY_GAIN);
+        bool const filtered = better ? filtered_ : !filtered_;
+        if (better)
+        {
+            lastRatio_ = ratio;
+        }
+        return change(rung_, filtered, filtered ? FILTERED : UNFILTERED, ratio, speed, cpu);
+    }
+
+    lastRatio_ = ratio;
+    if (slow && rung_ < HUFFMAN_RUNG)
+    {
+        return change(rung_ + 1, filtered_, TOO_SLOW, ratio, speed, cpu);
+    }
+    if (fast && rung_ > 0)
+    {
+        return change(rung_ - 1, filtered_, FAST_ENOUGH, ratio, speed, cpu);
+    }
+
+    // Now and then, the other strategy is tried
+    if (rung_ < LEVEL_RUNGS && blocks_ >= PROBE_INTERVAL)
+    {
+        probe_ = FILTER_PROBE;
+        return change(rung_, !filtered_, PROBE, ratio, speed, cpu);
+    }
+    return false;
+}
+
+//! @param	rung        New setting
+//! @param	filtered    True if levels use Z_FILTERED
+//! @param	reason      Why it changed
+//! @param	ratio       Ratio of the block that led to the decision
+//! @param	speed       Speed of the compressor during that block
+//! @param	cpu         Fraction of the elapsed time spent compressing during that block
+
+bool zadaptive::change(int rung, bool filtered, Reason reason, double ratio, double speed, double cpu)
+{
+    int const oldLevel    = level();
+    int const oldStrategy = strategy();
+    rung_     = rung;
+    filtered_ = filtered;
+    blocks_   = 0;
+
+    Decision decision;
+    decision.position           = position_;
+    decision.level              = level();
+    decision.strategy           = strategy();
+    decision.reason             = reason;
+    decision.ratio              = ratio;
+    decision.megabytesPerSecond = speed;
+    decision.cpu                = cpu;
+    decisions_.push_back(decision);
+    if (decisions_.size() > MAX_DECISIONS)
+    {
+        decisions_.pop_front();
+    }
+
+    return level() != oldLevel || strategy() != oldStrategy;
+}
@@ -0,0 +1,79 @@
+/** @file *//********************************************************************************************************
+
+                                                   zallocator.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zallocator.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zallocator.h"
+
+#include <cstddef>
+
+namespace
+{
+
+// zlib does not pass the size of a block when freeing it, but a memory resource needs it, so it is stored in a
+// header in front of the block. The header keeps the block aligned.
+size_t const ALIGNMENT   = alignof(std::max_align_t);
+size_t const HEADER_SIZE = (sizeof(size_t) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+} // anonymous namespace
+
+//! @param	stream		zlib stream
+//! @param	resource	Memory resource that provides the memory, or nullptr to use zlib's default allocation. It must
+//!                     outlive the stream.
+
+void zallocator::attach(z_stream & stream, std::pmr::memory_resource * resource)
+{
+    if (resource)
+    {
+        stream.zalloc = &zallocator::allocate;
+        stream.zfree  = &zallocator::deallocate;
+        stream.opaque = resource;
+    }
+    else
+    {
+        stream.zalloc = Z_NULL;
+        stream.zfree  = Z_NULL;
+        stream.opaque = Z_NULL;
+    }
+}
+
+//! @param	opaque	Memory resource
+//! @param	items	Number of items
+//! @param	size	Size of each item
+//!
+//! @return     The allocated memory, or Z_NULL if it could not be allocated
+
+voidpf zallocator::allocate(voidpf opaque, uInt items, uInt size)
+{
+    std::pmr::memory_resource * const resource = static_cast<std::pmr::memory_resource *>(opaque);
+    size_t const n = size_t(items) * size_t(size);
+
+    try
+    {
+        char * block = static_cast<char *>(resource->allocate(HEADER_SIZE + n, ALIGNMENT));
+        *reinterpret_cast<size_t *>(block) = n;
+        return block + HEADER_SIZE;
+    }
+    catch (...)
+    {
+        return Z_NULL;  // zlib reports Z_MEM_ERROR
+    }
+}
+
+//! @param	opaque	Memory resource
+//! @param	address	Memory returned by allocate()
+
+void zallocator::deallocate(voidpf opaque, voidpf address)
+{
+    std::pmr::memory_resource * const resource = static_cast<std::pmr::memory_resource *>(opaque);
+    char * block = static_cast<char *>(address) - HEADER_SIZE;
+    resource->deallocate(block, HEADER_SIZE + *reinterpret_cast<size_t *>(block), ALIGNMENT);
+}
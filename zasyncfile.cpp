@@ -0,0 +1,422 @@
+/** @file *//********************************************************************************************************
+
+                                                   zasyncfile.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zasyncfile.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zasyncfile.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+// Moves the file pointer
+bool position(FILE * file, zasyncfile::off_type offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, offset, SEEK_SET) == 0;
+#endif
+}
+
+} // anonymous namespace
+
+//! @param	bufferSize  Size of each buffer
+//! @param	bufferCount Number of buffers. At least 2 are used, so that the caller and the worker can both have one.
+
+zasyncfile::zasyncfile(size_t bufferSize /* = DEFAULT_BUFFER_SIZE*/, unsigned bufferCount /* = DEFAULT_BUFFER_COUNT*/)
+    : bufferSize_(std::max(bufferSize, size_t(1)))
+    , bufferCount_(std::max(bufferCount, 2u))
+    , file_(nullptr)
+    , write_(false)
+    , position_(0)
+    , size_(0)
+    , busy_(0)
+    , fetch_(0)
+    , generation_(0)
+    , end_(false)
+    , error_(false)
+    , stop_(false)
+{
+}
+
+zasyncfile::~zasyncfile()
+{
+    close();
+}
+
+//! @param	name    Name of the file
+//! @param	write   If true, the file is created for writing. Otherwise, it is opened for reading.
+
+bool zasyncfile::open(char const * name, bool write)
+{
+    if (file_)
+    {
+        return false;
+    }
+
+    file_ = fopen(name, write ? "wb" : "rb");
+    if (!file_)
+    {
+        return false;
+    }
+
+    size_ = 0;
+    if (!write)
+    {
+#if defined(_WIN32)
+        _fseeki64(file_, 0, SEEK_END);
+        size_ = _ftelli64(file_);
+#else
+        fseeko(file_, 0, SEEK_END);
+        size_ = ftello(file_);
+#endif
+        if (size_ < 0 || !position(file_, 0))
+        {
+            fclose(file_);
+            file_ = nullptr;
+            return false;
+        }
+    }
+
+    // The buffers are allocated once and then passed back and forth
+    for (unsigned i = 0; i < bufferCount_; ++i)
+    {
+        std::unique_ptr<Buffer> buffer(new Buffer);
+        buffer->data.resize(bufferSize_);
+        buffer->size     = 0;
+        buffer->consumed = 0;
+        buffer->offset   = 0;
+        free_.push_back(std::move(buffer));
+    }
+
+    // The writer fills a buffer while the worker writes the others
+    if (write)
+    {
+        current_ = std::move(free_.front());
+        free_.pop_front();
+    }
+
+    write_      = write;
+    position_   = 0;
+    busy_       = 0;
+    fetch_      = 0;
+    generation_ = 0;
+    end_        = false;
+    error_      = false;
+    stop_       = false;
+    worker_     = std::thread(&zasyncfile::worker, this);
+
+    return true;
+}
+
+//! @note   Any data that has been written is in the file when this returns.
+
+bool zasyncfile::close()
+{
+    if (!file_)
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // The worker writes everything that is queued before it exits
+        if (write_ && current_ && current_->size > 0)
+        {
+            queued_.push_back(std::move(current_));
+        }
+        stop_ = true;
+    }
+    workReady_.notify_all();
+    worker_.join();
+
+    bool ok = !error_;
+    if (fclose(file_) != 0)
+    {
+        ok = false;
+    }
+    file_ = nullptr;
+
+    current_.reset();
+    free_.clear();
+    queued_.clear();
+
+    return ok;
+}
+
+//! @param	s   Where to put the data
+//! @param	n   Maximum number of bytes to read
+
+size_t zasyncfile::read(char_type * s, size_t n)
+{
+    if (!file_ || write_)
+    {
+        return 0;
+    }
+
+    size_t total = 0;
+    while (total < n)
+    {
+        if ((!current_ || current_->consumed == current_->size) && !next())
+        {
+            break;
+        }
+
+        size_t const size = std::min(n - total, current_->size - current_->consumed);
+        memcpy(s + total, current_->data.data() + current_->consumed, size);
+        current_->consumed += size;
+        total              += size;
+    }
+
+    position_ += off_type(total);
+    return total;
+}
+
+//! @param	s   Data to write
+//! @param	n   Number of bytes to write
+
+bool zasyncfile::write(char_type const * s, size_t n)
+{
+    if (!file_ || !write_)
+    {
+        return false;
+    }
+
+    while (n > 0)
+    {
+        size_t const size = std::min(n, bufferSize_ - current_->size);
+        memcpy(current_->data.data() + current_->size, s, size);
+        current_->size += size;
+        position_      += off_type(size);
+        s += size;
+        n -= size;
+
+        if (current_->size == bufferSize_ && !submit())
+        {
+            return false;
+        }
+    }
+
+    return !error();
+}
+
+bool zasyncfile::flush()
+{
+    if (!file_ || !write_)
+    {
+        return false;
+    }
+
+    if (current_->size > 0 && !submit())
+    {
+        return false;
+    }
+
+    // The worker is idle once everything has been written, so the file can be flushed here
+    std::unique_lock<std::mutex> lock(mutex_);
+    bufferReady_.wait(lock, [this] { return queued_.empty() && busy_ == 0; });
+    return !error_ && fflush(file_) == 0;
+}
+
+//! @param	offset  Offset in the file
+//!
+//! @note   If the offset is in data that has already been read ahead, the data is reused. Otherwise, the data that
+//!         has been read ahead is discarded and reading resumes at the offset.
+
+bool zasyncfile::seek(off_type offset)
+{
+    if (!file_ || write_ || offset < 0)
+    {
+        return false;
+    }
+
+    position_ = offset;
+
+    // Moving within the current buffer is free
+    if (current_ && current_->offset <= offset && offset <= current_->offset + off_type(current_->size))
+    {
+        current_->consumed = size_t(offset - current_->offset);
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (current_)
+        {
+            free_.push_back(std::move(current_));
+        }
+
+        // Skip the buffers that have been read ahead and precede the offset
+        while (!queued_.empty() && queued_.front()->offset + off_type(queued_.front()->size) <= offset)
+        {
+            free_.push_back(std::move(queued_.front()));
+            queued_.pop_front();
+        }
+
+        if (!queued_.empty() && queued_.front()->offset <= offset)
+        {
+            current_ = std::move(queued_.front());
+            queued_.pop_front();
+            current_->consumed = size_t(offset - current_->offset);
+        }
+        else
+        {
+            // Discard everything and start reading at the offset. A read in progress at the offset is kept.
+            while (!queued_.empty())
+            {
+                free_.push_back(std::move(queued_.front()));
+                queued_.pop_front();
+            }
+            if (offset != fetch_)
+            {
+                fetch_ = offset;
+                end_   = false;
+                error_ = false;
+                ++generation_;
+            }
+        }
+    }
+    workReady_.notify_one();
+
+    return true;
+}
+
+bool zasyncfile::error() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_;
+}
+
+bool zasyncfile::submit()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        queued_.push_back(std::move(current_));
+        workReady_.notify_one();
+
+        bufferReady_.wait(lock, [this] { return !free_.empty(); });
+        current_ = std::move(free_.front());
+        free_.pop_front();
+        if (error_)
+        {
+            return false;
+        }
+    }
+
+    current_->size = 0;
+    return true;
+}
+
+bool zasyncfile::next()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (current_)
+    {
+        free_.push_back(std::move(current_));
+        workReady_.notify_one();
+    }
+
+    bufferReady_.wait(lock, [this] { return !queued_.empty() || end_; });
+    if (queued_.empty())
+    {
+        return false;
+    }
+
+    current_ = std::move(queued_.front());
+    queued_.pop_front();
+    return true;
+}
+
+void zasyncfile::worker()
+{
+    off_type filePosition = 0;  // Offset of the file pointer, or -1 if it is not known
+
+    for (;;)
+    {
+        std::unique_ptr<Buffer> buffer;
+        off_type offset     = 0;
+        unsigned generation = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (write_)
+            {
+                // Everything queued is written before exiting
+                workReady_.wait(lock, [this] { return stop_ || !queued_.empty(); });
+                if (queued_.empty())
+                {
+                    break;
+                }
+                buffer = std::move(queued_.front());
+                queued_.pop_front();
+            }
+            else
+            {
+                // Reads ahead until all the buffers are full or the end of the file is reached
+                workReady_.wait(lock, [this] { return stop_ || (!end_ && !free_.empty()); });
+                if (stop_)
+                {
+                    break;
+                }
+                buffer = std::move(free_.front());
+                free_.pop_front();
+                offset     = fetch_;
+                generation = generation_;
+            }
+            ++busy_;
+        }
+
+        bool ok;
+        if (write_)
+        {
+            ok = fwrite(buffer->data.data(), 1, buffer->size, file_) == buffer->size;
+            buffer->size = 0;
+        }
+        else
+        {
+            ok = (offset == filePosition) || position(file_, offset);
+            buffer->size     = ok ? fread(buffer->data.data(), 1, bufferSize_, file_) : 0;
+            buffer->consumed = 0;
+            buffer->offset   = offset;
+            ok               = ok && !ferror(file_);
+            filePosition     = ok ? offset + off_type(buffer->size) : -1;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --busy_;
+            if (!write_ && generation == generation_)
+            {
+                // A short read means the end of the file (or an error)
+                end_    = (buffer->size < bufferSize_);
+                fetch_ += off_type(buffer->size);
+                if (buffer->size > 0)
+                {
+                    queued_.push_back(std::move(buffer));
+                }
+            }
+            if (!ok && (write_ || generation == generation_))
+            {
+                error_ = true;
+            }
+            if (buffer)
+            {
+                free_.push_back(std::move(buffer));
+            }
+        }
+        bufferReady_.notify_all();
+    }
+}
@@ -0,0 +1,33 @@
+/** @file *//********************************************************************************************************
+
+                                                      zbytes.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zbytes.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+// Converts the characters of the stream buffers to the bytes that the codecs see. This header is private to the
+// library.
+
+#include "zcodec.h"
+
+// Returns the characters as bytes
+template <class CharT>
+zcodec::char_type * bytes(CharT * s)
+{
+    return reinterpret_cast<zcodec::char_type *>(s);
+}
+
+// Returns the characters as bytes
+template <class CharT>
+zcodec::char_type const * bytes(CharT const * s)
+{
+    return reinterpret_cast<zcodec::char_type const *>(s);
+}
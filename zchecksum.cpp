@@ -0,0 +1,391 @@
+/** @file *//********************************************************************************************************
+
+                                                   zchecksum.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zchecksum.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zchecksum.h"
+
+#include "zlib/zlib.h"
+
+#include <algorithm>
+#include <climits>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ZCHECKSUM_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang compile the kernels for their instruction sets without enabling them for the rest of the library.
+// MSVC always allows the intrinsics.
+#if defined(ZCHECKSUM_X86) && (defined(__GNUC__) || defined(__clang__))
+#define ZCHECKSUM_TARGET(features) __attribute__((target(features)))
+#else
+#define ZCHECKSUM_TARGET(features)
+#endif
+
+namespace
+{
+
+// The reflected CRC-32 polynomial of gzip
+uint32_t const POLYNOMIAL = 0xedb88320;
+
+// Adler-32 sums are modulo this
+uint32_t const BASE = 65521;
+
+// Largest number of bytes that can be added to the Adler-32 sums before they might overflow 32 bits
+size_t const NMAX = 5552;
+
+// Returns a * b modulo the CRC-32 polynomial, where a and b are reflected polynomials
+uint32_t multiplyModP(uint32_t a, uint32_t b)
+{
+    uint32_t product = 0;
+    for (uint32_t m = uint32_t(1) << 31; m != 0; m >>= 1)
+    {
+        if (a & m)
+        {
+            product ^= b;
+        }
+        b = (b & 1) ? (b >> 1) ^ POLYNOMIAL : b >> 1;
+    }
+    return product;
+}
+
+// Returns x^(8 * n) modulo the CRC-32 polynomial, which is the effect on a CRC of appending n zero bytes
+uint32_t zerosModP(unsigned long long n)
+{
+    // powers[k] is x^(2^k * 8)
+    static uint32_t const * const powers = [] {
+        static uint32_t table[64];
+        uint32_t p = uint32_t(1) << 23;     // x^8
+        for (uint32_t & power : table)
+        {
+            power = p;
+            p     = multiplyModP(p, p);
+        }
+        return table;
+    }();
+
+    uint32_t result = uint32_t(1) << 31;    // x^0
+    for (int k = 0; n != 0; n >>= 1, ++k)
+    {
+        if (n & 1)
+        {
+            result = multiplyModP(powers[k], result);
+        }
+    }
+    return result;
+}
+
+// zlib's functions take sizes that fit in an unsigned int
+uint32_t zlibCrc32(uint32_t crc, unsigned char const * data, size_t size)
+{
+    for (size_t n; size > 0; data += n, size -= n)
+    {
+        n   = std::min(size, size_t(UINT_MAX));
+        crc = uint32_t(::crc32(crc, data, uInt(n)));
+    }
+    return crc;
+}
+
+uint32_t zlibAdler32(uint32_t adler, unsigned char const * data, size_t size)
+{
+    for (size_t n; size > 0; data += n, size -= n)
+    {
+        n     = std::min(size, size_t(UINT_MAX));
+        adler = uint32_t(::adler32(adler, data, uInt(n)));
+    }
+    return adler;
+}
+
+#if defined(ZCHECKSUM_X86)
+
+// Returns true if the CPU supports PCLMULQDQ and SSE4.1
+bool hasPclmul()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 1)) != 0 && (info[2] & (1 << 19)) != 0;
+#else
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+// Returns true if the CPU supports AVX2, and the OS saves its registers
+bool hasAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool const osSaves = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSaves && (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// Folding constants for the gzip polynomial (from Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+// Instruction")
+alignas(16) uint64_t const FOLD_BY_4[2] = { 0x0154442bd4, 0x01c6e41596 };  // x^(4*128+32), x^(4*128-32)
+alignas(16) uint64_t const FOLD_BY_1[2] = { 0x01751997d0, 0x00ccaa009e };  // x^(128+32), x^(128-32)
+alignas(16) uint64_t const FOLD_TO_64[2] = { 0x0163cd6124, 0x0000000000 }; // x^64
+alignas(16) uint64_t const BARRETT[2] = { 0x01db710641, 0x01f7011641 };    // The polynomial, and x^64 / polynomial
+
+// Returns the CRC of data by folding it with carry-less multiplication. The CRC is not inverted before or after. The
+// size must be a multiple of 16 and at least 64.
+ZCHECKSUM_TARGET("pclmul,sse4.1")
+uint32_t foldCrc32(uint32_t crc, unsigned char const * data, size_t size)
+{
+    __m128i x1 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x00));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x10));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x20));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(int(crc)));
+    data += 64;
+    size -= 64;
+
+    // Fold 4 x 128 bits at a time
+    __m128i k = _mm_load_si128(reinterpret_cast<__m128i const *>(FOLD_BY_4));
+    for (; size >= 64; data += 64, size -= 64)
+    {
+        __m128i const y1 = _mm_clmulepi64_si128(x1, k, 0x00);
+        __m128i const y2 = _mm_clmulepi64_si128(x2, k, 0x00);
+        __m128i const y3 = _mm_clmulepi64_si128(x3, k, 0x00);
+        __m128i const y4 = _mm_clmulepi64_si128(x4, k, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, y1), _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, y2), _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, y3), _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, y4), _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x30)));
+    }
+
+    // Fold the 4 x 128 bits into 128 bits, then fold in the rest 128 bits at a time
+    k = _mm_load_si128(reinterpret_cast<__m128i const *>(FOLD_BY_1));
+    __m128i const rest[3] = { x2, x3, x4 };
+    for (__m128i const & next : rest)
+    {
+        __m128i const y = _mm_clmulepi64_si128(x1, k, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x11), next), y);
+    }
+    for (; size >= 16; data += 16, size -= 16)
+    {
+        __m128i const y = _mm_clmulepi64_si128(x1, k, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k, 0x11),
+                                         _mm_loadu_si128(reinterpret_cast<__m128i const *>(data))),
+                           y);
+    }
+
+    // Fold 128 bits into 64 bits
+    __m128i const low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    k  = _mm_loadl_epi64(reinterpret_cast<__m128i const *>(FOLD_TO_64));
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, low32), k, 0x00), x2);
+
+    // Reduce 64 bits to the 32-bit CRC with Barrett reduction
+    k  = _mm_load_si128(reinterpret_cast<__m128i const *>(BARRETT));
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), k, 0x10);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, low32), k, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return uint32_t(_mm_extract_epi32(x1, 1));
+}
+
+uint32_t pclmulCrc32(uint32_t crc, unsigned char const * data, size_t size)
+{
+    // Short data is not worth folding
+    if (size < 256)
+    {
+        return zlibCrc32(crc, data, size);
+    }
+
+    size_t const folded = size & ~size_t(15);
+    crc = ~foldCrc32(~crc, data, folded);
+    return zlibCrc32(crc, data + folded, size - folded);
+}
+
+// Returns the sum of the 32-bit elements
+ZCHECKSUM_TARGET("avx2")
+uint64_t sum32(__m256i v)
+{
+    alignas(32) uint32_t elements[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(elements), v);
+    uint64_t sum = 0;
+    for (uint32_t element : elements)
+    {
+        sum += element;
+    }
+    return sum;
+}
+
+// Returns the Adler-32 of data by summing 32 bytes at a time
+ZCHECKSUM_TARGET("avx2")
+uint32_t avx2Adler32(uint32_t adler, unsigned char const * data, size_t size)
+{
+    // Short data is not worth vectorizing
+    if (size < 64)
+    {
+        return zlibAdler32(adler, data, size);
+    }
+
+    uint32_t s1 = adler & 0xffff;
+    uint32_t s2 = adler >> 16;
+
+    // Each byte of a block of 32 adds itself to s1, and itself times its distance from the end of the block to s2
+    __m256i const weights = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+                                             16, 15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1);
+    __m256i const ones    = _mm256_set1_epi16(1);
+    __m256i const zero    = _mm256_setzero_si256();
+
+    // The sums are reduced modulo BASE after at most NMAX bytes
+    for (size_t blocks = size / 32; blocks > 0;)
+    {
+        size_t const n = std::min(blocks, NMAX / 32);
+        blocks -= n;
+        size   -= n * 32;
+
+        __m256i previous = zero;    // Sum of s1 before each block
+        __m256i v1       = zero;
+        __m256i v2       = zero;
+        for (size_t i = 0; i < n; ++i, data += 32)
+        {
+            __m256i const bytes = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(data));
+            previous = _mm256_add_epi32(previous, v1);
+            v1       = _mm256_add_epi32(v1, _mm256_sad_epu8(bytes, zero));
+            v2       = _mm256_add_epi32(v2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, weights), ones));
+        }
+
+        uint64_t const sum2 = uint64_t(s2) + uint64_t(s1) * 32 * n + 32 * sum32(previous) + sum32(v2);
+        s1 = uint32_t((s1 + sum32(v1)) % BASE);
+        s2 = uint32_t(sum2 % BASE);
+    }
+
+    return zlibAdler32(s1 | (s2 << 16), data, size);
+}
+
+#endif // defined(ZCHECKSUM_X86)
+
+typedef uint32_t (*Kernel)(uint32_t, unsigned char const *, size_t);
+
+// An implementation of a checksum
+struct Implementation
+{
+    Kernel kernel;
+    char const * name;
+};
+
+Implementation const & crc32Implementation()
+{
+#if defined(ZCHECKSUM_X86)
+    static Implementation const implementation = hasPclmul() ? Implementation{ pclmulCrc32, "pclmul" }
+                                                             : Implementation{ zlibCrc32, "zlib" };
+#else
+    static Implementation const implementation = { zlibCrc32, "zlib" };
+#endif
+    return implementation;
+}
+
+Implementation const & adler32Implementation()
+{
+#if defined(ZCHECKSUM_X86)
+    static Implementation const implementation = hasAvx2() ? Implementation{ avx2Adler32, "avx2" }
+                                                           : Implementation{ zlibAdler32, "zlib" };
+#else
+    static Implementation const implementation = { zlibAdler32, "zlib" };
+#endif
+    return implementation;
+}
+
+} // anonymous namespace
+
+//! @param	data    Data to add
+//! @param	size    Size of the data
+
+void zchecksum::update(void const * data, size_t size)
+{
+    value_   = (type_ == ADLER32) ? adler32(value_, data, size) : crc32(value_, data, size);
+    length_ += size;
+}
+
+//! @param	next    Checksum of the data that follows
+
+void zchecksum::combine(zchecksum const & next)
+{
+    value_   = (type_ == ADLER32) ? adler32_combine(value_, next.value_, next.length_)
+                                  : crc32_combine(value_, next.value_, next.length_);
+    length_ += next.length_;
+}
+
+//! @param	crc     CRC-32 of the preceding data (0 for none)
+//! @param	data    Data to add
+//! @param	size    Size of the data
+
+uint32_t zchecksum::crc32(uint32_t crc, void const * data, size_t size)
+{
+    return crc32Implementation().kernel(crc, static_cast<unsigned char const *>(data), size);
+}
+
+//! @param	adler   Adler-32 of the preceding data (1 for none)
+//! @param	data    Data to add
+//! @param	size    Size of the data
+
+uint32_t zchecksum::adler32(uint32_t adler, void const * data, size_t size)
+{
+    return adler32Implementation().kernel(adler, static_cast<unsigned char const *>(data), size);
+}
+
+//! @param	crc1    CRC-32 of the first piece
+//! @param	crc2    CRC-32 of the second piece
+//! @param	size2   Size of the second piece
+//!
+//! @note   Unlike zlib's crc32_combine(), the size is 64 bits on every platform. The cost is logarithmic in the size.
+
+uint32_t zchecksum::crc32_combine(uint32_t crc1, uint32_t crc2, unsigned long long size2)
+{
+    return multiplyModP(zerosModP(size2), crc1) ^ crc2;
+}
+
+//! @param	adler1  Adler-32 of the first piece
+//! @param	adler2  Adler-32 of the second piece
+//! @param	size2   Size of the second piece
+
+uint32_t zchecksum::adler32_combine(uint32_t adler1, uint32_t adler2, unsigned long long size2)
+{
+    // The second piece's sums start from 1 and 0. Starting from the first's instead adds (s1 - 1) to its s1, and
+    // size2 * s1 to its s2 (see zlib's adler32_combine()).
+    uint32_t const remainder = uint32_t(size2 % BASE);
+    uint32_t       sum1      = adler1 & 0xffff;
+    uint32_t       sum2      = (remainder * sum1) % BASE;
+    sum1 += (adler2 & 0xffff) + BASE - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + BASE - remainder;
+    sum1 %= BASE;
+    sum2 %= BASE;
+    return sum1 | (sum2 << 16);
+}
+
+//! @param	type    Type of checksum
+
+char const * zchecksum::implementation(Type type)
+{
+    return (type == ADLER32) ? adler32Implementation().name : crc32Implementation().name;
+}
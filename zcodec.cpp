@@ -0,0 +1,748 @@
+/** @file *//********************************************************************************************************
+
+                                                     zcodec.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zcodec.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zcodec.h"
+
+#include "zallocator.h"
+#include "zdictionary.h"
+#include "zlib/zlib.h"
+
+#if defined(ZSTREAM_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(ZSTREAM_HAVE_LZ4)
+#include <lz4frame.h>
+#endif
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+
+// Largest level of each codec
+int const MAX_ZLIB_LEVEL = 9;
+int const MAX_ZSTD_LEVEL = 22;
+int const MAX_LZ4_LEVEL  = 12;
+
+// Compresses and decompresses the formats of zlib
+class ZlibCodec : public zcodec
+{
+public:
+    ZlibCodec(Type type, bool compress, Options const & options, std::pmr::memory_resource * resource)
+        : zcodec(type)
+        , compress_(compress)
+        , initialized_(false)
+        , level_(options.level)
+        , pendingLevel_(options.level)
+        , strategy_(options.strategy)
+        , pendingStrategy_(options.strategy)
+        , dictionary_(options.dictionary)
+    {
+        zallocator::attach(stream_, resource);
+        stream_.next_in  = Z_NULL;
+        stream_.avail_in = 0;
+
+        int bits = (options.window > 0) ? std::min(std::max(options.window, 9), MAX_WBITS) : MAX_WBITS;
+        if (type == GZIP)
+        {
+            bits += 16;
+        }
+        else if (type == DEFLATE)
+        {
+            bits = -bits;
+        }
+
+        initialized_ = compress ? (deflateInit2(&stream_, level_, Z_DEFLATED, bits, 8, strategy_) == Z_OK)
+                                : (inflateInit2(&stream_, bits) == Z_OK);
+        if (initialized_)
+        {
+            prime();
+        }
+    }
+
+    virtual ~ZlibCodec() override
+    {
+        if (initialized_)
+        {
+            if (compress_)
+            {
+                deflateEnd(&stream_);
+            }
+            else
+            {
+                inflateEnd(&stream_);
+            }
+        }
+    }
+
+    // Returns true if zlib was initialized
+    bool initialized() const { return initialized_; }
+
+    virtual Status compress(char_type const * & in,
+                            size_t &            inSize,
+                            char_type * &       out,
+                            size_t &            outSize,
+                            Flush               flush) override
+    {
+        // A new level is applied first so that the data preceding the change is compressed with the old level. zlib
+        // may need to finish the current block, and it reports Z_BUF_ERROR if there is not enough room for it.
+        if (pendingLevel_ != level_ || pendingStrategy_ != strategy_)
+        {
+            stream_.next_in  = Z_NULL;
+            stream_.avail_in = 0;
+            setOutput(out, outSize);
+            int const status = deflateParams(&stream_, pendingLevel_, pendingStrategy_);
+            getOutput(out, outSize);
+            if (status == Z_BUF_ERROR)
+            {
+                return OK;
+            }
+            if (status != Z_OK)
+            {
+                return INVALID;
+            }
+            level_    = pendingLevel_;
+            strategy_ = pendingStrategy_;
+        }
+
+        // The input is handed to zlib in pieces that fit in a uInt, so a flush waits for the last piece
+        stream_.next_in  = const_cast<Bytef *>(in);
+        stream_.avail_in = uInt(std::min(inSize, size_t(UINT_MAX)));
+        bool const last  = (stream_.avail_in == inSize);
+        setOutput(out, outSize);
+
+        int const status = deflate(&stream_, !last                   ? Z_NO_FLUSH
+                                             : (flush == FINISH)        ? Z_FINISH
+                                             : (flush == PARTIAL_FLUSH) ? Z_PARTIAL_FLUSH
+                                             : (flush == SYNC_FLUSH)    ? Z_SYNC_FLUSH
+                                             : (flush == FULL_FLUSH)    ? Z_FULL_FLUSH
+                                                                        : Z_NO_FLUSH);
+        getInput(in, inSize);
+        getOutput(out, outSize);
+
+        if (status == Z_STREAM_END)
+        {
+            return END;
+        }
+        return (status == Z_OK || status == Z_BUF_ERROR) ? OK : INVALID;
+    }
+
+    virtual Status decompress(char_type const * & in, size_t & inSize, char_type * & out, size_t & outSize) override
+    {
+        stream_.next_in  = const_cast<Bytef *>(in);
+        stream_.avail_in = uInt(std::min(inSize, size_t(UINT_MAX)));
+        setOutput(out, outSize);
+
+        int status = inflate(&stream_, Z_NO_FLUSH);
+
+        // The zlib format names the dictionary it needs after the header, and the data cannot be decompressed with
+        // another one
+        if (status == Z_NEED_DICT)
+        {
+            status = (dictionary_ && stream_.adler == dictionary_->id() &&
+                      inflateSetDictionary(&stream_, dictionary_->data(), uInt(dictionary_->size())) == Z_OK)
+                         ? inflate(&stream_, Z_NO_FLUSH)
+                         : Z_DATA_ERROR;
+        }
+        getInput(in, inSize);
+        getOutput(out, outSize);
+
+        if (status == Z_STREAM_END)
+        {
+            return END;
+        }
+        return (status == Z_OK || status == Z_BUF_ERROR) ? OK : INVALID;
+    }
+
+    virtual bool reset() override
+    {
+        stream_.next_in  = Z_NULL;
+        stream_.avail_in = 0;
+        if (compress_)
+        {
+            // The level takes effect immediately because there is no data yet
+            level_    = pendingLevel_;
+            strategy_ = pendingStrategy_;
+            return deflateReset(&stream_) == Z_OK && deflateParams(&stream_, level_, strategy_) == Z_OK && prime();
+        }
+        return inflateReset(&stream_) == Z_OK && prime();
+    }
+
+    virtual size_t bound(size_t size) override
+    {
+        // deflateBound() takes a uLong, which may be too small. Beyond that, stored blocks (the worst case) add 5
+        // bytes to every 64K, plus the header and trailer.
+        if (size <= size_t(ULONG_MAX))
+        {
+            return size_t(deflateBound(&stream_, uLong(size)));
+        }
+        return size + (size >> 13) + 64;
+    }
+
+    virtual void set_level(int level) override { pendingLevel_ = clamp_level(type(), level); }
+
+    virtual void set_strategy(int strategy) override { pendingStrategy_ = strategy; }
+
+private:
+
+    // Primes zlib with the dictionary at the start of the data. A zlib decompressor is primed when the data asks for
+    // it (see decompress()).
+    bool prime()
+    {
+        if (!dictionary_)
+        {
+            return true;
+        }
+        uInt const size = uInt(dictionary_->size());
+        if (compress_)
+        {
+            return deflateSetDictionary(&stream_, dictionary_->data(), size) == Z_OK;
+        }
+        return type() != DEFLATE || inflateSetDictionary(&stream_, dictionary_->data(), size) == Z_OK;
+    }
+
+    // Points zlib at the output space (at most a uInt's worth)
+    void setOutput(char_type * out, size_t outSize)
+    {
+        stream_.next_out  = out;
+        stream_.avail_out = uInt(std::min(outSize, size_t(UINT_MAX)));
+    }
+
+    // Advances past the output produced by zlib
+    void getOutput(char_type * & out, size_t & outSize)
+    {
+        size_t const produced = size_t(stream_.next_out - out);
+        out     += produced;
+        outSize -= produced;
+    }
+
+    // Advances past the input consumed by zlib
+    void getInput(char_type const * & in, size_t & inSize)
+    {
+        size_t const consumed = size_t(stream_.next_in - in);
+        in     += consumed;
+        inSize -= consumed;
+    }
+
+    z_stream stream_;       // zlib state
+    bool compress_;         // True if compressing
+    bool initialized_;      // True if zlib was initialized
+    int level_;             // Current compression level
+    int pendingLevel_;      // Compression level of the data that follows
+    int strategy_;          // Current zlib strategy
+    int pendingStrategy_;   // zlib strategy of the data that follows
+    std::shared_ptr<zdictionary const> dictionary_; // Preset dictionary, or nullptr
+};
+
+#if defined(ZSTREAM_HAVE_ZSTD)
+
+// Compresses and decompresses zstd frames
+class ZstdCodec : public zcodec
+{
+public:
+    ZstdCodec(bool compress, Options const & options)
+        : zcodec(ZSTD)
+        , cctx_(nullptr)
+        , dctx_(nullptr)
+    {
+        if (compress)
+        {
+            cctx_ = ZSTD_createCCtx();
+            if (cctx_)
+            {
+                set_level(options.level);
+                ZSTD_CCtx_setParameter(cctx_, ZSTD_c_checksumFlag, options.checksum ? 1 : 0);
+                if (options.window > 0)
+                {
+                    ZSTD_CCtx_setParameter(cctx_, ZSTD_c_windowLog, options.window);
+                }
+
+                // zstd keeps a dictionary across frames
+                if (options.dictionary)
+                {
+                    ZSTD_CCtx_loadDictionary(cctx_, options.dictionary->data(), options.dictionary->size());
+                }
+            }
+        }
+        else
+        {
+            dctx_ = ZSTD_createDCtx();
+            if (dctx_ && options.window > 0)
+            {
+                ZSTD_DCtx_setParameter(dctx_, ZSTD_d_windowLogMax, options.window);
+            }
+            if (dctx_ && options.dictionary)
+            {
+                ZSTD_DCtx_loadDictionary(dctx_, options.dictionary->data(), options.dictionary->size());
+            }
+        }
+    }
+
+    virtual ~ZstdCodec() override
+    {
+        ZSTD_freeCCtx(cctx_);
+        ZSTD_freeDCtx(dctx_);
+    }
+
+    // Returns true if the context was created
+    bool initialized() const { return cctx_ != nullptr || dctx_ != nullptr; }
+
+    virtual Status compress(char_type const * & in,
+                            size_t &            inSize,
+                            char_type * &       out,
+                            size_t &            outSize,
+                            Flush               flush) override
+    {
+        ZSTD_inBuffer       input     = { in, inSize, 0 };
+        ZSTD_outBuffer      output    = { out, outSize, 0 };
+        ZSTD_EndDirective const mode  = (flush == FINISH)   ? ZSTD_e_end
+                                      : (flush == NO_FLUSH) ? ZSTD_e_continue
+                                                            : ZSTD_e_flush;
+
+        // A flush is complete when nothing remains to be written
+        size_t remaining;
+        do
+        {
+            remaining = ZSTD_compressStream2(cctx_, &output, &input, mode);
+            if (ZSTD_isError(remaining))
+            {
+                return INVALID;
+            }
+        }
+        while (output.pos < output.size &&
+               ((mode == ZSTD_e_continue) ? input.pos < input.size : remaining > 0));
+
+        in      += input.pos;
+        inSize  -= input.pos;
+        out     += output.pos;
+        outSize -= output.pos;
+        return (mode == ZSTD_e_end && remaining == 0) ? END : OK;
+    }
+
+    virtual Status decompress(char_type const * & in, size_t & inSize, char_type * & out, size_t & outSize) override
+    {
+        ZSTD_inBuffer  input  = { in, inSize, 0 };
+        ZSTD_outBuffer output = { out, outSize, 0 };
+
+        size_t const result = ZSTD_decompressStream(dctx_, &output, &input);
+        in      += input.pos;
+        inSize  -= input.pos;
+        out     += output.pos;
+        outSize -= output.pos;
+
+        if (ZSTD_isError(result))
+        {
+            return INVALID;
+        }
+        return (result == 0) ? END : OK;
+    }
+
+    virtual bool reset() override
+    {
+        size_t const result = cctx_ ? ZSTD_CCtx_reset(cctx_, ZSTD_reset_session_only)
+                                    : ZSTD_DCtx_reset(dctx_, ZSTD_reset_session_only);
+        return !ZSTD_isError(result);
+    }
+
+    virtual size_t bound(size_t size) override { return ZSTD_compressBound(size); }
+
+    // zstd applies the level at the next frame
+    virtual void set_level(int level) override
+    {
+        level = clamp_level(ZSTD, level);
+        ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, (level == DEFAULT_LEVEL) ? ZSTD_CLEVEL_DEFAULT : level);
+    }
+
+private:
+    ZSTD_CCtx * cctx_;  // Compression context (if compressing)
+    ZSTD_DCtx * dctx_;  // Decompression context (if decompressing)
+};
+
+#endif // defined(ZSTREAM_HAVE_ZSTD)
+
+#if defined(ZSTREAM_HAVE_LZ4)
+
+// Compresses and decompresses lz4 frames
+class Lz4Codec : public zcodec
+{
+public:
+    Lz4Codec(bool compress, Options const & options)
+        : zcodec(LZ4)
+        , cctx_(nullptr)
+        , dctx_(nullptr)
+        , pendingOffset_(0)
+        , pendingSize_(0)
+        , started_(false)
+        , ending_(false)
+        , done_(false)
+        , initialized_(false)
+    {
+        memset(&preferences_, 0, sizeof(preferences_));
+        preferences_.frameInfo.blockSizeID         = LZ4F_max64KB;
+        preferences_.frameInfo.blockMode           = LZ4F_blockLinked;
+        preferences_.frameInfo.contentChecksumFlag = options.checksum ? LZ4F_contentChecksumEnabled
+                                                                      : LZ4F_noContentChecksum;
+        set_level(options.level);
+
+        if (compress)
+        {
+            // lz4 needs room for a whole block of output, so the output is staged in a buffer of that size
+            initialized_ = !LZ4F_isError(LZ4F_createCompressionContext(&cctx_, LZ4F_VERSION));
+            pending_.resize(LZ4F_compressBound(BLOCK_SIZE, &preferences_) + HEADER_SIZE);
+        }
+        else
+        {
+            initialized_ = !LZ4F_isError(LZ4F_createDecompressionContext(&dctx_, LZ4F_VERSION));
+        }
+    }
+
+    virtual ~Lz4Codec() override
+    {
+        if (cctx_)
+        {
+            LZ4F_freeCompressionContext(cctx_);
+        }
+        if (dctx_)
+        {
+            LZ4F_freeDecompressionContext(dctx_);
+        }
+    }
+
+    // Returns true if the context was created
+    bool initialized() const { return initialized_; }
+
+    virtual Status compress(char_type const * & in,
+                            size_t &            inSize,
+                            char_type * &       out,
+                            size_t &            outSize,
+                            Flush               flush) override
+    {
+        for (;;)
+        {
+            // Hand over the output produced so far
+            size_t const size = std::min(outSize, pendingSize_ - pendingOffset_);
+            memcpy(out, pending_.data() + pendingOffset_, size);
+            out            += size;
+            outSize        -= size;
+            pendingOffset_ += size;
+            if (pendingOffset_ < pendingSize_)
+            {
+                return OK;
+            }
+            pendingOffset_ = 0;
+            pendingSize_   = 0;
+
+            if (ending_)
+            {
+                ending_ = false;
+                done_   = true;
+                return END;
+            }
+            if (done_ && inSize == 0)
+            {
+                return (flush == FINISH) ? END : OK;
+            }
+
+            size_t result;
+            if (!started_)
+            {
+                if (inSize == 0 && flush != FINISH)
+                {
+                    return OK;
+                }
+                result   = LZ4F_compressBegin(cctx_, pending_.data(), pending_.size(), &preferences_);
+                started_ = true;
+                done_    = false;
+            }
+            else if (inSize > 0)
+            {
+                size_t const n = std::min(inSize, size_t(BLOCK_SIZE));
+                result  = LZ4F_compressUpdate(cctx_, pending_.data(), pending_.size(), in, n, nullptr);
+                in     += n;
+                inSize -= n;
+            }
+            else if (flush == FINISH)
+            {
+                result   = LZ4F_compressEnd(cctx_, pending_.data(), pending_.size(), nullptr);
+                started_ = false;
+                ending_  = true;
+            }
+            else if (flush != NO_FLUSH)
+            {
+                result = LZ4F_flush(cctx_, pending_.data(), pending_.size(), nullptr);
+                if (result == 0)
+                {
+                    return OK;
+                }
+            }
+            else
+            {
+                return OK;
+            }
+
+            if (LZ4F_isError(result))
+            {
+                return INVALID;
+            }
+            pendingSize_ = result;
+        }
+    }
+
+    virtual Status decompress(char_type const * & in, size_t & inSize, char_type * & out, size_t & outSize) override
+    {
+        size_t consumed = inSize;
+        size_t produced = outSize;
+        size_t const result = LZ4F_decompress(dctx_, out, &produced, in, &consumed, nullptr);
+        in      += consumed;
+        inSize  -= consumed;
+        out     += produced;
+        outSize -= produced;
+
+        if (LZ4F_isError(result))
+        {
+            return INVALID;
+        }
+        return (result == 0) ? END : OK;
+    }
+
+    virtual bool reset() override
+    {
+        if (dctx_)
+        {
+            LZ4F_resetDecompressionContext(dctx_);
+        }
+        pendingOffset_ = 0;
+        pendingSize_   = 0;
+        started_       = false;
+        ending_        = false;
+        done_          = false;
+        return true;
+    }
+
+    virtual size_t bound(size_t size) override { return LZ4F_compressBound(size, &preferences_) + HEADER_SIZE; }
+
+    // lz4 applies the level at the next frame
+    virtual void set_level(int level) override
+    {
+        level = clamp_level(LZ4, level);
+        preferences_.compressionLevel = (level == DEFAULT_LEVEL) ? 0 : level;
+    }
+
+private:
+    enum
+    {
+        BLOCK_SIZE  = 64 * 1024,    // Amount of input compressed at a time (the block size of the frames)
+        HEADER_SIZE = 19            // Largest frame header (LZ4F_HEADER_SIZE_MAX)
+    };
+
+    LZ4F_cctx * cctx_;                  // Compression context (if compressing)
+    LZ4F_dctx * dctx_;                  // Decompression context (if decompressing)
+    LZ4F_preferences_t preferences_;    // Settings of the next frame
+    std::vector<char_type> pending_;    // Compressed data not yet handed over
+    size_t pendingOffset_;              // Amount of pending_ handed over
+    size_t pendingSize_;                // Amount of data in pending_
+    bool started_;                      // True if a frame has been started
+    bool ending_;                       // True if the end of the frame is in pending_
+    bool done_;                         // True if the frame has been ended and no data has been given since
+    bool initialized_;                  // True if the context was created
+};
+
+#endif // defined(ZSTREAM_HAVE_LZ4)
+
+} // anonymous namespace
+
+//! @param	type        Format (not AUTO)
+//! @param	compress    True to compress, false to decompress
+//! @param	options     Settings
+//! @param	resource    Memory resource that provides the zlib state
+
+std::unique_ptr<zcodec> zcodec::create(Type                        type,
+                                       bool                        compress,
+                                       Options const &             options /* = Options()*/,
+                                       std::pmr::memory_resource * resource /* = nullptr*/)
+{
+    Options settings = options;
+    settings.level = clamp_level(type, options.level);
+
+    // gzip and lz4 data cannot use a dictionary
+    if (options.dictionary && (type == GZIP || type == LZ4))
+    {
+        return nullptr;
+    }
+
+    switch (type)
+    {
+        case GZIP:
+        case ZLIB:
+        case DEFLATE:
+        {
+            std::unique_ptr<ZlibCodec> codec(new ZlibCodec(type, compress, settings, resource));
+            return codec->initialized() ? std::move(codec) : nullptr;
+        }
+#if defined(ZSTREAM_HAVE_ZSTD)
+        case ZSTD:
+        {
+            std::unique_ptr<ZstdCodec> codec(new ZstdCodec(compress, settings));
+            return codec->initialized() ? std::move(codec) : nullptr;
+        }
+#endif
+#if defined(ZSTREAM_HAVE_LZ4)
+        case LZ4:
+        {
+            std::unique_ptr<Lz4Codec> codec(new Lz4Codec(compress, settings));
+            return codec->initialized() ? std::move(codec) : nullptr;
+        }
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+//!
+//! @param	type	Format
+
+bool zcodec::available(Type type)
+{
+    switch (type)
+    {
+        case AUTO:
+        case GZIP:
+        case ZLIB:
+        case DEFLATE:
+            return true;
+#if defined(ZSTREAM_HAVE_ZSTD)
+        case ZSTD:
+            return true;
+#endif
+#if defined(ZSTREAM_HAVE_LZ4)
+        case LZ4:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+//! @param	data	Compressed data
+//! @param	size	Size of the data (only the first 4 bytes are examined)
+//!
+//! @note	Raw deflate data has no header, so it is never detected.
+
+zcodec::Type zcodec::detect(char_type const * data, size_t size)
+{
+    if (size >= 2 && data[0] == 0x1f && data[1] == 0x8b)
+    {
+        return GZIP;
+    }
+    if (size >= 4 && data[0] == 0x28 && data[1] == 0xb5 && data[2] == 0x2f && data[3] == 0xfd)
+    {
+        return ZSTD;
+    }
+    if (size >= 4 && data[0] == 0x04 && data[1] == 0x22 && data[2] == 0x4d && data[3] == 0x18)
+    {
+        return LZ4;
+    }
+
+    // A zlib header specifies deflate with a window of at most 32K, and is a multiple of 31
+    if (size >= 2 && (data[0] & 0x0f) == Z_DEFLATED && (data[0] >> 4) <= 7 && ((data[0] << 8) | data[1]) % 31 == 0)
+    {
+        return ZLIB;
+    }
+    return AUTO;
+}
+
+//!
+//! @param	name	Name of the file
+
+zcodec::Type zcodec::detect(char const * name)
+{
+    FILE * file = fopen(name, "rb");
+    if (!file)
+    {
+        return AUTO;
+    }
+
+    char_type magic[4];
+    size_t const size = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+    return detect(magic, size);
+}
+
+//! @param	data	Compressed data
+//! @param	size	Size of the data
+//!
+//! @note	For gzip, the size is taken from the trailer, so it is the size of the last member modulo 2^32. It should
+//!         only be used as an estimate. For zstd and lz4, it is the size recorded in the first frame, if any.
+
+size_t zcodec::content_size(char_type const * data, size_t size)
+{
+    switch (detect(data, size))
+    {
+        case GZIP:
+        {
+            // The last 4 bytes are ISIZE
+            if (size < 18)
+            {
+                return 0;
+            }
+            char_type const * trailer = data + size - 4;
+            return size_t(trailer[0]) | (size_t(trailer[1]) << 8) | (size_t(trailer[2]) << 16) |
+                   (size_t(trailer[3]) << 24);
+        }
+#if defined(ZSTREAM_HAVE_ZSTD)
+        case ZSTD:
+        {
+            unsigned long long const n = ZSTD_getFrameContentSize(data, size);
+            return (n == ZSTD_CONTENTSIZE_UNKNOWN || n == ZSTD_CONTENTSIZE_ERROR || n > SIZE_MAX) ? 0 : size_t(n);
+        }
+#endif
+        case LZ4:
+        {
+            // If bit 3 of the FLG byte is set, the content size follows the FLG and BD bytes
+            if (size < 14 || (data[4] & 0x08) == 0)
+            {
+                return 0;
+            }
+            unsigned long long n = 0;
+            for (int i = 7; i >= 0; --i)
+            {
+                n = (n << 8) | data[6 + i];
+            }
+            return (n > SIZE_MAX) ? 0 : size_t(n);
+        }
+        default:
+            return 0;
+    }
+}
+
+//! @param	type	Format
+//! @param	level	Compression level
+
+int zcodec::clamp_level(Type type, int level)
+{
+    if (level == DEFAULT_LEVEL)
+    {
+        return level;
+    }
+
+    int const highest = (type == ZSTD) ? MAX_ZSTD_LEVEL
+                      : (type == LZ4)  ? MAX_LZ4_LEVEL
+                                       : MAX_ZLIB_LEVEL;
+    int const lowest  = (type == ZSTD) ? 1 : 0;
+    return std::min(std::max(level, lowest), highest);
+}
@@ -0,0 +1,183 @@
+/** @file *//********************************************************************************************************
+
+                                                   zdeflater.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zdeflater.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zdeflater.h"
+
+#include <algorithm>
+
+namespace
+{
+
+// Size of the buffer receiving compressed data
+size_t const OUTPUT_SIZE = 64 * 1024;
+
+} // anonymous namespace
+
+//!
+//! @param	resource	Memory resource that provides the zlib state, or nullptr to use the default allocation
+
+zdeflater::zdeflater(std::pmr::memory_resource * resource /* = nullptr*/)
+    : resource_(resource)
+    , written_(0)
+    , error_(false)
+{
+}
+
+zdeflater::~zdeflater()
+{
+    close();
+}
+
+//! @param	name	Name of the file
+//! @param	type	Format of the file (AUTO means gzip)
+//! @param	options	Settings of the compressor, including the level
+
+bool zdeflater::open(char const * name, zcodec::Type type, zcodec::Options const & options)
+{
+    if (is_open())
+    {
+        return false;
+    }
+
+    // The codec writes the header and trailer
+    codec_ = zcodec::create((type == zcodec::AUTO) ? zcodec::GZIP : type, true, options, resource_);
+    if (!codec_)
+    {
+        return false;
+    }
+
+    if (!file_.open(name, true))
+    {
+        codec_.reset();
+        return false;
+    }
+
+    output_.resize(OUTPUT_SIZE);
+    written_ = 0;
+    error_   = false;
+    return true;
+}
+
+bool zdeflater::close()
+{
+    if (!is_open())
+    {
+        return false;
+    }
+
+    bool ok = compress(nullptr, 0, zcodec::FINISH);
+    codec_.reset();
+    ok = file_.close() && ok;
+    return ok;
+}
+
+//! @param	s   Uncompressed data
+//! @param	n   Number of characters
+
+bool zdeflater::write(char_type const * s, size_t n)
+{
+    if (!is_open())
+    {
+        return false;
+    }
+
+    written_ += n;
+    return compress(s, n, zcodec::NO_FLUSH);
+}
+
+//! @param	flush	Flush mode (PARTIAL_FLUSH, SYNC_FLUSH, or FULL_FLUSH)
+//!
+//! @note	The compressed data is brought to a point where everything written so far can be decompressed by a reader of
+//!         the file.
+
+bool zdeflater::flush(zcodec::Flush flush /* = zcodec::SYNC_FLUSH*/)
+{
+    if (!is_open())
+    {
+        return false;
+    }
+
+    return compress(nullptr, 0, flush) && file_.flush();
+}
+
+//!
+//! @param	level	Compression level. For zlib, 0 is no compression and 9 is maximum compression.
+//!
+//! @note	zlib applies the level at the next block, and the other codecs at the next frame.
+
+bool zdeflater::set_compression(int level)
+{
+    if (!is_open() || error_)
+    {
+        return false;
+    }
+
+    codec_->set_level(level);
+    return true;
+}
+
+//!
+//! @param	strategy	zlib strategy (for example, Z_FILTERED). The other codecs ignore it.
+//!
+//! @note	zlib applies the strategy at the next block.
+
+bool zdeflater::set_strategy(int strategy)
+{
+    if (!is_open() || error_)
+    {
+        return false;
+    }
+
+    codec_->set_strategy(strategy);
+    return true;
+}
+
+//! @param	s       Uncompressed data
+//! @param	n       Number of characters
+//! @param	flush   Flush mode
+
+bool zdeflater::compress(char_type const * s, size_t n, zcodec::Flush flush)
+{
+    if (error_)
+    {
+        return false;
+    }
+
+    // Continue until all the input has been consumed and the codec has no more output for this flush mode
+    for (;;)
+    {
+        char_type *          out    = output_.data();
+        size_t               space  = output_.size();
+        zcodec::Status const status = codec_->compress(s, n, out, space, flush);
+        if (status == zcodec::INVALID)
+        {
+            error_ = true;
+            return false;
+        }
+
+        // The file is written by another thread while the next output is compressed
+        size_t const size = output_.size() - space;
+        if (size > 0 && !file_.write(output_.data(), size))
+        {
+            error_ = true;
+            return false;
+        }
+
+        if (status == zcodec::END || (n == 0 && space > 0))
+        {
+            break;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,255 @@
+/** @file *//********************************************************************************************************
+
+                                                  zdictionary.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zdictionary.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zdictionary.h"
+
+#include "zlib/zlib.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+// Length of the strings whose frequency the trainer counts
+size_t const DMER_SIZE = 8;
+
+// Marks a position where no string starts (too close to the end of its sample)
+uint64_t const NO_DMER = 0;
+
+// A piece of the samples chosen for a dictionary
+struct Segment
+{
+    size_t offset;  // Offset in the samples
+    uint64_t score; // Sum of the frequencies of the distinct strings in it
+};
+
+// Returns the string of DMER_SIZE bytes at p as a key. The bytes are the key, so different strings never collide.
+// NO_DMER is a string of zeros, which is then never counted, and that only costs a little ratio on such data.
+uint64_t dmer(zdictionary::char_type const * p)
+{
+    uint64_t key;
+    memcpy(&key, p, sizeof(key));
+    return key;
+}
+
+} // anonymous namespace
+
+//! @param	data	Contents
+//! @param	size	Size of the contents
+
+zdictionary::zdictionary(char_type const * data, size_t size)
+    : data_(data, data + size)
+    , id_(adler32(0L, Z_NULL, 0))
+{
+    // adler32() takes a uInt, so a large dictionary is checksummed in pieces
+    while (size > 0)
+    {
+        uInt const n = uInt(std::min(size, size_t(UINT_MAX)));
+        id_   = adler32(id_, data, n);
+        data += n;
+        size -= n;
+    }
+}
+
+//!
+//! @param	name	Name of the file
+
+bool zdictionary::save(char const * name) const
+{
+    FILE * file = fopen(name, "wb");
+    if (!file)
+    {
+        return false;
+    }
+
+    bool const ok = fwrite(data_.data(), 1, data_.size(), file) == data_.size();
+    return (fclose(file) == 0) && ok;
+}
+
+//!
+//! @param	name	Name of the file
+
+std::shared_ptr<zdictionary const> zdictionary::load(char const * name)
+{
+    FILE * file = fopen(name, "rb");
+    if (!file)
+    {
+        return nullptr;
+    }
+
+    std::vector<char_type> data;
+    char_type buffer[64 * 1024];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    bool const ok = !ferror(file);
+    fclose(file);
+
+    return ok ? std::make_shared<zdictionary const>(data.data(), data.size()) : nullptr;
+}
+
+//! @param	samples	The samples, one after the other. They should be representative of the messages, and there should
+//!                 be enough of them to fill the dictionary many times over.
+//! @param	sizes	Size of each sample
+//! @param	size	Size of the dictionary. deflate only uses MAX_DEFLATE_SIZE bytes. A smaller dictionary is faster
+//!                 to set up for each message.
+//! @param	segment	Length of the pieces of the samples that the dictionary is made of
+//!
+//! @return	The dictionary, which is smaller than @p size if the samples do not have enough strings in common
+//!
+//! The strings of the samples are counted by the number of samples that contain them. The samples are then divided
+//! into as many ranges as there are segments in the dictionary, and the segment in each range that contains the
+//! most valuable strings not chosen yet is chosen. This is the "cover" algorithm of zstd's dictionary builder. The
+//! segments are ordered so that the most valuable ones are at the end of the dictionary, nearest the data.
+
+std::shared_ptr<zdictionary const> zdictionary::train(char_type const *           samples,
+                                                      std::vector<size_t> const & sizes,
+                                                      size_t                      size /* = DEFAULT_SIZE*/,
+                                                      size_t                      segment /* = DEFAULT_SEGMENT*/)
+{
+    segment = std::max(segment, DMER_SIZE);
+
+    // Find the string that starts at each position, and count the samples containing each one
+    size_t total = 0;
+    for (size_t n : sizes)
+    {
+        total += n;
+    }
+    std::vector<uint64_t> dmers(total, NO_DMER);
+    std::unordered_map<uint64_t, uint64_t> frequencies;
+    {
+        std::vector<uint64_t> distinct;
+        size_t offset = 0;
+        for (size_t n : sizes)
+        {
+            distinct.clear();
+            for (size_t i = 0; i + DMER_SIZE <= n; ++i)
+            {
+                dmers[offset + i] = dmer(samples + offset + i);
+                distinct.push_back(dmers[offset + i]);
+            }
+            std::sort(distinct.begin(), distinct.end());
+            distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+            for (uint64_t key : distinct)
+            {
+                ++frequencies[key];
+            }
+            offset += n;
+        }
+    }
+
+    // A string that appears in only one sample is not worth including
+    for (auto & entry : frequencies)
+    {
+        if (entry.second < 2)
+        {
+            entry.second = 0;
+        }
+    }
+    frequencies.erase(NO_DMER);
+
+    auto weight = [&frequencies] (uint64_t key) -> uint64_t {
+        auto f = frequencies.find(key);
+        return (f != frequencies.end()) ? f->second : 0;
+    };
+
+    // Choose the best segment in each range
+    size_t const count = std::max(size / segment, size_t(1));
+    size_t const range = std::max(total / count, segment);
+    std::vector<Segment> chosen;
+    std::unordered_map<uint64_t, unsigned> active;
+    for (size_t begin = 0; begin + segment <= total; begin += range)
+    {
+        size_t const end = std::min(begin + range, total);
+
+        // Slide a window over the range, keeping the score of the distinct strings in it
+        active.clear();
+        uint64_t score = 0;
+        Segment best   = { begin, 0 };
+        size_t const last = segment - DMER_SIZE;  // Offset of the last string in the window
+        for (size_t i = begin; i + DMER_SIZE <= end; ++i)
+        {
+            if (dmers[i] != NO_DMER && active[dmers[i]]++ == 0)
+            {
+                score += weight(dmers[i]);
+            }
+            if (i >= begin + last + 1)
+            {
+                uint64_t const leaving = dmers[i - last - 1];
+                if (leaving != NO_DMER && --active[leaving] == 0)
+                {
+                    score -= weight(leaving);
+                }
+            }
+            if (i >= begin + last && score > best.score)
+            {
+                best.offset = i - last;
+                best.score  = score;
+            }
+        }
+
+        if (best.score == 0)
+        {
+            continue;
+        }
+
+        // The strings in the segment are covered, so they are not counted again
+        for (size_t i = best.offset; i <= best.offset + last; ++i)
+        {
+            auto f = frequencies.find(dmers[i]);
+            if (f != frequencies.end())
+            {
+                f->second = 0;
+            }
+        }
+        chosen.push_back(best);
+    }
+
+    // The most valuable segments go last. If there are more than fit, the least valuable are dropped.
+    std::stable_sort(chosen.begin(), chosen.end(), [] (Segment const & a, Segment const & b) {
+        return a.score > b.score;
+    });
+    if (chosen.size() > count)
+    {
+        chosen.resize(count);
+    }
+    std::vector<char_type> data;
+    data.reserve(chosen.size() * segment);
+    for (auto s = chosen.rbegin(); s != chosen.rend(); ++s)
+    {
+        data.insert(data.end(), samples + s->offset, samples + s->offset + segment);
+    }
+
+    return std::make_shared<zdictionary const>(data.data(), data.size());
+}
+
+//! @param	data	Compressed data in the zlib format
+//! @param	size	Size of the data (only the first 6 bytes are examined)
+
+unsigned long zdictionary::required(char_type const * data, size_t size)
+{
+    // The zlib header has the FDICT flag, followed by the ID of the dictionary in big-endian order
+    if (size < 6 || (data[0] & 0x0f) != Z_DEFLATED || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20) == 0)
+    {
+        return 0;
+    }
+    return (unsigned long)((uint32_t(data[2]) << 24) | (uint32_t(data[3]) << 16) | (uint32_t(data[4]) << 8) | data[5]);
+}
@@ -13,45 +13,102 @@
 
 #include "zfilebuf.h"
 
+#include "zbytes.h"
+#include "zdeflater.h"
+#include "zflushtimer.h"
+#include "zindex.h"
+#include "zinflater.h"
+#include "zmembers.h"
+#include "zparallel.h"
+#include "zreadahead.h"
+#include "zspeculative.h"
+#include "zstatsmacros.h"
 #include "zlib/zlib.h"
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include <fstream>
 #include <streambuf>
 
 //!
 //! @param  file
-zfilebuf::zfilebuf(gzFile file /* = nullptr*/)
+template <class CharT, class Traits>
+basic_zfilebuf<CharT, Traits>::basic_zfilebuf(gzFile file /* = nullptr*/)
     : base_type()
+    , buffer_(nullptr)
+    , bufferSize_(DEFAULT_BUFFER_SIZE)
+    , needsClose_(false)
+    , file_(nullptr)
+    , threads_(1)
+    , level_(Z_DEFAULT_COMPRESSION)
+    , resource_(nullptr)
+    , mapped_(false)
+    , async_(false)
+    , readAhead_(false)
+    , speculate_(false)
+    , codec_(zcodec::AUTO)
+    , adaptive_(false)
+    , skipIncompressible_(false)
+    , probing_(false)
+    , storing_(false)
+    , unflushed_(0)
+    , held_(0)
+    , runningChecksum_(false)
+    , compressedStart_(0)
 {
-    if (file)
-    {
-        initialize(file, NEW);
-    }
+    initialize(file, NEW);
 }
 
-zfilebuf::~zfilebuf()
+template <class CharT, class Traits>
+basic_zfilebuf<CharT, Traits>::~basic_zfilebuf()
 {
     if (needsClose_)
     {
         close();
     }
+
+    // Otherwise, the file belongs to someone else, but the buffered output must still be written to it
+    else if (is_open() && base_type::pbase() != nullptr)
+    {
+        flushBuffer();
+    }
 }
 
 //!
 //! @param	level	Compression level. 0 is no compression, 9 is maximum compression.
 
-void zfilebuf::set_compression(int level)
+template <class CharT, class Traits>
+void basic_zfilebuf<CharT, Traits>::set_compression(int level)
 {
-    if (level < 0)
+    level = zcodec::clamp_level((codec_ == zcodec::AUTO) ? zcodec::GZIP : codec_, level);
+
+    level_              = level;
+    codecOptions_.level = level;
+
+    std::unique_lock<std::recursive_mutex> lock = lockOutput();
+
+    // The new level applies even if the output is being stored. The next write is judged again.
+    storing_ = false;
+
+    // Buffered output is compressed with the old level
+    if (base_type::pbase() != nullptr)
+    {
+        flushBuffer();
+    }
+
+    if (parallel_)
     {
-        level = 0;
+        parallel_->set_compression(level);
     }
-    else if (level > 9)
+    else if (writer_)
     {
-        level = 9;
+        writer_->set_compression(level);
+    }
+    else if (file_)
+    {
+        gzsetparams(file_, level, Z_DEFAULT_STRATEGY);
     }
-
-    gzsetparams(file_, level, Z_DEFAULT_STRATEGY);
 }
 
 //! @param	name	Name of the file to open.
@@ -59,279 +116,757 @@ void zfilebuf::set_compression(int level)
 //!					others are ignored. <tt>std::ios_base::binary</tt> is assumed. If no mode is specified,
 //!					<tt>std::ios_base::in</tt> is assumed.
 
-zfilebuf * zfilebuf::open(char const * name, std::ios_base::openmode mode)
+template <class CharT, class Traits>
+basic_zfilebuf<CharT, Traits> *
+basic_zfilebuf<CharT, Traits>::open(char const * name, std::ios_base::openmode mode)
 {
-    gzFile file;
-    char const * const modeString = ((mode & std::ios_base::out) != 0) ? "wb" : "rb";
+    if (is_open())
+    {
+        return 0;
+    }
+
+    // Files in other formats, or with settings that gzopen() does not support, are written by zdeflater
+    zcodec::Type const type   = (codec_ == zcodec::AUTO) ? zcodec::GZIP : codec_;
+    bool const         custom = (type != zcodec::GZIP || codecOptions_.window != 0 || codecOptions_.strategy != 0);
 
-    if (file_ != 0 || (file = gzopen(name, modeString)) == NULL)
+    // If compressing with threads, the parallel compressor writes the file instead of zlib
+    if ((mode & std::ios_base::out) != 0 && threads_ != 1 && !custom)
+    {
+        FILE * file = fopen(name, "wb");
+        if (!file)
+        {
+            return 0;
+        }
+
+        parallel_.reset(new zparallel(file, level_, threads_, zparallel::DEFAULT_BLOCK_SIZE, resource_));
+        initialize(nullptr, OPENED);
+        startTimer();
+        return this;
+    }
+
+    // If writing asynchronously, zdeflater compresses the data while its worker writes the file
+    if ((mode & std::ios_base::out) != 0 && (async_ || custom))
+    {
+        zcodec::Options options = codecOptions_;
+        options.level = level_;
+
+        std::unique_ptr<zdeflater> writer(new zdeflater(resource_));
+        if (!writer->open(name, type, options))
+        {
+            return 0;
+        }
+
+        writer_ = std::move(writer);
+        initialize(nullptr, OPENED);
+        startTimer();
+        startAdaptive(type);
+        return this;
+    }
+
+    // If reading a file that has an index, or is to be mapped or read asynchronously, zinflater reads the file
+    // instead of zlib
+    if ((mode & std::ios_base::out) == 0)
+    {
+        zinflater::Input const input = mapped_ ? zinflater::MAPPED_INPUT
+                                     : async_  ? zinflater::ASYNC_INPUT
+                                               : zinflater::READ_INPUT;
+
+        // Files in other specified formats are decompressed by zinflater. If the format is not available, the file
+        // cannot be read.
+        if (codec_ != zcodec::AUTO && codec_ != zcodec::GZIP)
+        {
+            std::unique_ptr<zinflater> reader(new zinflater(resource_));
+            if (!reader->open(name, input, codec_))
+            {
+                return 0;
+            }
+
+            reader_ = std::move(reader);
+            initialize(nullptr, OPENED);
+            startReadAhead();
+            return this;
+        }
+
+        std::shared_ptr<zindex> index(new zindex);
+        if (!index->load(zindex::sidecar(name).c_str()))
+        {
+            index.reset();
+        }
+
+        // If decompressing with threads and speculation is enabled, each chunk of the compressed data is decompressed
+        // concurrently from a guessed block boundary, so even a file with a single member is decompressed in
+        // parallel. An index takes precedence because seeking with it is much faster.
+        if (!index && threads_ != 1 && speculate_)
+        {
+            std::unique_ptr<zspeculative> speculative(new zspeculative(threads_));
+            if (speculative->open(name))
+            {
+                speculative_ = std::move(speculative);
+                initialize(nullptr, OPENED);
+                startReadAhead();
+                return this;
+            }
+        }
+
+        // Otherwise, if decompressing with threads, the members of the file are decompressed concurrently. An index
+        // takes precedence here too.
+        if (!index && threads_ != 1)
+        {
+            std::unique_ptr<zmembers> members(new zmembers(threads_, zmembers::DEFAULT_MAX_MEMBER_SIZE, resource_));
+            if (members->open(name))
+            {
+                members_ = std::move(members);
+                initialize(nullptr, OPENED);
+                startReadAhead();
+                return this;
+            }
+        }
+
+        if (index || mapped_ || async_)
+        {
+            // zinflater also detects a zstd or lz4 file. If the file could not be opened this way (for example, it is
+            // not a gzip file), zlib reads it.
+            std::unique_ptr<zinflater> reader(new zinflater(resource_));
+            if (reader->open(name, input, codec_))
+            {
+                // An index that does not match the file is ignored
+                if (index && !reader->set_index(index))
+                {
+                    index.reset();
+                }
+
+                if (index || input != zinflater::READ_INPUT)
+                {
+                    reader_ = std::move(reader);
+                    initialize(nullptr, OPENED);
+                    startReadAhead();
+                    return this;
+                }
+            }
+        }
+    }
+
+    char modeString[] = "rb\0";
+    if ((mode & std::ios_base::out) != 0)
+    {
+        modeString[0] = 'w';
+        if (level_ != Z_DEFAULT_COMPRESSION)
+        {
+            modeString[2] = char('0' + level_);
+        }
+    }
+
+    gzFile file = gzopen(name, modeString);
+    if (file == NULL)
     {
         return 0;
     }
 
+    // zlib passes through a file that is not a gzip file, so one in a format that zinflater decompresses is given
+    // to zinflater instead. The format is detected with the handle that is already open, and only if it is not gzip.
+    if ((mode & std::ios_base::out) == 0 && codec_ == zcodec::AUTO && gzdirect(file))
+    {
+        zcodec::char_type magic[4];
+        int const          size = gzread(file, magic, sizeof(magic));
+        zcodec::Type const type = zcodec::detect(magic, size_t(std::max(size, 0)));
+        if (type == zcodec::ZSTD || type == zcodec::LZ4)
+        {
+            gzclose(file);
+
+            // If the format is not available, the file cannot be read
+            std::unique_ptr<zinflater> reader(new zinflater(resource_));
+            if (!reader->open(name, zinflater::READ_INPUT, type))
+            {
+                return 0;
+            }
+
+            reader_ = std::move(reader);
+            initialize(nullptr, OPENED);
+            startReadAhead();
+            return this;
+        }
+        gzrewind(file);
+    }
+
     initialize(file, OPENED);
+    if ((mode & std::ios_base::out) == 0)
+    {
+        startReadAhead();
+    }
+    else
+    {
+        startTimer();
+        startAdaptive(zcodec::GZIP);
+    }
 
     return this;
 }
 
-zfilebuf * zfilebuf::close()
+//! @note   Any buffered output is written to the file before it is closed.
+
+template <class CharT, class Traits>
+basic_zfilebuf<CharT, Traits> *
+basic_zfilebuf<CharT, Traits>::close()
 {
-    if (!file_ || gzclose(file_) != 0)
+    if (!is_open())
     {
         return 0;
     }
 
+    bool ok = (base_type::pbase() == nullptr) || flushBuffer();
+
+    // The helpers must stop using the file before it is closed
+    ahead_.reset();
+    timer_.reset();
+    controller_.reset();
+    probing_ = false;
+    storing_ = false;
+
+    // The file is gone after closing even if it fails
+    if (parallel_)
+    {
+        ok = parallel_->close() && ok;
+        countCompressed();
+        parallel_.reset();
+    }
+    else if (writer_)
+    {
+        ok = writer_->close() && ok;
+        countCompressed();
+        writer_.reset();
+    }
+    else if (reader_)
+    {
+        countCompressed();
+        ok = reader_->close() && ok;
+        reader_.reset();
+    }
+    else if (members_)
+    {
+        countCompressed();
+        ok = members_->close() && ok;
+        members_.reset();
+    }
+    else if (speculative_)
+    {
+        countCompressed();
+        ok = speculative_->close() && ok;
+        speculative_.reset();
+    }
+    else
+    {
+        countCompressed();
+        ok = (gzclose(file_) == 0) && ok;
+    }
+
     initialize(0, CLOSED);
 
-    return this;
+    return ok ? this : 0;
 }
 
 //! @param	meta	Value to insert
 //!
 //! @return     The character or <tt>traits_type::eof()</tt> if it failed.
 
-zfilebuf::int_type zfilebuf::overflow(int_type meta /* = traits_type::eof()*/)
+template <class CharT, class Traits>
+typename basic_zfilebuf<CharT, Traits>::int_type
+basic_zfilebuf<CharT, Traits>::overflow(int_type meta /* = traits_type::eof()*/)
 {
-    // If inserting EOF, then do nothing and return success
+    // If inserting EOF, then just write the buffered output and return success
     if (meta == traits_type::eof())
     {
+        if (is_open() && base_type::pbase() != nullptr && !flushBuffer())
+        {
+            return traits_type::eof();
+        }
         return traits_type::not_eof(meta);
     }
 
-    // Otherwise, if the file is not open, return error
-
-    if (!file_)
+    // Otherwise, if the file is not open or it is being read, return error
+    if (!is_open() || base_type::gptr() != nullptr)
     {
         return traits_type::eof();
     }
 
-    // Otherwise, write a byte to the file
-    return (gzputc(file_, meta) != -1) ? meta : traits_type::eof();
-}
-
-//! @param	meta	Value to put back. If it is <tt>traits_type::eof()</tt>, then put back the value that was read
-//!					last (if possible).
-//! @return the character or <tt>traits_type::eof()</tt> if it failed.
-
-zfilebuf::int_type zfilebuf::pbackfail(int_type meta /* = traits_type::eof()*/)
-{
-    // If there is a input buffer and there is data before the current position, and meta is EOF or the same as
-    // the previous character in the input buffer, just back up the current position
-    if (base_type::gptr() != 0 && base_type::eback() < base_type::gptr() &&
-        (meta == traits_type::eof() || int_type(base_type::gptr() [-1]) == meta))
+    // Otherwise, if there is a flush timer, the character is held in the I/O buffer
+    if (timer_)
     {
-        base_type::_Gndec();
-        return traits_type::not_eof(meta);
+        char_type const c = traits_type::to_char_type(meta);
+        return hold(&c, 1) ? meta : traits_type::eof();
     }
 
-    // Otherwise, if the file isn't open or a EOF is put back return error.
-    else if (!file_ || meta == traits_type::eof())
+    // Otherwise, write the contents of the put area to the file to make room
+    if (!flushBuffer())
     {
         return traits_type::eof();
     }
 
-    // Otherwise, put the data in the putback buffer
-    else
-    {
-        putback_ = char_type(meta);
-        base_type::setg(&putback_, &putback_, &putback_ + 1);
+    *base_type::pptr() = traits_type::to_char_type(meta);
+    base_type::pbump(1);
 
-        return meta;
-    }
+    return meta;
 }
 
-zfilebuf::int_type zfilebuf::underflow()
-{
-    int_type meta;
+//! @param	meta	Value to put back. If it is <tt>traits_type::eof()</tt>, then put back the value that was read
+//!					last (if possible).
+//! @return the character or <tt>traits_type::eof()</tt> if it failed.
 
-    // If there is data in the input buffer, get it without incrementing the pointer
-    if (base_type::gptr() != 0 && base_type::gptr() < base_type::egptr())
+template <class CharT, class Traits>
+typename basic_zfilebuf<CharT, Traits>::int_type
+basic_zfilebuf<CharT, Traits>::pbackfail(int_type meta /* = traits_type::eof()*/)
+{
+    // If there is no data before the current position, then nothing can be put back
+    if (base_type::gptr() == nullptr || base_type::gptr() <= base_type::eback())
     {
-        meta = int_type(*base_type::gptr());
+        return traits_type::eof();
     }
 
-    // Otherwise, get a byte from the file
-    else
+    // If meta is EOF or the same as the previous character in the input buffer, just back up the current position
+    if (meta == traits_type::eof() || traits_type::to_int_type(base_type::gptr()[-1]) == meta)
     {
-        meta = uflow();
-
-        // If it did not fail, the put the byte back
-        if (meta != traits_type::eof())
-        {
-            pbackfail(meta);
-        }
+        base_type::gbump(-1);
+        return traits_type::not_eof(meta);
     }
 
+    // Otherwise, replace the previous character (the get area is always in our own buffer)
+    base_type::gbump(-1);
+    *base_type::gptr() = traits_type::to_char_type(meta);
     return meta;
 }
 
-zfilebuf::int_type zfilebuf::uflow()
+template <class CharT, class Traits>
+typename basic_zfilebuf<CharT, Traits>::int_type
+basic_zfilebuf<CharT, Traits>::underflow()
 {
-    int_type meta;
-
-    // If there is data in the input buffer, return it.
-    if (base_type::gptr() != 0 && base_type::gptr() < base_type::egptr())
-    {
-        meta = int_type(*base_type::_Gninc());
-    }
-
-    // Otherwise, if no file is open, return error
-    else if (!file_)
-    {
-        meta = traits_type::eof();
-    }
-
-    // Otherwise, get a byte from the file
-    else
+    // If there is data in the input buffer, get it without incrementing the pointer. Otherwise, refill the buffer
+    // from the file.
+    if (base_type::gptr() < base_type::egptr() || fill())
     {
-        int const _Ch = gzgetc(file_);
-        meta = (_Ch != -1) ? (int_type)_Ch : traits_type::eof();
+        return traits_type::to_int_type(*base_type::gptr());
     }
 
-    return meta;
+    return traits_type::eof();
 }
 
 //! @param	off		    Number of uncompressed bytes to move the pointer
-//! @param	way		    Location to start seek. <tt>std::ios_base::end</tt> is not supported. Valid values are:
+//! @param	way		    Location to start seek. Valid values are:
 //!							- <tt>std::ios_base::beg</tt>
 //!							- <tt>std::ios_base::cur</tt>
+//!							- <tt>std::ios_base::end</tt> (only if the file has an index)
 //! @param	openmode    Ignored (both in and out pointers are moved)
 //!
 //! @note	There are restrictions imposed by @c zlib:
-//!				-#	<tt>std::ios_base::end</tt> is not supported as a start location
+//!				-#	<tt>std::ios_base::end</tt> is only supported as a start location if the file has an index
 //!				-#	Only forward seeks are allowed in output buffers
-
-zfilebuf::pos_type zfilebuf::seekoff(off_type                off,
-                                     std::ios_base::seekdir  way,
-                                     std::ios_base::openmode openmode /*= (std::ios_base::openmode)
-                                                                         (std::ios_base::in|std::ios_base::out)*/)
+//!
+//! @note	Without an index, seeking backward in an input file decompresses it again from the beginning. With an
+//!         index, a seek decompresses at most the data between two access points.
+
+template <class CharT, class Traits>
+typename basic_zfilebuf<CharT, Traits>::pos_type
+basic_zfilebuf<CharT, Traits>::seekoff(off_type                off,
+                                       std::ios_base::seekdir  way,
+                                       std::ios_base::openmode openmode /*= (std::ios_base::openmode)
+                                                                           (std::ios_base::in|std::ios_base::out)*/)
 {
-    int mode;
-
-    if (!file_)
+    if (!is_open())
     {
-        return pos_type(std::_BADOFF);      // report failure
+        return pos_type(off_type(-1));      // report failure
     }
 
     // There are restrictions with seeking:
     //
-    //	std::ios_base::end is not supported as a start location
+    //	std::ios_base::end is not supported as a start location unless the length is known from the index
     //	Only forward seeks are allowed in output buffers, but that is not checked here. The seek will
     //	return an error.
-    if (way == std::ios_base::end)
+    if (way == std::ios_base::end && !(reader_ && reader_->index()))
     {
-        return pos_type(std::_BADOFF);      // report failure
+        return pos_type(off_type(-1));      // report failure
     }
-    else if (way == std::ios_base::cur)
+
+    // If the file is being written, the put area has not reached the file yet
+    if (base_type::pbase() != nullptr)
     {
-        mode = SEEK_CUR;
+        std::unique_lock<std::recursive_mutex> lock = lockOutput();
+
+        // tellp() does not need to flush
+        if (way == std::ios_base::cur && off == 0)
+        {
+            off_type const position = uncompressedOffset();
+            off_type const buffered = off_type(base_type::pptr() - base_type::pbase()) + held_;
+            return (position >= 0) ? pos_type(position + buffered) : pos_type(off_type(-1));
+        }
+
+        if (!flushBuffer())
+        {
+            return pos_type(off_type(-1));  // report failure
+        }
+
+        off_type const current = uncompressedOffset();
+        off_type const target  = (way == std::ios_base::cur) ? current + off : off;
+        ZSTATS_ADD(stats_.seeks, target != current);
+        ZSTATS_ADD(stats_.seekBytes, std::max(target - current, off_type(0)));
+
+        // The parallel and asynchronous compressors can only move forward, by writing zeros
+        if (parallel_ || writer_)
+        {
+            if (target < current)
+            {
+                return pos_type(off_type(-1));  // report failure
+            }
+
+            static char_type const zeros[1024] = { 0 };
+            for (off_type n = target - current; n > 0; n -= off_type(sizeof(zeros)))
+            {
+                if (!write(zeros, std::min(n, off_type(sizeof(zeros)))))
+                {
+                    return pos_type(off_type(-1));  // report failure
+                }
+            }
+            return pos_type(target);
+        }
+
+        z_off_t const position = gzseek(file_, (z_off_t)off, (way == std::ios_base::cur) ? SEEK_CUR : SEEK_SET);
+        return (position >= 0) ? pos_type(off_type(position)) : pos_type(off_type(-1));
     }
-    else
+
+    // The file pointer is at the end of the get area, so the position of the first character in the get area is
+    // behind it by the size of the get area.
+    off_type const fileEnd = ahead_       ? ahead_->tell()
+                           : reader_      ? reader_->tell()
+                           : members_     ? members_->tell()
+                           : speculative_ ? speculative_->tell()
+                                          : off_type(gztell(file_));
+    if (fileEnd < 0)
     {
-        mode = SEEK_SET;
+        return pos_type(off_type(-1));      // report failure
     }
+    off_type const windowStart = fileEnd - off_type(base_type::egptr() - base_type::eback());
+    off_type const current     = windowStart + off_type(base_type::gptr() - base_type::eback());
 
-    // If there is putback data, then the actual file pointer will be different from ours. This must be accounted
-    // for if the seek mode is std::ios_base::cur.
-    if (base_type::gptr() == &putback_ && base_type::gptr() < base_type::egptr() && way == std::ios_base::cur)
+    off_type target = off;
+    if (way == std::ios_base::cur)
+    {
+        target += current;
+    }
+    else if (way == std::ios_base::end)
     {
-        off -= off_type(sizeof(putback_));
+        target += reader_->index()->length();
     }
 
-    // Do the seek
-    z_off_t const _Fileposition = gzseek(file_, (z_off_t)off, mode);
-    if ((int_type)_Fileposition == traits_type::eof())
+    // If the target is in the get area, then just move the pointer. This also makes tellg() free.
+    ZSTATS_ADD(stats_.seeks, target != current);
+    if (base_type::eback() != nullptr && windowStart <= target && target <= fileEnd)
     {
-        return pos_type(std::_BADOFF);      // report failure
+        base_type::setg(base_type::eback(), base_type::eback() + (target - windowStart), base_type::egptr());
+        return pos_type(target);
     }
 
-    // If there is putback data, discard it
-    if (base_type::gptr() == &putback_)
+    // Otherwise, discard the get area and the data decompressed ahead, and do the seek. The checksum restarts at the
+    // target.
+    base_type::setg(nullptr, nullptr, nullptr);
+    checksum_.reset();
+    if (ahead_)
     {
-        base_type::setg(&putback_, &putback_, &putback_);
+        ahead_->stop();
     }
 
-    return pos_type(_Fileposition);
+    // The seek may move backward in the compressed file, so the compressed data consumed so far is counted now
+    countCompressed();
+    ZSTATS_TIME(stats_.zlibNanoseconds);
+
+    if (reader_)
+    {
+        off_type const skipped = reader_->skipped();
+        bool const ok = reader_->seek(target);
+        ZSTATS_ADD(stats_.seekBytes, reader_->skipped() - skipped);
+        compressedStart_ = compressedOffset();
+        if (ahead_)
+        {
+            ahead_->start(reader_->tell());
+        }
+        return ok ? pos_type(target) : pos_type(off_type(-1));
+    }
+
+    if (members_)
+    {
+        off_type const skipped = members_->skipped();
+        bool const ok = members_->seek(target);
+        ZSTATS_ADD(stats_.seekBytes, members_->skipped() - skipped);
+        compressedStart_ = compressedOffset();
+        if (ahead_)
+        {
+            ahead_->start(members_->tell());
+        }
+        return ok ? pos_type(target) : pos_type(off_type(-1));
+    }
+
+    if (speculative_)
+    {
+        off_type const skipped = speculative_->skipped();
+        bool const ok = speculative_->seek(target);
+        ZSTATS_ADD(stats_.seekBytes, speculative_->skipped() - skipped);
+        compressedStart_ = compressedOffset();
+        if (ahead_)
+        {
+            ahead_->start(speculative_->tell());
+        }
+        return ok ? pos_type(target) : pos_type(off_type(-1));
+    }
+
+    // zlib decompresses from the current position if the target is ahead, otherwise from the beginning
+    ZSTATS_ADD(stats_.seekBytes, (target >= fileEnd) ? target - fileEnd : target);
+    z_off_t const position = gzseek(file_, (z_off_t)target, SEEK_SET);
+    compressedStart_ = compressedOffset();
+    if (ahead_)
+    {
+        ahead_->start(off_type(gztell(file_)));
+    }
+    if (position < 0)
+    {
+        return pos_type(off_type(-1));      // report failure
+    }
+
+    return pos_type(off_type(position));
 }
 
 //! @param	pos		    Location to move the pointer
 //! @param	which       Ignored (both in and out pointers are moved)
-//! @note	There are restrictions imposed by @c zlib:
-//!				-#	<tt>std::ios_base::end</tt> is not supported as a start location
-//!				-#	Only forward seeks are allowed in output buffers
+//! @note	Only forward seeks are allowed in output buffers
 
-zfilebuf::pos_type zfilebuf::seekpos(pos_type                pos,
-                                     std::ios_base::openmode which /* = (std::ios_base::openmode) (std::ios_base::in |
-                                                                      std::ios_base::out)*/)
+template <class CharT, class Traits>
+typename basic_zfilebuf<CharT, Traits>::pos_type
+basic_zfilebuf<CharT, Traits>::seekpos(pos_type                pos,
+                                       std::ios_base::openmode which /* = (std::ios_base::openmode) (std::ios_base::in |
+                                                                        std::ios_base::out)*/)
 {
     return seekoff(pos, std::ios_base::beg);
 }
 
-//! @param	s	Address of buffer
-//! @param	n	Size of the buffer
-//
-//! @note	This function does nothing since the stream is unbuffered. The return value is always 0.
+//! @param	s	Address of buffer, or nullptr to have the buffer allocated internally
+//! @param	n	Size of the buffer. If @p n is 0, the stream is unbuffered.
+//!
+//! @return     @c this, or nullptr if the buffer cannot be changed because it holds data
+//!
+//! @note	The buffer holds uncompressed data. Characters are read from the file into it, or written from it to
+//!         the file, in bulk. If @p s is
+//!         provided, it must remain valid until the buffer is replaced or this object is destroyed.
 
-zfilebuf::base_type * zfilebuf::setbuf(char_type * s, std::streamsize n)
+template <class CharT, class Traits>
+typename basic_zfilebuf<CharT, Traits>::base_type *
+basic_zfilebuf<CharT, Traits>::setbuf(char_type * s, std::streamsize n)
 {
-    return this;    // This function does nothing
+    // The buffer cannot be replaced while it contains unread or unwritten data
+    if (base_type::gptr() < base_type::egptr() || base_type::pptr() > base_type::pbase() || held_ > 0)
+    {
+        return nullptr;
+    }
+
+    base_type::setg(nullptr, nullptr, nullptr);
+    base_type::setp(nullptr, nullptr);
+
+    ownBuffer_.clear();
+    ownBuffer_.shrink_to_fit();
+    buffer_     = (s != nullptr && n > 0) ? s : nullptr;
+    bufferSize_ = std::max(n, std::streamsize(0));
+
+    return this;
 }
 
-int zfilebuf::sync()
+//! @note   By default, the buffered output is written to the file and zlib is flushed, so everything written so far
+//!         can be decompressed by a reader of the file. The flush policy (see set_flush_policy()) can change that.
+
+template <class CharT, class Traits>
+int basic_zfilebuf<CharT, Traits>::sync()
 {
-    // No file is open, return success
-    if (!file_)
+    // No file is open or nothing has been written, return success
+    if (!is_open() || base_type::pbase() == nullptr)
     {
         return 0;
     }
 
-    // Overflow cannot write any more data, return success
-    if (overflow() != traits_type::eof())
+    std::unique_lock<std::recursive_mutex> lock = lockOutput();
+    ZSTATS_ADD(stats_.syncs, 1);
+    if (flushPolicy_.mode == zflushpolicy::IGNORE_REQUEST)
     {
         return 0;
     }
 
+    // Write the buffered output
+    if (!flushBuffer())
+    {
+        return -1;
+    }
+
     // Flush and return status
-    return (gzflush(file_, Z_SYNC_FLUSH) >= 0) ? 0 : -1;
+    zcodec::Flush const flush = flushPolicy_.requested();
+    return (flush == zcodec::NO_FLUSH || flushCodec(flush)) ? 0 : -1;
 }
 
-std::streamsize zfilebuf::xsgetn(char_type * s, std::streamsize n)
+//! @param	s	Where to store the data
+//! @param	n	Number of uncompressed bytes to read
+//!
+//! @note   Data already in the buffer is returned first. Requests that are larger than the buffer are then read
+//!         directly into @p s.
+
+template <class CharT, class Traits>
+std::streamsize basic_zfilebuf<CharT, Traits>::xsgetn(char_type * s, std::streamsize n)
 {
     // If the file is not open, return error
-    if (!file_)
+    if (!file_ && !reader_ && !members_ && !speculative_)
     {
         return std::streamsize(0);
     }
 
-    int total = 0;
+    std::streamsize total = 0;
 
-    // If there is data in the input buffer, return it first.
-    if (base_type::gptr() != 0)
+    while (total < n)
     {
-        while (base_type::gptr() < base_type::egptr() && n > 0)
+        // If there is data in the input buffer, return it first.
+        std::streamsize available = base_type::egptr() - base_type::gptr();
+        if (available > 0)
         {
-            *s++ = *base_type::_Gninc();
-            --n;
-            ++total;
+            std::streamsize size = std::min(available, n - total);
+            memcpy(s + total, base_type::gptr(), size_t(size));
+            base_type::setg(base_type::eback(), base_type::gptr() + size, base_type::egptr());
+            total += size;
+        }
+
+        // Otherwise, if the rest will not fit in the buffer, read it straight into the caller's memory
+        else if (n - total >= ioBufferSize())
+        {
+            unsigned int size = (unsigned int)std::min(n - total, std::streamsize(INT_MAX));
+            int count = read(s + total, size);
+            if (count <= 0)
+            {
+                break;
+            }
+            total += count;
+            savePutback(s + total, total);
         }
-    }
 
-    // Read the rest from the file
-    total += gzread(file_, s, (unsigned int)n);
+        // Otherwise, refill the buffer
+        else if (!fill())
+        {
+            break;
+        }
+    }
 
-    return std::streamsize(total);
+    return total;
 }
 
-std::streamsize zfilebuf::xsputn(char_type const * s, std::streamsize n)
+//! @param	s	Uncompressed data to write
+//! @param	n	Number of uncompressed bytes to write
+//!
+//! @note   Small writes are collected in the buffer. Writes that are larger than the buffer are sent straight to
+//!         the file.
+
+template <class CharT, class Traits>
+std::streamsize basic_zfilebuf<CharT, Traits>::xsputn(char_type const * s, std::streamsize n)
 {
-    // If the file is not open, return error
-    if (!file_)
+    if (n <= 0)
     {
         return 0;
     }
 
-    // Otherwise, write to the file
-    return std::streamsize(gzwrite(file_, s, (unsigned int)n));
+    // If the data fits in the put area, just copy it
+    if (n <= base_type::epptr() - base_type::pptr())
+    {
+        memcpy(base_type::pptr(), s, size_t(n));
+        base_type::pbump(int(n));
+        return n;
+    }
+
+    // Otherwise, if the file is not open or it is being read, return error
+    if (!is_open() || base_type::gptr() != nullptr)
+    {
+        return 0;
+    }
+
+    // Otherwise, if there is a flush timer, the data is held in the I/O buffer
+    if (timer_)
+    {
+        return hold(s, n) ? n : 0;
+    }
+
+    // Otherwise, make room by writing the buffered output to the file
+    if (!flushBuffer())
+    {
+        return 0;
+    }
+
+    // If the data will not fit in the buffer, then write it straight to the file
+    if (n >= ioBufferSize())
+    {
+        return write(s, n) ? n : 0;
+    }
+
+    memcpy(base_type::pptr(), s, size_t(n));
+    base_type::pbump(int(n));
+    return n;
+}
+
+//! @note   The data is decompressed into the I/O buffer and discarded, so the cost is that of decompression alone. The
+//!         checks are those of the format (the CRC and size in each gzip trailer, for example), and the running
+//!         checksum is also updated if it is enabled. Afterwards, the position is at the end of the file.
+//! @note   A file that is not compressed is passed through by zlib, so it is always intact.
+
+template <class CharT, class Traits>
+bool basic_zfilebuf<CharT, Traits>::verify()
+{
+    // Nothing can be read if the file is not open or it is being written
+    if ((!file_ && !reader_ && !members_ && !speculative_) || base_type::pbase() != nullptr)
+    {
+        return false;
+    }
+
+    char_type * const buffer = ioBuffer();
+    unsigned const    size   = (unsigned)std::min(ioBufferSize(), std::streamsize(INT_MAX));
+    base_type::setg(nullptr, nullptr, nullptr);
+
+    int count;
+    while ((count = read(buffer, size)) > 0)
+    {
+    }
+    if (count < 0)
+    {
+        return false;
+    }
+
+    // gzread() reports a truncated file as the end of the file, and records the error
+    int error = Z_OK;
+    if (file_)
+    {
+        gzerror(file_, &error);
+    }
+    return error == Z_OK;
+}
+
+template <class CharT, class Traits>
+zstats basic_zfilebuf<CharT, Traits>::stats() const
+{
+    std::unique_lock<std::recursive_mutex> lock = lockOutput();
+    zstats stats = stats_;
+    if (is_open())
+    {
+        ZSTATS_ADD(stats.compressedBytes, compressedOffset() - compressedStart_);
+    }
+    return stats;
+}
+
+template <class CharT, class Traits>
+void basic_zfilebuf<CharT, Traits>::countCompressed()
+{
+    off_type const offset = compressedOffset();
+    ZSTATS_ADD(stats_.compressedBytes, offset - compressedStart_);
+    compressedStart_ = offset;
+}
+
+template <class CharT, class Traits>
+void basic_zfilebuf<CharT, Traits>::reset_stats()
+{
+    stats_ = zstats();
+    compressedStart_ = is_open() ? compressedOffset() : 0;
 }
 
 //! @param	file	File pointer of opened file
@@ -340,11 +875,453 @@ std::streamsize zfilebuf::xsputn(char_type const * s, std::streamsize n)
 //!					- OPENED
 //!					- CLOSED
 
-void zfilebuf::initialize(gzFile file, InitializeReason reason)
+template <class CharT, class Traits>
+void basic_zfilebuf<CharT, Traits>::initialize(gzFile file, InitializeReason reason)
 {
     // If this is an open, then remember that the file must be closed
     needsClose_ = (reason == OPENED);
 
     // Save the file pointer
     file_ = file;
+    unflushed_       = 0;
+    held_            = 0;
+    compressedStart_ = 0;
+    checksum_.reset((codec_ == zcodec::ZLIB) ? zchecksum::ADLER32 : zchecksum::CRC32);
+
+    // Any buffered data belongs to the previous file
+    base_type::setg(nullptr, nullptr, nullptr);
+    base_type::setp(nullptr, nullptr);
 }
+
+template <class CharT, class Traits>
+typename basic_zfilebuf<CharT, Traits>::char_type *
+basic_zfilebuf<CharT, Traits>::ioBuffer()
+{
+    if (!buffer_)
+    {
+        ownBuffer_.resize(size_t(ioBufferSize()));
+        buffer_ = ownBuffer_.data();
+    }
+    return buffer_;
+}
+
+template <class CharT, class Traits>
+bool basic_zfilebuf<CharT, Traits>::fill()
+{
+    // Nothing can be read if the file is not open or it is being written
+    if ((!file_ && !reader_ && !members_ && !speculative_) || base_type::pbase() != nullptr)
+    {
+        return false;
+    }
+
+    char_type * const buffer = ioBuffer();
+    std::streamsize const size = ioBufferSize();
+
+    // Move the last few characters to the beginning of the buffer so that they can be put back
+    std::streamsize putback = 0;
+    if (base_type::eback() != nullptr)
+    {
+        putback = std::min(std::min(std::streamsize(PUTBACK_SIZE), base_type::gptr() - base_type::eback()), size - 1);
+        memmove(buffer, base_type::gptr() - putback, size_t(putback));
+    }
+
+    int count = read(buffer + putback, (unsigned int)std::min(size - putback, std::streamsize(INT_MAX)));
+    if (count <= 0)
+    {
+        base_type::setg(buffer, buffer + putback, buffer + putback);
+        return false;
+    }
+
+    base_type::setg(buffer, buffer + putback, buffer + putback + count);
+    return true;
+}
+
+//! @param	end     End of the data that was read
+//! @param	n       Number of characters that were read
+
+template <class CharT, class Traits>
+void basic_zfilebuf<CharT, Traits>::savePutback(char_type const * end, std::streamsize n)
+{
+    char_type * const buffer = ioBuffer();
+    std::streamsize const putback = std::min(std::min(std::streamsize(PUTBACK_SIZE), n), ioBufferSize());
+    memcpy(buffer, end - putback, size_t(putback));
+    base_type::setg(buffer, buffer + putback, buffer + putback);
+}
+
+template <class CharT, class Traits>
+bool basic_zfilebuf<CharT, Traits>::flushBuffer()
+{
+    std::unique_lock<std::recursive_mutex> lock = lockOutput();
+
+    // With a flush timer, the output is held in the I/O buffer instead of the put area (see hold())
+    std::streamsize const held = held_;
+    held_ = 0;
+    if (held > 0 && !write(buffer_, held))
+    {
+        return false;
+    }
+
+    std::streamsize const n = base_type::pptr() - base_type::pbase();
+    if (n > 0 && !write(base_type::pbase(), n))
+    {
+        return false;
+    }
+
+    char_type * const buffer = ioBuffer();
+    base_type::setp(buffer, timer_ ? buffer : buffer + ioBufferSize());
+    return true;
+}
+
+//! @param	s	Data to write
+//! @param	n	Number of characters to write
+//!
+//! @note   The timer's action runs on another thread, so it cannot use the put area, which the stream's inline
+//!         functions change without taking the lock. The put area is therefore kept empty, and every character that
+//!         is written comes here, where it is held under the lock and restarts the timer.
+
+template <class CharT, class Traits>
+bool basic_zfilebuf<CharT, Traits>::hold(char_type const * s, std::streamsize n)
+{
+    std::unique_lock<std::recursive_mutex> lock = lockOutput();
+    char_type * const buffer = ioBuffer();
+    if (base_type::pbase() == nullptr)
+    {
+        base_type::setp(buffer, buffer);
+    }
+
+    // Make room by writing the held output. Data that does not fit in the buffer is written directly.
+    if (held_ + n > ioBufferSize())
+    {
+        if (!flushBuffer())
+        {
+            return false;
+        }
+        if (n >= ioBufferSize())
+        {
+            return write(s, n);
+        }
+    }
+
+    memcpy(buffer + held_, s, size_t(n));
+    held_ += n;
+    timer_->touch();
+    return true;
+}
+
+//! @param	s   Where to put the data
+//! @param	n   Maximum number of bytes to read
+
+template <class CharT, class Traits>
+int basic_zfilebuf<CharT, Traits>::read(char_type * s, unsigned n)
+{
+    int count;
+    {
+        ZSTATS_TIME(stats_.zlibNanoseconds);
+        count = ahead_ ? ahead_->read(bytes(s), n) : decompress(s, n);
+    }
+    ZSTATS_ADD(stats_.inflateCalls, 1);
+    ZSTATS_ADD(stats_.uncompressedBytes, std::max(count, 0));
+    if (runningChecksum_ && count > 0)
+    {
+        checksum_.update(s, size_t(count));
+    }
+    return count;
+}
+
+//! @param	s   Where to put the data
+//! @param	n   Maximum number of bytes to read
+
+template <class CharT, class Traits>
+int basic_zfilebuf<CharT, Traits>::decompress(char_type * s, unsigned n)
+{
+    if (reader_)
+    {
+        return reader_->read(bytes(s), n);
+    }
+    if (members_)
+    {
+        return members_->read(bytes(s), n);
+    }
+    if (speculative_)
+    {
+        return speculative_->read(bytes(s), n);
+    }
+    return gzread(file_, s, n);
+}
+
+//! @param	s   Data to write
+//! @param	n   Number of bytes to write
+//!
+//! @note   The compressor is flushed afterwards if the flush policy calls for it.
+
+template <class CharT, class Traits>
+bool basic_zfilebuf<CharT, Traits>::write(char_type const * s, std::streamsize n)
+{
+    std::unique_lock<std::recursive_mutex> lock = lockOutput();
+
+    // The adaptive controller decides once per block, so a large write is compressed a block at a time
+    if (controller_)
+    {
+        for (std::streamsize left = std::streamsize(controller_->remaining()); n > left;
+             left = std::streamsize(controller_->remaining()))
+        {
+            if (!write(s, left))
+            {
+                return false;
+            }
+            s += left;
+            n -= left;
+        }
+    }
+
+    // Writes that look incompressible are stored. A large write is judged a piece at a time.
+    if (probing_)
+    {
+        for (; n > zadaptive::PROBE_SIZE; s += zadaptive::PROBE_SIZE, n -= zadaptive::PROBE_SIZE)
+        {
+            if (!write(s, zadaptive::PROBE_SIZE))
+            {
+                return false;
+            }
+        }
+        if (n >= zadaptive::MIN_PROBE_SIZE)
+        {
+            bool const store = zadaptive::incompressible(bytes(s), size_t(n));
+            if (store != storing_)
+            {
+                storing_ = store;
+                applySettings();
+            }
+        }
+        ZSTATS_ADD(stats_.storedBytes, storing_ ? n : 0);
+    }
+
+    // The adaptive controller measures the compressor
+    std::chrono::steady_clock::time_point const start = controller_ ? std::chrono::steady_clock::now()
+                                                                    : std::chrono::steady_clock::time_point();
+    off_type const compressed = controller_ ? compressedOffset() : 0;
+    {
+        ZSTATS_TIME(stats_.zlibNanoseconds);
+        ZSTATS_ADD(stats_.uncompressedBytes, n);
+
+        if (parallel_)
+        {
+            ZSTATS_ADD(stats_.deflateCalls, 1);
+            if (!parallel_->write(bytes(s), size_t(n)))
+            {
+                return false;
+            }
+        }
+        else if (writer_)
+        {
+            ZSTATS_ADD(stats_.deflateCalls, 1);
+            if (!writer_->write(bytes(s), size_t(n)))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            for (std::streamsize left = n; left > 0;)
+            {
+                unsigned int size = (unsigned int)std::min(left, std::streamsize(INT_MAX));
+                ZSTATS_ADD(stats_.deflateCalls, 1);
+                if (gzwrite(file_, s, size) != int(size))
+                {
+                    return false;
+                }
+                s    += size;
+                left -= size;
+            }
+        }
+    }
+
+    // Writes that were stored because they look incompressible say nothing about the controller's setting. Measuring
+    // them would drive the controller to store everything.
+    if (controller_ && !storing_)
+    {
+        adapt(size_t(n), size_t(compressedOffset() - compressed), std::chrono::steady_clock::now() - start);
+    }
+
+    unflushed_ += n;
+    if (flushPolicy_.bytes > 0 && unflushed_ >= off_type(flushPolicy_.bytes))
+    {
+        return flushCodec(flushPolicy_.automatic());
+    }
+    if (timer_)
+    {
+        timer_->touch();
+    }
+    return true;
+}
+
+//!
+//! @param	flush   Flush mode (PARTIAL_FLUSH, SYNC_FLUSH, or FULL_FLUSH)
+
+template <class CharT, class Traits>
+bool basic_zfilebuf<CharT, Traits>::flushCodec(zcodec::Flush flush)
+{
+    std::unique_lock<std::recursive_mutex> lock = lockOutput();
+    ZSTATS_TIME(stats_.zlibNanoseconds);
+    unflushed_ = 0;
+    if (parallel_)
+    {
+        return parallel_->flush();
+    }
+    if (writer_)
+    {
+        return writer_->flush(flush);
+    }
+    int const mode = (flush == zcodec::PARTIAL_FLUSH) ? Z_PARTIAL_FLUSH
+                   : (flush == zcodec::FULL_FLUSH)    ? Z_FULL_FLUSH
+                                                      : Z_SYNC_FLUSH;
+    return gzflush(file_, mode) == Z_OK;
+}
+
+template <class CharT, class Traits>
+typename basic_zfilebuf<CharT, Traits>::off_type
+basic_zfilebuf<CharT, Traits>::compressedOffset() const
+{
+    if (parallel_)
+    {
+        return off_type(parallel_->compressed());
+    }
+    if (writer_)
+    {
+        return off_type(writer_->compressed());
+    }
+
+    // The helper may be decompressing
+    std::unique_lock<std::mutex> lock;
+    if (ahead_)
+    {
+        lock = ahead_->lock_source();
+    }
+
+    if (reader_)
+    {
+        return reader_->offset();
+    }
+    if (members_)
+    {
+        return members_->offset();
+    }
+    if (speculative_)
+    {
+        return speculative_->offset();
+    }
+    if (file_)
+    {
+        z_off_t const offset = gzoffset(file_);
+        return (offset >= 0) ? off_type(offset) : 0;
+    }
+    return 0;
+}
+
+template <class CharT, class Traits>
+typename basic_zfilebuf<CharT, Traits>::off_type
+basic_zfilebuf<CharT, Traits>::uncompressedOffset() const
+{
+    if (parallel_)
+    {
+        return off_type(parallel_->tell());
+    }
+    if (writer_)
+    {
+        return off_type(writer_->tell());
+    }
+    return off_type(gztell(file_));
+}
+
+template <class CharT, class Traits>
+void basic_zfilebuf<CharT, Traits>::startReadAhead()
+{
+    if (!readAhead_)
+    {
+        return;
+    }
+
+    ahead_.reset(new zreadahead([this] (zcodec::char_type * s, unsigned n) {
+        return decompress(reinterpret_cast<char_type *>(s), n);
+    }));
+    ahead_->start(0);
+}
+
+template <class CharT, class Traits>
+void basic_zfilebuf<CharT, Traits>::startTimer()
+{
+    if (flushPolicy_.milliseconds == 0)
+    {
+        return;
+    }
+
+    // Anything written since the last flush is flushed once the output is idle, including the output held in the I/O
+    // buffer. The action runs with the lock held, and it does not use the put area (see hold()).
+    timer_.reset(new zflushtimer(std::chrono::milliseconds(flushPolicy_.milliseconds), [this] () {
+        std::streamsize const held = held_;
+        held_ = 0;
+        if ((held == 0 || write(buffer_, held)) && unflushed_ > 0)
+        {
+            flushCodec(flushPolicy_.automatic());
+        }
+    }));
+}
+
+//!
+//! @param	type    Format of the file
+
+template <class CharT, class Traits>
+void basic_zfilebuf<CharT, Traits>::startAdaptive(zcodec::Type type)
+{
+    // The settings are for zlib. The other formats already store incompressible data cheaply.
+    bool const zlib = (type == zcodec::GZIP || type == zcodec::ZLIB || type == zcodec::DEFLATE);
+    if (adaptive_ && zlib)
+    {
+        controller_.reset(new zadaptive(adaptiveTarget_, level_));
+    }
+    probing_ = skipIncompressible_ && zlib;
+    storing_ = false;
+}
+
+//! @param	in      Number of characters compressed
+//! @param	out     Number of bytes written to the file
+//! @param	time    Time spent compressing
+
+template <class CharT, class Traits>
+void basic_zfilebuf<CharT, Traits>::adapt(size_t in, size_t out, std::chrono::nanoseconds time)
+{
+    if (!controller_->update(in, out, time))
+    {
+        return;
+    }
+
+    ZSTATS_ADD(stats_.adaptations, 1);
+    applySettings();
+}
+
+//! @note   Stored output overrides the controller's level, which applies again when the output is compressed again.
+
+template <class CharT, class Traits>
+void basic_zfilebuf<CharT, Traits>::applySettings()
+{
+    int const level    = storing_ ? 0 : controller_ ? controller_->level() : level_;
+    int const strategy = controller_ ? controller_->strategy() : writer_ ? codecOptions_.strategy : Z_DEFAULT_STRATEGY;
+    if (writer_)
+    {
+        writer_->set_compression(level);
+        writer_->set_strategy(strategy);
+    }
+    else
+    {
+        gzsetparams(file_, level, strategy);
+    }
+}
+
+template <class CharT, class Traits>
+std::unique_lock<std::recursive_mutex> basic_zfilebuf<CharT, Traits>::lockOutput() const
+{
+    return timer_ ? timer_->lock() : std::unique_lock<std::recursive_mutex>();
+}
+
+template class basic_zfilebuf<unsigned char>;
+template class basic_zfilebuf<char>;
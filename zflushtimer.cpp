@@ -0,0 +1,74 @@
+/** @file *//********************************************************************************************************
+
+                                                  zflushtimer.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zflushtimer.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zflushtimer.h"
+
+//! @param	delay   Idle time before the action is performed
+//! @param	action  The action. It is called by the helper thread.
+
+zflushtimer::zflushtimer(std::chrono::milliseconds delay, action_type action)
+    : delay_(delay)
+    , action_(std::move(action))
+    , armed_(false)
+    , stop_(false)
+{
+    helper_ = std::thread(&zflushtimer::helper, this);
+}
+
+//! @note   A pending action is not performed.
+
+zflushtimer::~zflushtimer()
+{
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        stop_ = true;
+    }
+    changed_.notify_all();
+    helper_.join();
+}
+
+//! @note   This is called often, so it only wakes the helper if the timer was not already running. Otherwise, the
+//!         helper finds the new deadline when it wakes up at the old one.
+
+void zflushtimer::touch()
+{
+    deadline_ = std::chrono::steady_clock::now() + delay_;
+    if (!armed_)
+    {
+        armed_ = true;
+        changed_.notify_all();
+    }
+}
+
+void zflushtimer::helper()
+{
+    std::unique_lock<std::recursive_mutex> lock(mutex_);
+    while (!stop_)
+    {
+        if (!armed_)
+        {
+            changed_.wait(lock);
+        }
+        else if (std::chrono::steady_clock::now() < deadline_)
+        {
+            // The wait reads the deadline after releasing the lock, so it gets a copy that touch() cannot change
+            std::chrono::steady_clock::time_point const deadline = deadline_;
+            changed_.wait_until(lock, deadline);
+        }
+        else
+        {
+            armed_ = false;
+            action_();
+        }
+    }
+}
@@ -20,7 +20,8 @@
 //!
 //! @param	name	Name of the file to be opened for input, or 0
 
-izfstream::izfstream(char const * name /* = nullptr*/)
+template <class CharT, class Traits>
+basic_izfstream<CharT, Traits>::basic_izfstream(char const * name /* = nullptr*/)
     : base_type(&fileBuffer_)
 {
     if (name && !fileBuffer_.open(name, std::ios_base::in))
@@ -32,7 +33,8 @@ izfstream::izfstream(char const * name /* = nullptr*/)
 //!
 //! @param	name	Name of the file to be opened for input
 
-void izfstream::open(char const * name)
+template <class CharT, class Traits>
+void basic_izfstream<CharT, Traits>::open(char const * name)
 {
     if (!fileBuffer_.open(name, std::ios_base::in))
     {
@@ -40,18 +42,27 @@ void izfstream::open(char const * name)
     }
 }
 
-void izfstream::close()
+template <class CharT, class Traits>
+void basic_izfstream<CharT, Traits>::close()
 {
     if (!fileBuffer_.close())
     {
-        ios_type::setstate(ios_base::failbit);
+        ios_type::setstate(std::ios_base::failbit);
     }
 }
 
+template <class CharT, class Traits>
+bool basic_izfstream<CharT, Traits>::build_index(char const * name, std::streamoff span /* = zindex::DEFAULT_SPAN*/)
+{
+    zindex index;
+    return index.build(name, span) && index.save(zindex::sidecar(name).c_str());
+}
+
 //!
 //! @param	name	Name of the file to be opened for output
 
-ozfstream::ozfstream(const char * name /* = nullptr*/)
+template <class CharT, class Traits>
+basic_ozfstream<CharT, Traits>::basic_ozfstream(const char * name /* = nullptr*/)
     : std::basic_ostream<char_type, traits_type>(&fileBuffer_)
 {
     if (name && !fileBuffer_.open(name, std::ios_base::out))
@@ -63,7 +74,8 @@ ozfstream::ozfstream(const char * name /* = nullptr*/)
 //!
 //! @param	name	Name of the file to be opened for output
 
-void ozfstream::open(char const * name)
+template <class CharT, class Traits>
+void basic_ozfstream<CharT, Traits>::open(char const * name)
 {
     if (!fileBuffer_.open(name, std::ios_base::out))
     {
@@ -71,10 +83,16 @@ void ozfstream::open(char const * name)
     }
 }
 
-void ozfstream::close()
+template <class CharT, class Traits>
+void basic_ozfstream<CharT, Traits>::close()
 {
     if (!fileBuffer_.close())
     {
         ios_type::setstate(std::ios_base::failbit);
     }
 }
+
+template class basic_izfstream<unsigned char>;
+template class basic_ozfstream<unsigned char>;
+template class basic_izfstream<char>;
+template class basic_ozfstream<char>;
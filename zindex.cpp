@@ -0,0 +1,343 @@
+/** @file *//********************************************************************************************************
+
+                                                     zindex.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zindex.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zindex.h"
+
+#include "zlib/zlib.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+
+// Sidecar file header
+unsigned char const MAGIC[4] = { 'Z', 'I', 'D', 'X' };
+unsigned long const VERSION  = 1;
+
+// Amount of compressed data read at a time while building
+size_t const INPUT_SIZE = 64 * 1024;
+
+// Writes an unsigned value in little-endian order
+bool putValue(FILE * file, unsigned long long x, int size)
+{
+    unsigned char buffer[8];
+    for (int i = 0; i < size; ++i)
+    {
+        buffer[i] = (unsigned char)(x >> (i * 8));
+    }
+    return fwrite(buffer, 1, size_t(size), file) == size_t(size);
+}
+
+// Reads an unsigned value in little-endian order
+bool getValue(FILE * file, unsigned long long & x, int size)
+{
+    unsigned char buffer[8];
+    if (fread(buffer, 1, size_t(size), file) != size_t(size))
+    {
+        return false;
+    }
+    x = 0;
+    for (int i = size - 1; i >= 0; --i)
+    {
+        x = (x << 8) | buffer[i];
+    }
+    return true;
+}
+
+// Returns the size of a file, or -1 if it cannot be determined
+zindex::off_type fileSize(FILE * file)
+{
+#if defined(_WIN32)
+    if (_fseeki64(file, 0, SEEK_END) != 0)
+    {
+        return -1;
+    }
+    zindex::off_type size = _ftelli64(file);
+    _fseeki64(file, 0, SEEK_SET);
+#else
+    if (fseeko(file, 0, SEEK_END) != 0)
+    {
+        return -1;
+    }
+    zindex::off_type size = ftello(file);
+    fseeko(file, 0, SEEK_SET);
+#endif
+    return size;
+}
+
+} // anonymous namespace
+
+zindex::zindex()
+    : length_(0)
+    , compressedSize_(0)
+{
+}
+
+//! @param	name	Name of the gzip file
+//! @param	span	Amount of decompressed data between access points
+//!
+//! @note	Files containing several concatenated gzip members are supported. Anything following the last member
+//!         that is not a gzip member is ignored, as it is by @c gzread().
+
+bool zindex::build(char const * name, off_type span /* = DEFAULT_SPAN*/)
+{
+    points_.clear();
+    length_         = 0;
+    compressedSize_ = 0;
+
+    FILE * file = fopen(name, "rb");
+    if (!file)
+    {
+        return false;
+    }
+    compressedSize_ = fileSize(file);
+
+    z_stream stream;
+    stream.zalloc   = Z_NULL;
+    stream.zfree    = Z_NULL;
+    stream.opaque   = Z_NULL;
+    stream.next_in  = Z_NULL;
+    stream.avail_in = 0;
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+    {
+        fclose(file);
+        return false;
+    }
+
+    // The decompressed data is written to a circular window, so that the window preceding an access point is
+    // always available.
+    std::vector<char_type> input(INPUT_SIZE);
+    std::vector<char_type> window(WINDOW_SIZE);
+    std::vector<char_type> snapshot(WINDOW_SIZE);
+    stream.avail_out = 0;
+
+    off_type totalIn  = 0;
+    off_type totalOut = 0;
+    off_type last     = 0;
+    int status        = Z_OK;
+    bool ok           = true;
+
+    for (;;)
+    {
+        // Read more compressed data if needed. At the end of a member, at least 2 bytes are needed to check for
+        // another one.
+        size_t const needed = (status == Z_STREAM_END) ? 2 : 1;
+        if (stream.avail_in < needed)
+        {
+            memmove(input.data(), stream.next_in, stream.avail_in);
+            size_t count = fread(input.data() + stream.avail_in, 1, input.size() - stream.avail_in, file);
+            stream.next_in   = input.data();
+            stream.avail_in += uInt(count);
+            if (ferror(file))
+            {
+                ok = false;
+                break;
+            }
+        }
+
+        // At the end of a member, continue if another member follows
+        if (status == Z_STREAM_END)
+        {
+            if (stream.avail_in < 2 || stream.next_in[0] != 0x1f || stream.next_in[1] != 0x8b)
+            {
+                break;
+            }
+            inflateReset(&stream);
+        }
+
+        // If there is no more data, then the file is truncated
+        if (stream.avail_in == 0)
+        {
+            ok = false;
+            break;
+        }
+
+        if (stream.avail_out == 0)
+        {
+            stream.next_out  = window.data();
+            stream.avail_out = WINDOW_SIZE;
+        }
+
+        // Decompress until the end of a block
+        totalIn  += stream.avail_in;
+        totalOut += stream.avail_out;
+        status    = inflate(&stream, Z_BLOCK);
+        totalIn  -= stream.avail_in;
+        totalOut -= stream.avail_out;
+
+        if (status != Z_OK && status != Z_STREAM_END)
+        {
+            ok = false;
+            break;
+        }
+
+        // If at the beginning of a block that is not the last one and far enough from the previous access point,
+        // then add an access point.
+        if ((stream.data_type & 128) && !(stream.data_type & 64) && totalOut - last >= span)
+        {
+            // Put the window in order
+            size_t const split = WINDOW_SIZE - stream.avail_out;
+            std::copy(window.begin() + split, window.end(), snapshot.begin());
+            std::copy(window.begin(), window.begin() + split, snapshot.begin() + (WINDOW_SIZE - split));
+
+            point p;
+            p.out  = totalOut;
+            p.in   = totalIn;
+            p.bits = stream.data_type & 7;
+
+            uLongf size = compressBound(WINDOW_SIZE);
+            p.window.resize(size);
+            if (compress2(p.window.data(), &size, snapshot.data(), WINDOW_SIZE, Z_BEST_SPEED) != Z_OK)
+            {
+                ok = false;
+                break;
+            }
+            p.window.resize(size);
+            p.window.shrink_to_fit();
+
+            points_.push_back(std::move(p));
+            last = totalOut;
+        }
+    }
+
+    inflateEnd(&stream);
+    fclose(file);
+
+    length_ = totalOut;
+    if (!ok)
+    {
+        points_.clear();
+        length_ = 0;
+    }
+    return ok;
+}
+
+//!
+//! @param	name	Name of the index file
+
+bool zindex::load(char const * name)
+{
+    points_.clear();
+    length_         = 0;
+    compressedSize_ = 0;
+
+    FILE * file = fopen(name, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    unsigned char magic[sizeof(MAGIC)];
+    unsigned long long version;
+    unsigned long long length;
+    unsigned long long compressedSize;
+    unsigned long long count;
+
+    bool ok = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+              memcmp(magic, MAGIC, sizeof(MAGIC)) == 0 &&
+              getValue(file, version, 4) && version == VERSION &&
+              getValue(file, length, 8) &&
+              getValue(file, compressedSize, 8) &&
+              getValue(file, count, 8);
+
+    for (unsigned long long i = 0; ok && i < count; ++i)
+    {
+        unsigned long long out;
+        unsigned long long in;
+        unsigned long long bits;
+        unsigned long long size;
+
+        ok = getValue(file, out, 8) &&
+             getValue(file, in, 8) &&
+             getValue(file, bits, 1) && bits < 8 &&
+             getValue(file, size, 4) && size <= compressBound(WINDOW_SIZE);
+        if (ok)
+        {
+            point p;
+            p.out  = off_type(out);
+            p.in   = off_type(in);
+            p.bits = int(bits);
+            p.window.resize(size_t(size));
+            ok = fread(p.window.data(), 1, p.window.size(), file) == p.window.size();
+            points_.push_back(std::move(p));
+        }
+    }
+
+    fclose(file);
+
+    if (!ok)
+    {
+        points_.clear();
+        return false;
+    }
+
+    length_         = off_type(length);
+    compressedSize_ = off_type(compressedSize);
+    return true;
+}
+
+//!
+//! @param	name	Name of the index file
+
+bool zindex::save(char const * name) const
+{
+    FILE * file = fopen(name, "wb");
+    if (!file)
+    {
+        return false;
+    }
+
+    bool ok = fwrite(MAGIC, 1, sizeof(MAGIC), file) == sizeof(MAGIC) &&
+              putValue(file, VERSION, 4) &&
+              putValue(file, (unsigned long long)length_, 8) &&
+              putValue(file, (unsigned long long)compressedSize_, 8) &&
+              putValue(file, points_.size(), 8);
+
+    for (size_t i = 0; ok && i < points_.size(); ++i)
+    {
+        point const & p = points_[i];
+        ok = putValue(file, (unsigned long long)p.out, 8) &&
+             putValue(file, (unsigned long long)p.in, 8) &&
+             putValue(file, (unsigned long long)p.bits, 1) &&
+             putValue(file, p.window.size(), 4) &&
+             fwrite(p.window.data(), 1, p.window.size(), file) == p.window.size();
+    }
+
+    if (fclose(file) != 0)
+    {
+        ok = false;
+    }
+    return ok;
+}
+
+//!
+//! @param	offset	Offset in the decompressed data
+
+zindex::point const * zindex::locate(off_type offset) const
+{
+    auto i = std::upper_bound(points_.begin(), points_.end(), offset,
+                              [] (off_type offset, point const & p) { return offset < p.out; });
+    return (i != points_.begin()) ? &*(i - 1) : nullptr;
+}
+
+//! @param	p		Access point
+//! @param	window	Where to put the data. It must be able to hold WINDOW_SIZE characters.
+
+bool zindex::window(point const & p, char_type * window) const
+{
+    uLongf size = WINDOW_SIZE;
+    return uncompress(window, &size, p.window.data(), uLong(p.window.size())) == Z_OK && size == WINDOW_SIZE;
+}
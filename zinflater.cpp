@@ -0,0 +1,518 @@
+/** @file *//********************************************************************************************************
+
+                                                    zinflater.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zinflater.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zinflater.h"
+
+#include "zallocator.h"
+#include "zlib/zlib.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace
+{
+
+// Amount of compressed data read at a time
+size_t const INPUT_SIZE = 64 * 1024;
+
+// Amount of decompressed data discarded at a time when skipping
+size_t const SKIP_SIZE = 64 * 1024;
+
+// Amount of mapped data handed to zlib at a time, and read ahead of it
+size_t const MAPPED_INPUT_SIZE = 1024 * 1024;
+
+// Size of the gzip trailer
+unsigned const TRAILER_SIZE = 8;
+
+} // anonymous namespace
+
+//!
+//! @param	resource	Memory resource that provides the zlib state, or nullptr to use the default allocation. It
+//!                     must outlive the object.
+
+zinflater::zinflater(std::pmr::memory_resource * resource /* = nullptr*/)
+    : file_(nullptr)
+    , mapped_(0)
+    , resource_(resource)
+    , raw_(false)
+    , end_(false)
+    , error_(false)
+    , position_(0)
+    , size_(0)
+    , skipped_(0)
+{
+    zallocator::attach(stream_, resource);
+    stream_.next_in  = Z_NULL;
+    stream_.avail_in = 0;
+}
+
+zinflater::~zinflater()
+{
+    close();
+}
+
+//! @param	name	Name of the file
+//! @param	input	How the compressed data is obtained. Unless it is READ_INPUT, a gzip file must start with a gzip
+//!                 header.
+//! @param	type	Format of the file. If it is AUTO, a zstd or lz4 file is detected from its first bytes, and
+//!                 any other file is treated as a gzip file. The open fails if the detected format is not available.
+//!
+//! @note   Files that are not gzip files are left to gzread(), which passes them through.
+
+bool zinflater::open(char const * name, Input input /* = READ_INPUT*/, zcodec::Type type /* = zcodec::GZIP*/)
+{
+    if (is_open())
+    {
+        return false;
+    }
+
+    stream_.next_in  = Z_NULL;
+    stream_.avail_in = 0;
+
+    // The first bytes of the file identify its format
+    char_type magic[4];
+    size_t    magicSize = 0;
+
+    if (input == MAPPED_INPUT)
+    {
+        if (!mapping_.open(name))
+        {
+            return false;
+        }
+
+        magicSize = std::min(mapping_.size(), sizeof(magic));
+        memcpy(magic, mapping_.data(), magicSize);
+        size_   = off_type(mapping_.size());
+        mapped_ = 0;
+    }
+    else if (input == ASYNC_INPUT)
+    {
+        if (!async_.open(name, false))
+        {
+            return false;
+        }
+
+        magicSize = async_.read(magic, sizeof(magic));
+        size_     = async_.size();
+    }
+    else
+    {
+        file_ = fopen(name, "rb");
+        if (!file_)
+        {
+            return false;
+        }
+
+        // Note the size of the file, so that an index built from a different file can be detected
+        magicSize = fread(magic, 1, sizeof(magic), file_);
+#if defined(_WIN32)
+        _fseeki64(file_, 0, SEEK_END);
+        size_ = _ftelli64(file_);
+#else
+        fseeko(file_, 0, SEEK_END);
+        size_ = ftello(file_);
+#endif
+    }
+
+    if (type == zcodec::AUTO)
+    {
+        zcodec::Type const detected = zcodec::detect(magic, magicSize);
+        type = (detected == zcodec::ZSTD || detected == zcodec::LZ4) ? detected : zcodec::GZIP;
+    }
+
+    // The other formats are decompressed by a codec. It checks the header itself.
+    bool const gzip = (type == zcodec::GZIP);
+    if (!gzip)
+    {
+        codec_ = zcodec::create(type, false, zcodec::Options(), resource_);
+    }
+
+    if ((!gzip && !codec_) ||
+        (gzip && input != READ_INPUT && zcodec::detect(magic, magicSize) != zcodec::GZIP) ||
+        size_ < 0 || !position(0) ||
+        inflateInit2(&stream_, 16 + MAX_WBITS) != Z_OK)
+    {
+        mapping_.close();
+        async_.close();
+        if (file_)
+        {
+            fclose(file_);
+            file_ = nullptr;
+        }
+        codec_.reset();
+        return false;
+    }
+
+    if (input == MAPPED_INPUT)
+    {
+        mapping_.prefetch(0, MAPPED_INPUT_SIZE);
+    }
+    else
+    {
+        input_.resize(INPUT_SIZE);
+    }
+
+    raw_      = false;
+    end_      = false;
+    error_    = false;
+    position_ = 0;
+    return true;
+}
+
+bool zinflater::close()
+{
+    if (!is_open())
+    {
+        return false;
+    }
+
+    inflateEnd(&stream_);
+    bool ok = !error_;
+    if (file_)
+    {
+        ok = (fclose(file_) == 0) && ok;
+        file_ = nullptr;
+    }
+    if (async_.is_open())
+    {
+        ok = async_.close() && ok;
+    }
+    mapping_.close();
+    index_.reset();
+    codec_.reset();
+    return ok;
+}
+
+//!
+//! @param	index	Index of the file
+
+bool zinflater::set_index(std::shared_ptr<zindex const> index)
+{
+    if (index && (codec_ || index->compressed_size() != size_))
+    {
+        return false;
+    }
+
+    index_ = index;
+    return true;
+}
+
+//! @param	s	Where to put the data
+//! @param	n	Maximum number of characters to read
+//!
+//! @note	Like @c gzread(), concatenated gzip members are decompressed as one, and anything following the last member
+//!         that is not a gzip member is ignored.
+
+int zinflater::read(char_type * s, unsigned n)
+{
+    if (!is_open() || error_)
+    {
+        return -1;
+    }
+
+    n = std::min(n, unsigned(INT_MAX));
+    unsigned count = 0;
+
+    while (count < n && !end_)
+    {
+        // If the compressed data runs out before the end of the stream, the file is truncated. A codec may still
+        // hold decompressed data, though.
+        bool const exhausted = (stream_.avail_in == 0 && !refill(1));
+        if (exhausted && !codec_)
+        {
+            error_ = true;
+            break;
+        }
+
+        int status;
+        if (codec_)
+        {
+            char_type const * in      = stream_.next_in;
+            size_t            inSize  = stream_.avail_in;
+            char_type *       out     = s + count;
+            size_t            outSize = n - count;
+            zcodec::Status const result = codec_->decompress(in, inSize, out, outSize);
+            stream_.next_in  = const_cast<Bytef *>(in);
+            stream_.avail_in = uInt(inSize);
+            if (exhausted && result == zcodec::OK && outSize == n - count)
+            {
+                error_ = true;
+                break;
+            }
+            count  = n - unsigned(outSize);
+            status = (result == zcodec::END) ? Z_STREAM_END : (result == zcodec::OK) ? Z_OK : Z_DATA_ERROR;
+        }
+        else
+        {
+            stream_.next_out  = s + count;
+            stream_.avail_out = n - count;
+            status = inflate(&stream_, Z_NO_FLUSH);
+            count  = n - stream_.avail_out;
+        }
+
+        if (status == Z_STREAM_END && codec_)
+        {
+            // If another frame follows, continue with it
+            if (!refill(4) || zcodec::detect(stream_.next_in, stream_.avail_in) != codec_->type() || !codec_->reset())
+            {
+                end_ = true;
+            }
+        }
+        else if (status == Z_STREAM_END)
+        {
+            // Raw deflate data does not include the trailer, so skip it
+            if (raw_)
+            {
+                if (!refill(TRAILER_SIZE))
+                {
+                    error_ = true;
+                    break;
+                }
+                stream_.next_in  += TRAILER_SIZE;
+                stream_.avail_in -= TRAILER_SIZE;
+            }
+
+            // If another gzip member follows, continue with it
+            if (refill(2) && stream_.next_in[0] == 0x1f && stream_.next_in[1] == 0x8b)
+            {
+                inflateReset2(&stream_, 16 + MAX_WBITS);
+                raw_ = false;
+            }
+            else
+            {
+                end_ = true;
+            }
+        }
+        else if (status != Z_OK)
+        {
+            error_ = true;
+            break;
+        }
+    }
+
+    position_ += count;
+    return (count == 0 && error_) ? -1 : int(count);
+}
+
+//!
+//! @param	offset	Offset in the decompressed data
+
+bool zinflater::seek(off_type offset)
+{
+    if (!is_open() || offset < 0)
+    {
+        return false;
+    }
+
+    // Restart from the nearest access point if going backward, or if it is closer than the current position
+    zindex::point const * p = index_ ? index_->locate(offset) : nullptr;
+    if (p && (offset < position_ || p->out > position_))
+    {
+        if (!restart(*p))
+        {
+            return false;
+        }
+    }
+    else if (offset < position_)
+    {
+        if (!rewind())
+        {
+            return false;
+        }
+    }
+
+    skipped_ += offset - position_;
+    return skip(offset - position_);
+}
+
+zinflater::off_type zinflater::offset() const
+{
+    if (mapping_.is_open())
+    {
+        return mapped_ - off_type(stream_.avail_in);
+    }
+    if (async_.is_open())
+    {
+        return async_.tell() - off_type(stream_.avail_in);
+    }
+    if (!file_)
+    {
+        return 0;
+    }
+
+#if defined(_WIN32)
+    off_type const position = _ftelli64(file_);
+#else
+    off_type const position = ftello(file_);
+#endif
+    return (position >= 0) ? position - off_type(stream_.avail_in) : 0;
+}
+
+bool zinflater::rewind()
+{
+    stream_.next_in  = Z_NULL;
+    stream_.avail_in = 0;
+    raw_      = false;
+    end_      = false;
+    error_    = false;
+    position_ = 0;
+
+    if (codec_ && !codec_->reset())
+    {
+        return false;
+    }
+    return position(0) && inflateReset2(&stream_, 16 + MAX_WBITS) == Z_OK;
+}
+
+//!
+//! @param	p	Access point
+
+bool zinflater::restart(zindex::point const & p)
+{
+    stream_.next_in  = Z_NULL;
+    stream_.avail_in = 0;
+    raw_   = true;
+    end_   = false;
+    error_ = true;
+
+    // The access point's data is raw deflate data, and it may start in the middle of a byte
+    if (!position(p.in - (p.bits ? 1 : 0)) || inflateReset2(&stream_, -MAX_WBITS) != Z_OK)
+    {
+        return false;
+    }
+
+    if (p.bits)
+    {
+        int c = next();
+        if (c == EOF || inflatePrime(&stream_, p.bits, c >> (8 - p.bits)) != Z_OK)
+        {
+            return false;
+        }
+    }
+
+    // Provide the data preceding the access point
+    std::vector<char_type> window(zindex::WINDOW_SIZE);
+    if (!index_->window(p, window.data()) ||
+        inflateSetDictionary(&stream_, window.data(), zindex::WINDOW_SIZE) != Z_OK)
+    {
+        return false;
+    }
+
+    error_    = false;
+    position_ = p.out;
+    return true;
+}
+
+//!
+//! @param	n	Number of characters to skip
+
+bool zinflater::skip(off_type n)
+{
+    if (n <= 0)
+    {
+        return true;
+    }
+
+    std::vector<char_type> discard(size_t(std::min(n, off_type(SKIP_SIZE))));
+    while (n > 0)
+    {
+        int count = read(discard.data(), unsigned(std::min(n, off_type(discard.size()))));
+        if (count <= 0)
+        {
+            return false;
+        }
+        n -= count;
+    }
+    return true;
+}
+
+//!
+//! @param	n	Number of characters needed
+
+bool zinflater::refill(unsigned n)
+{
+    if (stream_.avail_in >= n)
+    {
+        return true;
+    }
+
+    // Mapped data is contiguous, so more of it is simply handed to zlib. The system is asked to read the data
+    // after it.
+    if (mapping_.is_open())
+    {
+        size_t const size = std::min(MAPPED_INPUT_SIZE, size_t(size_ - mapped_));
+        if (stream_.avail_in == 0)
+        {
+            stream_.next_in = const_cast<Bytef *>(mapping_.data()) + mapped_;
+        }
+        stream_.avail_in += uInt(size);
+        mapped_          += off_type(size);
+        mapping_.prefetch(size_t(mapped_), MAPPED_INPUT_SIZE);
+
+        return stream_.avail_in >= n;
+    }
+
+    // Move the remaining data to the beginning of the buffer and read more after it
+    if (stream_.avail_in > 0)
+    {
+        memmove(input_.data(), stream_.next_in, stream_.avail_in);
+    }
+    size_t const available = input_.size() - stream_.avail_in;
+    size_t const count     = async_.is_open() ? async_.read(input_.data() + stream_.avail_in, available)
+                                              : fread(input_.data() + stream_.avail_in, 1, available, file_);
+    stream_.next_in   = input_.data();
+    stream_.avail_in += uInt(count);
+
+    return stream_.avail_in >= n;
+}
+
+//!
+//! @param	offset	Offset in the file
+
+bool zinflater::position(off_type offset)
+{
+    if (mapping_.is_open())
+    {
+        if (offset > size_)
+        {
+            return false;
+        }
+        mapped_ = offset;
+        return true;
+    }
+    if (async_.is_open())
+    {
+        return async_.seek(offset);
+    }
+
+#if defined(_WIN32)
+    return _fseeki64(file_, offset, SEEK_SET) == 0;
+#else
+    return fseeko(file_, offset, SEEK_SET) == 0;
+#endif
+}
+
+int zinflater::next()
+{
+    if (mapping_.is_open())
+    {
+        return (mapped_ < size_) ? mapping_.data()[mapped_++] : EOF;
+    }
+    if (async_.is_open())
+    {
+        char_type c;
+        return (async_.read(&c, 1) == 1) ? c : EOF;
+    }
+    return getc(file_);
+}
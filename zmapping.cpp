@@ -0,0 +1,164 @@
+/** @file *//********************************************************************************************************
+
+                                                    zmapping.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zmapping.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zmapping.h"
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+zmapping::zmapping()
+    : data_(nullptr)
+    , size_(0)
+#if defined(_WIN32)
+    , mapping_(nullptr)
+#endif
+{
+}
+
+zmapping::~zmapping()
+{
+    close();
+}
+
+//!
+//! @param	name	Name of the file
+
+bool zmapping::open(char const * name)
+{
+    if (data_)
+    {
+        return false;
+    }
+
+#if defined(_WIN32)
+
+    HANDLE file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || (unsigned long long)size.QuadPart > SIZE_MAX)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    // The mapping object keeps the file open
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping)
+    {
+        return false;
+    }
+
+    void * data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    mapping_ = mapping;
+    data_    = static_cast<char_type const *>(data);
+    size_    = size_t(size.QuadPart);
+
+#else // defined(_WIN32)
+
+    int file = ::open(name, O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size <= 0 ||
+        (unsigned long long)status.st_size > SIZE_MAX)
+    {
+        ::close(file);
+        return false;
+    }
+
+    // The mapping keeps the file open
+    void * data = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // The file is read from beginning to end, so aggressive read-ahead pays off
+    madvise(data, size_t(status.st_size), MADV_SEQUENTIAL);
+
+    data_ = static_cast<char_type const *>(data);
+    size_ = size_t(status.st_size);
+
+#endif // defined(_WIN32)
+
+    return true;
+}
+
+void zmapping::close()
+{
+    if (!data_)
+    {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    mapping_ = nullptr;
+#else
+    munmap(const_cast<char_type *>(data_), size_);
+#endif
+
+    data_ = nullptr;
+    size_ = 0;
+}
+
+//! @param	offset	Offset of the range
+//! @param	size	Size of the range
+//!
+//! @note	This is only a hint, so it does nothing on systems that do not support it.
+
+void zmapping::prefetch(size_t offset, size_t size) const
+{
+    if (!data_ || offset >= size_)
+    {
+        return;
+    }
+    if (size > size_ - offset)
+    {
+        size = size_ - offset;
+    }
+
+#if defined(_WIN32)
+    (void)size;
+#else
+    // The address must be aligned to a page
+    size_t const page    = size_t(sysconf(_SC_PAGESIZE));
+    size_t const aligned = offset / page * page;
+    madvise(const_cast<char_type *>(data_) + aligned, size + (offset - aligned), MADV_WILLNEED);
+#endif
+}
@@ -0,0 +1,437 @@
+/** @file *//********************************************************************************************************
+
+                                                    zmembers.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zmembers.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zmembers.h"
+
+#include "zallocator.h"
+#include "zlib/zlib.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace
+{
+
+// Smallest possible gzip member: a 10-byte header, an empty deflate block, and an 8-byte trailer
+size_t const MIN_MEMBER_SIZE = 20;
+
+// Initial size of the buffer receiving a member's decompressed data
+size_t const INITIAL_OUTPUT_SIZE = 256 * 1024;
+
+// Amount of data decompressed at a time when skipping data to seek
+size_t const SKIP_SIZE = 64 * 1024;
+
+} // anonymous namespace
+
+zmembers::Job::Job(size_t start)
+    : start(start)
+    , end(0)
+    , status(PENDING)
+    , cancelled(false)
+{
+}
+
+zmembers::Job::~Job()
+{
+    if (status == PARTIAL)
+    {
+        inflateEnd(&stream);
+    }
+}
+
+//! @param	threads         Number of worker threads. If 0, the number of hardware threads is used.
+//! @param	maxMemberSize   Limit on the decompressed data held for a member. Up to about two jobs per thread are in
+//!                         flight, so this bounds the memory in use.
+//! @param	resource        Memory resource that provides the zlib state, or nullptr to use the default allocation.
+//!                         It is used by several threads, so it must be thread-safe.
+
+zmembers::zmembers(unsigned                    threads,
+                   size_t                      maxMemberSize /* = DEFAULT_MAX_MEMBER_SIZE*/,
+                   std::pmr::memory_resource * resource /* = nullptr*/)
+    : threads_((threads > 0) ? threads : std::max(std::thread::hardware_concurrency(), 1u))
+    , maxMemberSize_(std::max(maxMemberSize, INITIAL_OUTPUT_SIZE))
+    , resource_(resource)
+    , maxPending_(threads_ * 2 + 1)
+    , next_(0)
+    , scan_(0)
+    , consumed_(0)
+    , position_(0)
+    , skipped_(0)
+    , error_(false)
+    , stop_(false)
+{
+}
+
+zmembers::~zmembers()
+{
+    close();
+}
+
+//!
+//! @param	name	Name of the file
+
+bool zmembers::open(char const * name)
+{
+    if (is_open())
+    {
+        return false;
+    }
+
+    if (!mapping_.open(name) || !isHeader(0))
+    {
+        mapping_.close();
+        return false;
+    }
+
+    position_ = 0;
+    skipped_  = 0;
+    start();
+    return true;
+}
+
+bool zmembers::close()
+{
+    if (!is_open())
+    {
+        return false;
+    }
+
+    stop();
+    mapping_.close();
+    return !error_;
+}
+
+//! @param	s   Where to put the data
+//! @param	n   Maximum number of characters to read
+
+int zmembers::read(char_type * s, unsigned n)
+{
+    if (!is_open() || error_)
+    {
+        return -1;
+    }
+
+    n = std::min(n, unsigned(INT_MAX));
+
+    size_t total = 0;
+    while (total < n)
+    {
+        if (current_)
+        {
+            // Return the data decompressed by the job first
+            std::vector<char_type> const & output = current_->output;
+            if (consumed_ < output.size())
+            {
+                size_t const size = std::min(size_t(n) - total, output.size() - consumed_);
+                memcpy(s + total, output.data() + consumed_, size);
+                consumed_ += size;
+                total     += size;
+                continue;
+            }
+
+            // If the member is larger than the limit, decompress the rest of it directly
+            if (current_->status == PARTIAL)
+            {
+                z_stream & stream = current_->stream;
+                stream.next_out  = s + total;
+                stream.avail_out = uInt(n - total);
+                supply(stream);
+
+                int const status = inflate(&stream, Z_NO_FLUSH);
+                total = n - stream.avail_out;
+                if (status == Z_STREAM_END)
+                {
+                    next_ = size_t(stream.next_in - mapping_.data());
+                    current_.reset();
+                }
+                else if (status != Z_OK)
+                {
+                    error_ = true;
+                    break;
+                }
+                continue;
+            }
+
+            current_.reset();
+        }
+
+        if (!advance())
+        {
+            break;
+        }
+    }
+
+    position_ += off_type(total);
+    return (total == 0 && error_) ? -1 : int(total);
+}
+
+//!
+//! @param	offset	Offset in the decompressed data
+
+bool zmembers::seek(off_type offset)
+{
+    if (!is_open() || offset < 0)
+    {
+        return false;
+    }
+
+    // The members cannot be located without decompressing the ones before them, so go back to the beginning
+    if (offset < position_)
+    {
+        stop();
+        position_ = 0;
+        start();
+    }
+
+    std::vector<char_type> discard(SKIP_SIZE);
+    while (position_ < offset)
+    {
+        int const count = read(discard.data(), unsigned(std::min(off_type(SKIP_SIZE), offset - position_)));
+        if (count <= 0)
+        {
+            return false;
+        }
+        skipped_ += count;
+    }
+    return true;
+}
+
+zmembers::off_type zmembers::offset() const
+{
+    if (current_ && current_->status == PARTIAL)
+    {
+        return off_type(current_->stream.next_in - mapping_.data()) - off_type(current_->stream.avail_in);
+    }
+    return off_type(next_);
+}
+
+//!
+//! @param	offset	Offset in the file
+
+bool zmembers::isHeader(size_t offset) const
+{
+    // ID1, ID2, CM (deflate), and FLG with the reserved bits clear
+    if (mapping_.size() < MIN_MEMBER_SIZE || offset > mapping_.size() - MIN_MEMBER_SIZE)
+    {
+        return false;
+    }
+    char_type const * p = mapping_.data() + offset;
+    return p[0] == 0x1f && p[1] == 0x8b && p[2] == Z_DEFLATED && (p[3] & 0xe0) == 0;
+}
+
+void zmembers::schedule()
+{
+    auto add = [this] (size_t offset) {
+        std::shared_ptr<Job> job(new Job(offset));
+        jobs_[offset] = job;
+        queue_.push_back(job);
+    };
+
+    // The member being read is always needed
+    if (jobs_.count(next_) == 0 && isHeader(next_))
+    {
+        add(next_);
+    }
+    scan_ = std::max(scan_, next_ + 1);
+
+    // Start on the following members
+    char_type const * data = mapping_.data();
+    size_t const      size = mapping_.size();
+    while (jobs_.size() < maxPending_ && scan_ < size)
+    {
+        void const * found = memchr(data + scan_, 0x1f, size - scan_);
+        if (!found)
+        {
+            scan_ = size;
+            break;
+        }
+
+        size_t const offset = size_t(static_cast<char_type const *>(found) - data);
+        scan_ = offset + 1;
+        if (isHeader(offset))
+        {
+            add(offset);
+        }
+    }
+
+    jobReady_.notify_all();
+}
+
+bool zmembers::advance()
+{
+    std::shared_ptr<Job> job;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        // Jobs before the next member started at data that looked like a header but was inside a member
+        while (!jobs_.empty() && jobs_.begin()->first < next_)
+        {
+            jobs_.begin()->second->cancelled = true;
+            jobs_.erase(jobs_.begin());
+        }
+
+        // Like zlib, anything following the last member that is not a gzip header is ignored
+        if (!isHeader(next_))
+        {
+            return false;
+        }
+
+        schedule();
+        job = jobs_[next_];
+        jobDone_.wait(lock, [&job] { return job->status != PENDING; });
+        jobs_.erase(next_);
+        schedule();
+    }
+
+    if (job->status == FAILED)
+    {
+        error_ = true;
+        return false;
+    }
+
+    current_  = job;
+    consumed_ = 0;
+    if (job->status == DONE)
+    {
+        next_ = job->end;
+    }
+    return true;
+}
+
+//!
+//! @param	stream	Stream to supply
+
+void zmembers::supply(z_stream & stream) const
+{
+    if (stream.avail_in == 0)
+    {
+        size_t const offset = size_t(stream.next_in - mapping_.data());
+        stream.avail_in = uInt(std::min(mapping_.size() - offset, size_t(UINT_MAX)));
+    }
+}
+
+void zmembers::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        for (auto & job : jobs_)
+        {
+            job.second->cancelled = true;
+        }
+    }
+    jobReady_.notify_all();
+    for (auto & worker : workers_)
+    {
+        worker.join();
+    }
+    workers_.clear();
+
+    jobs_.clear();
+    queue_.clear();
+    current_.reset();
+}
+
+void zmembers::start()
+{
+    next_     = 0;
+    scan_     = 0;
+    consumed_ = 0;
+    error_    = false;
+    stop_     = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        schedule();
+    }
+    for (unsigned i = 0; i < threads_; ++i)
+    {
+        workers_.emplace_back(&zmembers::worker, this);
+    }
+}
+
+void zmembers::worker()
+{
+    z_stream stream;
+    zallocator::attach(stream, resource_);
+    stream.next_in  = Z_NULL;
+    stream.avail_in = 0;
+    bool const ok = (inflateInit2(&stream, 16 + MAX_WBITS) == Z_OK);
+
+    for (;;)
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            jobReady_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (stop_)
+            {
+                break;
+            }
+            job = queue_.front();
+            queue_.pop_front();
+        }
+
+        Status status = FAILED;
+        if (ok && !job->cancelled && inflateReset(&stream) == Z_OK)
+        {
+            std::vector<char_type> & output = job->output;
+            size_t used = 0;
+
+            stream.next_in  = const_cast<Bytef *>(mapping_.data()) + job->start;
+            stream.avail_in = 0;
+
+            while (!job->cancelled)
+            {
+                if (used == output.size())
+                {
+                    // At the limit, the reader takes over the decompression
+                    if (used >= maxMemberSize_)
+                    {
+                        status = (inflateCopy(&job->stream, &stream) == Z_OK) ? PARTIAL : FAILED;
+                        break;
+                    }
+                    output.resize(std::min(std::max(used * 2, INITIAL_OUTPUT_SIZE), maxMemberSize_));
+                }
+
+                stream.next_out  = output.data() + used;
+                stream.avail_out = uInt(output.size() - used);
+                supply(stream);
+
+                // zlib checks the CRC and size in the trailer
+                int const result = inflate(&stream, Z_NO_FLUSH);
+                used = output.size() - stream.avail_out;
+                if (result == Z_STREAM_END)
+                {
+                    output.resize(used);
+                    job->end = size_t(stream.next_in - mapping_.data());
+                    status   = DONE;
+                    break;
+                }
+                if (result != Z_OK)
+                {
+                    break;
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job->status = status;
+        }
+        jobDone_.notify_all();
+    }
+
+    inflateEnd(&stream);
+}
@@ -13,22 +13,53 @@
 
 #include "zmembuf.h"
 
+#include "zbytes.h"
+#include "zstatsmacros.h"
 #include "zlib/zlib.h"
 
 #include <algorithm>
-#include <cassert>
+#include <climits>
+#include <cstring>
 #include <streambuf>
+#include <string>
 #include <vector>
 
+namespace
+{
+
+// Largest ratio of uncompressed to compressed size that is trusted when the size recorded in the data is used to
+// allocate the output. deflate cannot do better than about 1032:1, so a larger size is probably wrong.
+size_t const MAX_TRUSTED_RATIO = 1032;
+
+// Decompressed size assumed when it is unknown, as a multiple of the compressed size
+size_t const ASSUMED_RATIO = 4;
+
+// Smallest amount by which the output of zdecompress() grows, and the least unused room that is given back
+size_t const MIN_GROWTH = 64 * 1024;
+
+} // anonymous namespace
+
 //! @param	mode	Direction of the stream
 //!					- <tt>std::ios_base::in</tt> signifies an input buffer. Data is decompressed as it is streamed
 //!						from of this buffer. You must initialize the contents of the buffer before streaming.
 //!					- <tt>std::ios_base::out</tt> signifies an ouput buffer. Data is compressed as it is streamed
 //!						to this buffer. The buffer will grow as data is streamed to it.
-
-zmembuf::zmembuf(std::ios_base::openmode mode)
+//! @param	resource	Memory resource that provides the zlib state, or nullptr to use zlib's default allocation. It
+//!                     must outlive the buffer.
+
+template <class CharT, class Traits, class Container>
+basic_zmembuf<CharT, Traits, Container>::basic_zmembuf(std::ios_base::openmode     mode,
+                                                       std::pmr::memory_resource * resource /* = nullptr*/)
+    : resource_(resource)
+    , state_(0)
+    , type_(zcodec::AUTO)
+    , flushPolicy_(zflushpolicy::NO_FLUSH)
+    , skipIncompressible_(false)
+    , storing_(false)
+    , failed_(false)
+    , runningChecksum_(false)
 {
-    initialize(container_type(), streamState(mode));
+    initialize(nullptr, 0, streamState(mode), true);
 }
 
 //! @param	data	Initial contents of the buffer.
@@ -37,11 +68,23 @@ zmembuf::zmembuf(std::ios_base::openmode mode)
 //!						are streamed from the buffer.
 //!					- <tt>std::ios_base::out</tt> signifies an ouput buffer. Data streamed to this buffer is
 //!						compressed and appended to the initial contents.
-
-zmembuf::zmembuf(container_type const &  data,
-                 std::ios_base::openmode mode)
+//! @param	resource	Memory resource that provides the zlib state, or nullptr to use zlib's default allocation. It
+//!                     must outlive the buffer.
+
+template <class CharT, class Traits, class Container>
+basic_zmembuf<CharT, Traits, Container>::basic_zmembuf(container_type const &      data,
+                                                        std::ios_base::openmode     mode,
+                                                        std::pmr::memory_resource * resource /* = nullptr*/)
+    : resource_(resource)
+    , state_(0)
+    , type_(zcodec::AUTO)
+    , flushPolicy_(zflushpolicy::NO_FLUSH)
+    , skipIncompressible_(false)
+    , storing_(false)
+    , failed_(false)
+    , runningChecksum_(false)
 {
-    initialize(data, streamState(mode));
+    initialize(data.data(), data.size(), streamState(mode), true);
 }
 
 //! @param	data	Initial contents of the buffer.
@@ -51,68 +94,228 @@ zmembuf::zmembuf(container_type const &  data,
 //!						are streamed from the buffer.
 //!					- <tt>std::ios_base::out</tt> signifies an ouput buffer. Data streamed to this buffer is
 //!						compressed and appended to the initial contents.
-
-zmembuf::zmembuf(char_type const * data, size_t size, std::ios_base::openmode mode)
+//! @param	resource	Memory resource that provides the zlib state, or nullptr to use zlib's default allocation. It
+//!                     must outlive the buffer.
+
+template <class CharT, class Traits, class Container>
+basic_zmembuf<CharT, Traits, Container>::basic_zmembuf(char_type const *           data,
+                                                        size_t                      size,
+                                                        std::ios_base::openmode     mode,
+                                                        std::pmr::memory_resource * resource /* = nullptr*/)
+    : resource_(resource)
+    , state_(0)
+    , type_(zcodec::AUTO)
+    , flushPolicy_(zflushpolicy::NO_FLUSH)
+    , skipIncompressible_(false)
+    , storing_(false)
+    , failed_(false)
+    , runningChecksum_(false)
 {
-    initialize(container_type(data, data + size), mode);
+    initialize(data, size, streamState(mode), true);
 }
 
-zmembuf::~zmembuf()
+template <class CharT, class Traits, class Container>
+basic_zmembuf<CharT, Traits, Container>::~basic_zmembuf()
 {
     tidy();
 }
 
 //! @warning	The returned data is valid only until the next operation on the buffer.
-//! @note		This function forces zlib to flush its buffers. Frequent calls to this function will degrade
-//!				performance.
+//! @note		For an input buffer using borrowed data, the returned container is empty.
+//! @note		For an output buffer, this function finishes the compressed data, so nothing more can be written to
+//!				it until its contents are replaced.
 
-zmembuf::container_type const & zmembuf::buffer() const
+template <class CharT, class Traits, class Container>
+typename basic_zmembuf<CharT, Traits, Container>::container_type const &
+basic_zmembuf<CharT, Traits, Container>::buffer() const
 {
-    // Make sure the buffer is synced before giving access to it.
-    sync();
+    // Make sure all the output is compressed before giving access to it. Finishing only changes the internal
+    // state, not the contents as seen by the caller.
+    if (state_ & WO_BIT)
+    {
+        const_cast<basic_zmembuf *>(this)->finish();
+    }
 
     return data_;
 }
 
-//!
 //! @param	data	Data replacing the current contents of the buffer.
+//!
+//! @note	The zlib state and the storage of the buffer are reused.
 
-void zmembuf::buffer(container_type const & data)
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::buffer(container_type const & data)
 {
-    tidy();
-    initialize(data, state_);
+    buffer(data.data(), data.size());
 }
 
 //! @param	data	Data replacing the current contents of the buffer.
 //! @param	size		size of the data (in bytes)
+//!
+//! @note	The zlib state and the storage of the buffer are reused.
 
-void zmembuf::buffer(char_type const * data, size_t size)
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::buffer(char_type const * data, size_t size)
 {
-    tidy();
-    initialize(container_type(&data[0], &data[size]), state_);
+    if (data != data_.data())
+    {
+        data_.assign(data, data + size);
+    }
+    restart(bytes(data_.data()), data_.size());
+}
+
+//! @param	data	Compressed data to decompress. It is not copied, so it must remain valid and unchanged until it
+//!                 is replaced or this object is destroyed.
+//! @param	size	Size of the data (in bytes)
+//!
+//! @note	For an output buffer, the data is copied because it becomes the beginning of the output.
+//! @note	The zlib state is reused.
+
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::borrow(char_type const * data, size_t size)
+{
+    if (state_ & WO_BIT)
+    {
+        buffer(data, size);
+        return;
+    }
+
+    data_.clear();
+    restart(bytes(data), size);
+}
+
+//! @note	The zlib state, the window, and the storage of the buffer are kept, so the buffer can be reused for the
+//!         next message without allocating. The compression level is also kept.
+
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::reset()
+{
+    data_.clear();
+    restart(bytes(data_.data()), 0);
+}
+
+//! @note    For an output buffer, the compressed data is finished first. The buffer is then ready for the next
+//!          message, reusing the zlib state and the window.
+
+template <class CharT, class Traits, class Container>
+typename basic_zmembuf<CharT, Traits, Container>::container_type
+basic_zmembuf<CharT, Traits, Container>::release()
+{
+    container_type data;
+    release(data);
+    return data;
 }
 
+//! @param	data	Receives the contents of the buffer. Its previous contents are discarded, but its storage is
+//!                 reused for the next output, so passing the same container each time avoids reallocating.
 //!
-//! @param	level	Compression level. 0 is no compression, 9 is maximum compression.
+//! @note    For an output buffer, the compressed data is finished first. The buffer is then ready for the next
+//!          message, reusing the zlib state and the window.
 
-void zmembuf::set_compression(int level)
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::release(container_type & data)
 {
-    if (level < 0)
+    if (state_ & WO_BIT)
     {
-        level = 0;
+        finish();
     }
-    else if (level > 9)
+
+    data.swap(data_);
+    reset();
+}
+
+//!
+//! @param	level	Compression level. For zlib, 0 is no compression and 9 is maximum compression. See zcodec::Options
+//!                 for the other codecs. zcodec::DEFAULT_LEVEL (Z_DEFAULT_COMPRESSION) selects the codec's default.
+
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::set_compression(int level)
+{
+    options_.level = level;
+
+    // Buffered output is compressed with the old level
+    if (!(state_ & WO_BIT) || !compressBuffer(zcodec::NO_FLUSH) || !codec_)
     {
-        level = 9;
+        return;
     }
 
-    deflateParams(&stream_, level, Z_DEFAULT_STRATEGY);
+    // The codec applies the level to the data that follows, even if the output is being stored. The next write is
+    // judged again.
+    codec_->set_level(level);
+    storing_ = false;
+}
+
+//! @param	type	Format. For an input buffer, AUTO detects it from the data, and zlib is assumed if it is not
+//!                 recognized. For an output buffer, AUTO selects zlib.
+//! @param	options	Settings of the compressor (the level replaces the one set by set_compression())
+//!
+//! @note   For an input buffer, decompression restarts at the beginning of the data.
+//! @note   For an output buffer, this must be called before anything is written. Otherwise, it takes effect when the
+//!         output is released or replaced.
+
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::set_codec(zcodec::Type            type,
+                                                        zcodec::Options const & options /* = zcodec::Options()*/)
+{
+    // The codec is kept if only the level or the strategy changes, because those are applied when it restarts
+    bool const same = type == type_ && options.window == options_.window && options.checksum == options_.checksum &&
+                      options.dictionary == options_.dictionary;
+
+    type_    = type;
+    options_ = options;
+
+    if (state_ & RO_BIT)
+    {
+        if (!same)
+        {
+            codec_.reset();
+        }
+        rewind();
+    }
+    else if (position_ == 0 && !end_ && (this->pbase() == nullptr || this->pptr() == this->pbase()))
+    {
+        if (!same)
+        {
+            codec_.reset();
+        }
+        prepare(nullptr, 0);
+    }
+}
+
+//! @param	adaptive	True to enable adaptive compression
+//! @param	target		What the controller aims for
+//!
+//! @note   An input buffer ignores this.
+
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::set_adaptive(bool                       adaptive,
+                                                           zadaptive::Target const & target /* = zadaptive::Target()*/)
+{
+    controller_.reset((adaptive && (state_ & WO_BIT)) ? new zadaptive(target, options_.level) : nullptr);
+}
+
+//! @param	dictionary	Dictionary shared by the messages, or nullptr for none. It is used for every message after a
+//!                     reset or release, so it is set only once.
+//!
+//! @note   Like set_codec(), this restarts decompression at the beginning of the data, and for an output buffer, it
+//!         must be called before anything is written.
+//! @note   The format must support dictionaries (zlib, raw deflate, or zstd). Otherwise, the data cannot be
+//!         compressed or decompressed.
+
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::set_dictionary(std::shared_ptr<zdictionary const> dictionary)
+{
+    zcodec::Options options = options_;
+    options.dictionary = std::move(dictionary);
+    set_codec(type_, options);
 }
 
 //!
 //! @param	meta	Value to put into the buffer
 
-zmembuf::int_type zmembuf::overflow(int_type meta /* = traits_type::eof()*/)
+template <class CharT, class Traits, class Container>
+typename basic_zmembuf<CharT, Traits, Container>::int_type
+basic_zmembuf<CharT, Traits, Container>::overflow(int_type meta /* = traits_type::eof()*/)
 {
     // If the character to store is EOF, then do nothing and return success
     if (traits_type::eof() == meta)
@@ -126,19 +329,16 @@ zmembuf::int_type zmembuf::overflow(int_type meta /* = traits_type::eof()*/)
         return traits_type::eof();
     }
 
-    // Otherwise, add the value to the data
+    // Otherwise, compress the contents of the put area to make room and add the value
     else
     {
-        // First make sure that any unprocessed data has been processed
-        flushInput();
-
-        // Send the value to the compressor
-        Bytef c = (char_type)meta;
-        stream_.next_in  = &c;
-        stream_.avail_in = sizeof(c);
+        if (!compressBuffer(zcodec::NO_FLUSH))
+        {
+            return traits_type::eof();
+        }
 
-        grow(sizeof(c) + 1);
-        deflate(&stream_, 0);
+        *this->pptr() = traits_type::to_char_type(meta);
+        this->pbump(1);
 
         return meta;
     }
@@ -149,98 +349,136 @@ zmembuf::int_type zmembuf::overflow(int_type meta /* = traits_type::eof()*/)
 //!
 //! @note	The character put back becomes the current character
 
-zmembuf::int_type zmembuf::pbackfail(int_type meta /* = traits_type::eof()*/)
+template <class CharT, class Traits, class Container>
+typename basic_zmembuf<CharT, Traits, Container>::int_type
+basic_zmembuf<CharT, Traits, Container>::pbackfail(int_type meta /* = traits_type::eof()*/)
 {
-    // If there is a input buffer and there is data before the current position, and meta is EOF or the same as
-    // the previous character in the input buffer, just back up the current position
-    if (!gptr() && eback() < gptr() &&
-        (meta == traits_type::eof() || int_type(gptr() [-1]) == meta))
-    {
-        _Gndec();
-        return traits_type::not_eof(meta);
-    }
-
-    // Otherwise, if the file isn't open or a EOF is put back return error.
-    else if (meta == traits_type::eof())
+    // If there is no data before the current position, then nothing can be put back
+    if (this->gptr() == nullptr || this->gptr() <= this->eback())
     {
         return traits_type::eof();
     }
 
-    // Otherwise, put the data in the putback buffer
-    else
+    // If meta is EOF or the same as the previous character in the input buffer, just back up the current position
+    if (meta == traits_type::eof() || traits_type::to_int_type(this->gptr()[-1]) == meta)
     {
-        putback_ = char_type(meta);
-        setg(&putback_, &putback_, &putback_ + 1);
-
-        return meta;
+        this->gbump(-1);
+        return traits_type::not_eof(meta);
     }
+
+    // Otherwise, replace the previous character (the get area is always in the window)
+    this->gbump(-1);
+    *this->gptr() = traits_type::to_char_type(meta);
+    return meta;
 }
 
-std::streamsize zmembuf::showmanyc()
+template <class CharT, class Traits, class Container>
+std::streamsize basic_zmembuf<CharT, Traits, Container>::showmanyc()
 {
-    if (!gptr())
+    if (this->gptr() < this->egptr())
     {
-        return egptr() - gptr();
+        return this->egptr() - this->gptr();
     }
     else
     {
-        return 0;
+        return end_ ? -1 : 0;
     }
 }
 
-zmembuf::int_type zmembuf::underflow()
+template <class CharT, class Traits, class Container>
+typename basic_zmembuf<CharT, Traits, Container>::int_type
+basic_zmembuf<CharT, Traits, Container>::underflow()
 {
-    int_type meta;
-
-    // If there is data in the input buffer, get it without incrementing the pointer
-    if (!gptr() && gptr() < egptr())
+    // If there is data in the input buffer, get it without incrementing the pointer. Otherwise, decompress more.
+    if (this->gptr() < this->egptr() || fill())
     {
-        meta = int_type(*gptr());
+        return traits_type::to_int_type(*this->gptr());
     }
 
-    // Otherwise, get a byte from zlib
+    return traits_type::eof();
+}
 
-    else
-    {
-        meta = uflow();
+//! @param	s	buffer to store streamed data
+//! @param	n	Number of uncompressed bytes to get
+//!
+//! @note   Data already decompressed into the window is returned first. Requests that are larger than the window
+//!         are then decompressed directly into @p s.
+
+template <class CharT, class Traits, class Container>
+std::streamsize basic_zmembuf<CharT, Traits, Container>::xsgetn(char_type * s, std::streamsize n)
+{
+    std::streamsize total = 0;
 
-        // If it did not fail, the put the byte back
-        if (meta != traits_type::eof())
+    while (total < n)
+    {
+        // If there is data in the get area, return it first.
+        std::streamsize available = this->egptr() - this->gptr();
+        if (available > 0)
         {
-            pbackfail(meta);
+            std::streamsize size = std::min(available, n - total);
+            memcpy(s + total, this->gptr(), size_t(size));
+            this->setg(this->eback(), this->gptr() + size, this->egptr());
+            total += size;
         }
-    }
 
-    return meta;
-}
+        // Otherwise, if the rest will not fit in the window, decompress it straight into the caller's memory
+        else if (n - total >= std::streamsize(WINDOW_SIZE))
+        {
+            std::streamsize count = decompress(s + total, n - total);
+            if (count <= 0)
+            {
+                break;
+            }
+            total += count;
+            savePutback(s + total, total);
+        }
 
-//! @param	s	buffer to store streamed data
-//! @param	n	Number of uncompressed bytes to get
+        // Otherwise, refill the window
+        else if (!fill())
+        {
+            break;
+        }
+    }
 
-std::streamsize zmembuf::xsgetn(char_type * s, std::streamsize n)
-{
-    return n;
+    return total;
 }
 
 //! @param	s	Uncompressed data to put
 //! @param	n	Number of uncompressed bytes to put
+//!
+//! @note   Small writes are collected in the put area. Writes that are larger than the put area are compressed
+//!         directly from @p s.
 
-std::streamsize zmembuf::xsputn(char_type const * s, std::streamsize n)
+template <class CharT, class Traits, class Container>
+std::streamsize basic_zmembuf<CharT, Traits, Container>::xsputn(char_type const * s, std::streamsize n)
 {
-    // First make sure that any unprocessed data has been processed
-    flushInput();
+    if (n <= 0)
+    {
+        return 0;
+    }
+
+    // If the data fits in the put area, just copy it
+    if (n <= this->epptr() - this->pptr())
+    {
+        memcpy(this->pptr(), s, size_t(n));
+        this->pbump(int(n));
+        return n;
+    }
 
-    // Send the data to zlib
-    while (n > 0)
+    // Otherwise, make room by compressing the contents of the put area
+    if ((state_ & RO_BIT) || !compressBuffer(zcodec::NO_FLUSH))
     {
-        uInt block = (uInt)std::min(n, (std::streamsize)std::numeric_limits<uInt>::max());
-        stream_.next_in  = s;
-        stream_.avail_in = block;
-        grow(block + 1);
-        deflate(&stream_, 0);
-        n -= block;
+        return 0;
     }
 
+    // If the data will not fit in the put area, then compress it directly
+    if (n >= std::streamsize(WINDOW_SIZE))
+    {
+        return compress(s, size_t(n), zcodec::NO_FLUSH) ? n : 0;
+    }
+
+    memcpy(this->pptr(), s, size_t(n));
+    this->pbump(int(n));
     return n;
 }
 
@@ -252,96 +490,97 @@ std::streamsize zmembuf::xsputn(char_type const * s, std::streamsize n)
 //! @note	There are restrictions imposed by @c zlib:
 //!				-#	<tt>std::ios_base::end</tt> is not supported as a start location
 //!				-#	Only forward seeks are allowed in output buffers
+//!				-#	Seeking backwards past the window in an input buffer restarts decompression from the beginning
 
-zmembuf::pos_type zmembuf::seekoff(off_type                off,
-                                   std::ios_base::seekdir  way,
-                                   std::ios_base::openmode which /* = std::ios_base::in | std::ios_base::out*/)
+template <class CharT, class Traits, class Container>
+typename basic_zmembuf<CharT, Traits, Container>::pos_type
+basic_zmembuf<CharT, Traits, Container>::seekoff(off_type                off,
+                                                 std::ios_base::seekdir  way,
+                                                 std::ios_base::openmode which /* = std::ios_base::in | std::ios_base::out*/)
 {
     pos_type _Pos;
 
-    // Make sure all output is done before trying to position the pointer
-
-    sync();
-
-    // position within read buffer
-
-    if (!gptr())
+    // Position within the decompressed data
+    if (state_ & RO_BIT)
     {
-        if (way == std::ios_base::end)
-        {
-            off = std::_BADOFF;
-        }
-        else if (way == std::ios_base::cur)
+        off_type const windowStart = position_ - off_type(this->egptr() - this->eback());
+        off_type const current     = windowStart + off_type(this->gptr() - this->eback());
+
+        if (way == std::ios_base::cur)
         {
-            off += off_type(gptr() - eback());
+            off += windowStart + off_type(this->gptr() - this->eback());
         }
-        else if (way == std::ios_base::beg)
+        else if (way != std::ios_base::beg)
         {
+            return pos_type(off_type(-1));
         }
-        else
+
+        if (off < 0)
         {
-            off = std::_BADOFF;
+            return pos_type(off_type(-1));
         }
 
-        // change read position
-        if (0 <= off && off <= egptr() - eback())
+        // If the target is before the window, then decompression must start over
+        if (off < windowStart)
         {
-            gbump((int)(eback() + off - gptr()));
+            rewind();
         }
-        else
+
+        // Decompress (and discard) data until the target is in the window
+        off_type const start = position_;
+        while (off > position_)
         {
-            off = std::_BADOFF;
+            if (!fill())
+            {
+                return pos_type(off_type(-1));
+            }
         }
+
+        ZSTATS_ADD(stats_.seeks, off != current);
+        ZSTATS_ADD(stats_.seekBytes, position_ - start);
+
+        this->setg(this->eback(), this->egptr() - (position_ - off), this->egptr());
+        _Pos = pos_type(off);
     }
 
     // Otherwise, if this is a write buffer, position the pointer
-    else if (pptr() != 0)
+    else
     {
-        // Figure out the offset from the beginning of the buffer and adjust off so that it is the number of bytes
-        // from the current position.
+        off_type const current = position_ + off_type(this->pptr() - this->pbase());
 
+        // Figure out the offset from the current position
         if (way == std::ios_base::beg)
         {
-            _Pos = pos_type(off);
-            off -= off_type(stream_.total_out);
+            off -= current;
         }
-        else if (way == std::ios_base::cur)
+        else if (way != std::ios_base::cur)
         {
-            _Pos = pos_type(off + off_type(stream_.total_out));
-            off += 0;
+            return pos_type(off_type(-1));
         }
-        else
+
+        // Only forward seeks are allowed
+        if (off < 0)
         {
-            _Pos = pos_type(std::_BADOFF);
-            off  = -1;
+            return pos_type(off_type(-1));
         }
 
-        // Change write position by inserting off bytes of zeroe. Only forward seeks are allowed.
-        if (0 <= off)
+        // Change write position by inserting off bytes of zeros
+        _Pos = pos_type(current + off);
+        ZSTATS_ADD(stats_.seeks, off > 0);
+        ZSTATS_ADD(stats_.seekBytes, off);
+        while (off > 0)
         {
-            // Send off bytes of dummy data to zlib
-
-            grow(off + 1);
-            while (off > 0)
+            if (this->pptr() == this->epptr() && !compressBuffer(zcodec::NO_FLUSH))
             {
-                Bytef dummy = 0;
-                stream_.next_in  = &dummy;
-                stream_.avail_in = 1;
-
-                deflate(&stream_, 0);
-
-                --off;
+                return pos_type(off_type(-1));
             }
-        }
-        else
-        {
-            _Pos = pos_type(std::_BADOFF);
+
+            std::streamsize size = std::min(std::streamsize(off), std::streamsize(this->epptr() - this->pptr()));
+            memset(this->pptr(), 0, size_t(size));
+            this->pbump(int(size));
+            off -= size;
         }
     }
-    else
-    {
-        _Pos = pos_type(std::_BADOFF);      // neither read nor write buffer selected, fail
-    }
 
     return _Pos;
 }
@@ -352,136 +591,677 @@ zmembuf::pos_type zmembuf::seekoff(off_type                off,
 //!				-#	<tt>std::ios_base::end</tt> is not supported as a start location
 //!				-#	Only forward seeks are allowed in output buffers
 
-zmembuf::pos_type zmembuf::seekpos(pos_type                pos,
-                                   std::ios_base::openmode mode /* = std::ios_base::in | std::ios_base::out*/)
+template <class CharT, class Traits, class Container>
+typename basic_zmembuf<CharT, Traits, Container>::pos_type
+basic_zmembuf<CharT, Traits, Container>::seekpos(pos_type                pos,
+                                                 std::ios_base::openmode mode /* = std::ios_base::in | std::ios_base::out*/)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, mode);
+}
+
+//! @note   By default, the buffered output is passed to the compressor, but the compressor is not flushed. The flush
+//!         policy (see set_flush_policy()) can change that.
+
+template <class CharT, class Traits, class Container>
+int basic_zmembuf<CharT, Traits, Container>::sync()
 {
-    off_type off = off_type(pos);
+    ZSTATS_ADD(stats_.syncs, 1);
 
-    // position within read buffer
-    if (!gptr())
+    if (!(state_ & WO_BIT) || end_ || flushPolicy_.mode == zflushpolicy::IGNORE_REQUEST)
     {
-        if (0 <= off && off <= egptr() - eback())
+        return 0;
+    }
+
+    // Hand any buffered output to the codec, and flush it if the policy calls for it
+    return compressBuffer(flushPolicy_.requested()) ? 0 : -1;
+}
+
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::finish()
+{
+    if (!end_)
+    {
+        compressBuffer(zcodec::FINISH);
+        end_ = true;
+        this->setp(0, 0);
+    }
+
+    // Trim the container to the compressed data. The storage is only given back if it was sized for the worst case
+    // of a large write (see compress()) and most of it is unused, so a container reused for each message keeps its
+    // storage.
+    data_.resize(length_);
+    if (presized_ && data_.capacity() - length_ > std::max(length_, MIN_GROWTH))
+    {
+        data_.shrink_to_fit();
+    }
+    presized_ = false;
+}
+
+//! @param	data	Initial contents of the buffer
+//! @param	size	Size of the initial contents
+//! @param	state	Read or write state of the buffer
+//! @param	copy	If false, the buffer decompresses the data in place instead of copying it
+
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::initialize(char_type const * data,
+                                                         size_t            size,
+                                                         StreamState       state,
+                                                         bool              copy)
+{
+    state_ = state;
+
+    if (copy)
+    {
+        data_.assign(data, data + size);
+        data   = data_.data();
+    }
+    else
+    {
+        data_.clear();
+    }
+    this->setg(0, 0, 0);
+    this->setp(0, 0);
+
+    if (state_ & RO_BIT)
+    {
+        // The compressed data is handed to the codec as it is needed
+        source_     = bytes(data);
+        sourceSize_ = size;
+        rewind();
+    }
+    else
+    {
+        // The compressed data is appended to the initial contents
+        prepare(nullptr, 0);
+        length_   = data_.size();
+        position_ = 0;
+        flushed_  = 0;
+        presized_ = false;
+        end_      = false;
+    }
+}
+
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::tidy()
+{
+    codec_.reset();
+}
+
+//!
+//! @param	mode	Open mode
+
+template <class CharT, class Traits, class Container>
+typename basic_zmembuf<CharT, Traits, Container>::StreamState
+basic_zmembuf<CharT, Traits, Container>::streamState(std::ios_base::openmode mode)
+{
+    return ((mode & std::ios_base::out) != 0) ? WO_BIT : RO_BIT;
+}
+
+//!
+//! @param	needed	Amount of space needed after the data
+
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::grow(size_t needed)
+{
+    // Grow geometrically so that the number of reallocations is logarithmic in the size of the output
+    if (data_.size() - length_ < needed)
+    {
+        size_t const capacity = data_.capacity();
+        data_.resize(std::max(std::max(length_ + std::max(needed, size_t(WINDOW_SIZE)), data_.size() * 2),
+                              data_.capacity()));
+        ZSTATS_ADD(stats_.reallocations, data_.capacity() != capacity);
+    }
+}
+
+//! @param	data	Compressed data (input), or ignored (output)
+//! @param	size	Size of the data
+
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::prepare(zcodec::char_type const * data, size_t size)
+{
+    zcodec::Type type = type_;
+    if (type == zcodec::AUTO)
+    {
+        zcodec::Type const detected = (state_ & RO_BIT) ? zcodec::detect(data, size) : zcodec::AUTO;
+        type = (detected != zcodec::AUTO) ? detected : zcodec::ZLIB;
+    }
+
+    // The codec's state comes from the memory resource, if there is one, so it is reused when possible
+    storing_ = false;
+    if (codec_ && codec_->type() == type)
+    {
+        // The level and strategy may have been set while the codec was idle (after the output was finished), so they
+        // are applied again. The adaptive controller's setting is kept, because it learns from all the messages.
+        if (state_ & WO_BIT)
         {
-            gbump((int)(eback() + off - gptr()));
+            bool const adapted = controller_ &&
+                                 (type == zcodec::GZIP || type == zcodec::ZLIB || type == zcodec::DEFLATE);
+            codec_->set_level(adapted ? controller_->level() : options_.level);
+            codec_->set_strategy(adapted ? controller_->strategy() : options_.strategy);
         }
-        else
+        if (codec_->reset())
         {
-            off = std::_BADOFF;
+            return;
         }
     }
-    // position within write buffer
-    else if (pptr() != 0)
+    codec_ = zcodec::create(type, (state_ & WO_BIT) != 0, options_, resource_);
+}
+
+//! @param	s	    Data to compress
+//! @param	n	    Number of characters to compress
+//! @param	flush	Flush mode
+
+template <class CharT, class Traits, class Container>
+bool basic_zmembuf<CharT, Traits, Container>::compress(char_type const * s, size_t n, zcodec::Flush flush)
+{
+    if (end_ || !codec_)
     {
-        if (0 <= off && off <= epptr() - pbase())
+        return false;
+    }
+
+    // The adaptive controller decides once per block, so a large write is compressed a block at a time
+    if (controller_)
+    {
+        for (size_t left = controller_->remaining(); n > left; left = controller_->remaining())
         {
-            pbump((int)(pbase() + off - pptr()));
+            if (!compress(s, left, zcodec::NO_FLUSH))
+            {
+                return false;
+            }
+            s += left;
+            n -= left;
         }
-        else
+    }
+
+    // Writes that look incompressible are stored. A large write is judged a piece at a time.
+    if (skipIncompressible_)
+    {
+        for (; n > zadaptive::PROBE_SIZE; s += zadaptive::PROBE_SIZE, n -= zadaptive::PROBE_SIZE)
         {
-            off = std::_BADOFF;
+            if (!compress(s, zadaptive::PROBE_SIZE, zcodec::NO_FLUSH))
+            {
+                return false;
+            }
         }
+        judge(s, n);
     }
-    else
+
+    position_ += off_type(n);
+    ZSTATS_ADD(stats_.uncompressedBytes, n);
+
+    // The flush policy may call for a flush after this data
+    if (flush == zcodec::NO_FLUSH && flushPolicy_.bytes > 0 && position_ - flushed_ >= off_type(flushPolicy_.bytes))
     {
-        off = std::_BADOFF;    // neither read nor write buffer selected, fail
+        flush = flushPolicy_.automatic();
+    }
+    if (flush != zcodec::NO_FLUSH)
+    {
+        flushed_ = position_;
     }
 
-    return pos_type(off);
+    // Data that is followed directly by the end of the output, and a large first write, are given room for all of
+    // their compressed data, so they are compressed without growing the container. finish() gives back the room that
+    // was not used. Otherwise, the container grows with the output.
+    bool const                large  = position_ == off_type(n) && n >= WINDOW_SIZE;
+    zcodec::char_type const * in     = bytes(s);
+    size_t                    needed = ((flush == zcodec::FINISH && n > 0) || large) ? codec_->bound(n)
+                                                                                      : size_t(WINDOW_SIZE);
+    presized_ = presized_ || large;
+    for (;;)
+    {
+        grow(needed);
+        needed = WINDOW_SIZE;
+        zcodec::char_type * out       = bytes(data_.data()) + length_;
+        size_t              space     = data_.size() - length_;
+        size_t const        available = space;
+        size_t const        pending   = n;
+        std::chrono::steady_clock::time_point const start = controller_ ? std::chrono::steady_clock::now()
+                                                                        : std::chrono::steady_clock::time_point();
+        zcodec::Status status;
+        {
+            ZSTATS_TIME(stats_.zlibNanoseconds);
+            status = codec_->compress(in, n, out, space, flush);
+        }
+        ZSTATS_ADD(stats_.deflateCalls, 1);
+        ZSTATS_ADD(stats_.compressedBytes, available - space);
+        length_ += available - space;
+
+        // Writes that were stored because they look incompressible say nothing about the controller's setting
+        if (controller_ && !storing_)
+        {
+            adapt(pending - n, available - space, std::chrono::steady_clock::now() - start);
+        }
+
+        if (status == zcodec::END)
+        {
+            return true;
+        }
+        if (status != zcodec::OK)
+        {
+            return false;
+        }
+
+        // Done when all the input has been consumed and the codec did not fill the output (it has nothing more to
+        // write)
+        if (n == 0 && (flush == zcodec::NO_FLUSH || space > 0) && flush != zcodec::FINISH)
+        {
+            return true;
+        }
+    }
 }
 
-void zmembuf::sync() const
+//! @param	in      Number of characters compressed
+//! @param	out     Number of bytes produced
+//! @param	time    Time spent compressing
+
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::adapt(size_t in, size_t out, std::chrono::nanoseconds time)
 {
-    if (state_ == 0)
+    // The controller's settings are for zlib
+    zcodec::Type const type = codec_->type();
+    if (type != zcodec::GZIP && type != zcodec::ZLIB && type != zcodec::DEFLATE)
     {
-        inflateEnd(&stream_);
+        return;
     }
-    else
+
+    if (controller_->update(in, out, time))
     {
-        deflateEnd(&stream_);
+        ZSTATS_ADD(stats_.adaptations, 1);
+        codec_->set_level(storing_ ? 0 : controller_->level());
+        codec_->set_strategy(controller_->strategy());
     }
+}
+
+//! @param	s	Data to compress
+//! @param	n	Number of characters to compress
+//!
+//! @note   Stored output overrides the level, which applies again when the output is compressed again.
 
-    data_.resize(stream_.total_out);
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::judge(char_type const * s, size_t n)
+{
+    // The other formats already store incompressible data cheaply
+    zcodec::Type const type = codec_->type();
+    if (type != zcodec::GZIP && type != zcodec::ZLIB && type != zcodec::DEFLATE)
+    {
+        return;
+    }
+
+    if (n >= zadaptive::MIN_PROBE_SIZE)
+    {
+        bool const store = zadaptive::incompressible(bytes(s), n);
+        if (store != storing_)
+        {
+            storing_ = store;
+            codec_->set_level(storing_ ? 0 : controller_ ? controller_->level() : options_.level);
+        }
+    }
+    ZSTATS_ADD(stats_.storedBytes, storing_ ? n : 0);
 }
 
-//! @param	data	Initial contents of the buffer
-//! @param	state	Read or write state of the buffer
+//!
+//! @param	flush	Flush mode
 
-void zmembuf::initialize(container_type const & data, StreamState state)
+template <class CharT, class Traits, class Container>
+bool basic_zmembuf<CharT, Traits, Container>::compressBuffer(zcodec::Flush flush)
 {
-    state_ = state;
+    if (end_)
+    {
+        return false;
+    }
 
-    data_.clear();
-    setg(0, 0, 0);
-    setp(0, 0, 0);
+    if (window_.empty())
+    {
+        window_.resize(WINDOW_SIZE);
+    }
 
-    if (data.size() > 0)
+    // Compress the buffered data. If the put area has not been set up yet, then there is nothing to compress.
+    size_t const n = (this->pbase() != nullptr) ? size_t(this->pptr() - this->pbase()) : 0;
+    if ((n > 0 || flush != zcodec::NO_FLUSH) && !compress(window_.data(), n, flush))
     {
-        data_.assign(data.begin(), data.end() - 1);
+        return false;
+    }
 
-        if (state_ == 0)
-        {
-            int ok;
+    this->setp(window_.data(), window_.data() + window_.size());
+    return true;
+}
 
-            // Initialize zlib for inflating (use default memory allocation)
-            stream_.zalloc = Z_NULL;
-            stream_.zfree  = Z_NULL;
-            stream_.opaque = Z_NULL;
-            ok = inflateInit(&stream_);
-            assert(ok);
+//! @param	s	Where to put the decompressed data
+//! @param	n	Maximum number of characters to decompress
 
-            // Set the stream buffer pointers
+template <class CharT, class Traits, class Container>
+std::streamsize basic_zmembuf<CharT, Traits, Container>::decompress(char_type * s, std::streamsize n)
+{
+    std::streamsize total = 0;
 
-            setg(&*data_.begin(), &*data_.begin(), &*data_.end());
+    while (total < n && !end_ && codec_)
+    {
+        zcodec::char_type * out       = bytes(s + total);
+        size_t              space     = size_t(n - total);
+        size_t const        available = remaining_;
+        zcodec::Status status;
+        {
+            ZSTATS_TIME(stats_.zlibNanoseconds);
+            status = codec_->decompress(next_, remaining_, out, space);
         }
-        else // if ( state_ == 1 )
+        ZSTATS_ADD(stats_.inflateCalls, 1);
+        ZSTATS_ADD(stats_.compressedBytes, available - remaining_);
+        std::streamsize const count = std::streamsize(size_t(n - total) - space);
+        total += count;
+
+        // Like gzread(), concatenated gzip members (or zstd or lz4 frames) are decompressed as one. Decompression
+        // stops at the end of the data or if the data is bad.
+        if (status == zcodec::END)
         {
-            int ok;
+            zcodec::Type const type = codec_->type();
+            if (remaining_ == 0 || (type != zcodec::GZIP && type != zcodec::ZSTD && type != zcodec::LZ4) ||
+                zcodec::detect(next_, remaining_) != type || !codec_->reset())
+            {
+                end_ = true;
+            }
+        }
+        else if (status != zcodec::OK)
+        {
+            end_    = true;
+            failed_ = true;
+        }
+
+        // If the codec can make no progress, the compressed data is truncated
+        else if (count == 0 && available == remaining_)
+        {
+            break;
+        }
+    }
+
+    position_ += total;
+    ZSTATS_ADD(stats_.uncompressedBytes, total);
+    if (runningChecksum_)
+    {
+        checksum_.update(s, size_t(total));
+    }
+    return total;
+}
 
-            // Initialize zlib for deflating (use default memory allocation)
-            stream_.zalloc = Z_NULL;
-            stream_.zfree  = Z_NULL;
-            stream_.opaque = Z_NULL;
-            ok = deflateInit(&stream_, Z_DEFAULT_COMPRESSION);
-            assert(ok);
+//! @note   The data is decompressed into the window and discarded, so the cost is that of decompression alone. The
+//!         checks are those of the format (the Adler-32 in the trailer of zlib data, for example), and the running
+//!         checksum is also updated if it is enabled. Afterwards, the position is at the end of the data.
+//! @note   An output buffer is never intact.
 
-            // Set the stream buffer pointers
+template <class CharT, class Traits, class Container>
+bool basic_zmembuf<CharT, Traits, Container>::verify()
+{
+    if (!(state_ & RO_BIT))
+    {
+        return false;
+    }
 
-            setp(&*data_.begin(), &*data_.end(), &*data_.end());
-        }
+    if (window_.empty())
+    {
+        window_.resize(WINDOW_SIZE);
+    }
+    this->setg(0, 0, 0);
+    while (decompress(window_.data(), std::streamsize(WINDOW_SIZE)) > 0)
+    {
     }
+
+    // Decompression stops early if the data is truncated
+    return end_ && !failed_;
 }
 
-void zmembuf::tidy()
+template <class CharT, class Traits, class Container>
+bool basic_zmembuf<CharT, Traits, Container>::fill()
 {
-    // Make sure the data is synced before shutting it down or replacing it.
-    sync();
+    if (!(state_ & RO_BIT))
+    {
+        return false;
+    }
+
+    if (window_.empty())
+    {
+        window_.resize(WINDOW_SIZE);
+    }
+    char_type * const window = window_.data();
+
+    // Move the last few characters to the beginning of the window so that they can be put back
+    std::streamsize putback = 0;
+    if (this->eback() != nullptr)
+    {
+        putback = std::min(std::streamsize(PUTBACK_SIZE), std::streamsize(this->gptr() - this->eback()));
+        memmove(window, this->gptr() - putback, size_t(putback));
+    }
+
+    std::streamsize count = decompress(window + putback, std::streamsize(WINDOW_SIZE) - putback);
+    this->setg(window, window + putback, window + putback + count);
+
+    return count > 0;
 }
 
-//!
-//! @param	mode	Open mode
+//! @param	end     End of the data that was read
+//! @param	n       Number of characters that were read
 
-zmembuf::StreamState zmembuf::streamState(std::ios_base::openmode mode)
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::savePutback(char_type const * end, std::streamsize n)
 {
-    return ((mode & std::ios_base::out) != 0) ? 1 : 0;
+    // If data has only been read directly, then there is no window and putback is not supported. This avoids
+    // allocating a window that is never used.
+    if (window_.empty())
+    {
+        this->setg(0, 0, 0);
+        return;
+    }
+    char_type * const window = window_.data();
+
+    std::streamsize const putback = std::min(std::streamsize(PUTBACK_SIZE), n);
+    memcpy(window, end - putback, size_t(putback));
+    this->setg(window, window + putback, window + putback);
 }
 
-//!
-//! @param	size	Number of bytes to make room for
+//! @param	data	Compressed data to decompress (input), or ignored (output)
+//! @param	size	Size of the data
+
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::restart(zcodec::char_type const * data, size_t size)
+{
+    this->setg(0, 0, 0);
+    this->setp(0, 0);
+
+    if (state_ & RO_BIT)
+    {
+        source_     = data;
+        sourceSize_ = size;
+        rewind();
+    }
+    else
+    {
+        prepare(nullptr, 0);
+        length_   = data_.size();
+        position_ = 0;
+        flushed_  = 0;
+        presized_ = false;
+        end_      = false;
+    }
+}
 
-void zmembuf::grow(size_t size)
+template <class CharT, class Traits, class Container>
+void basic_zmembuf<CharT, Traits, Container>::rewind()
 {
-    assert(size <= std::numeric_limits<uInt>::max());
-    data_.resize(stream_.total_out + size);
+    prepare(source_, sourceSize_);
 
-    stream_.next_out  = &data_[stream_.total_out];
-    stream_.avail_out = (uInt)size;
+    next_      = source_;
+    remaining_ = sourceSize_;
+    position_  = 0;
+    end_       = false;
+    failed_    = false;
+    checksum_.reset((codec_ && codec_->type() == zcodec::ZLIB) ? zchecksum::ADLER32 : zchecksum::CRC32);
+
+    this->setg(0, 0, 0);
 }
 
-void zmembuf::flushInput()
+//! @param	data        Data to compress
+//! @param	size        Size of the data
+//! @param	out         Receives the compressed data
+//! @param	type        Format
+//! @param	options     Settings of the compressor
+//! @param	resource    Memory resource that provides the zlib state
+
+template <class Container>
+bool zcompress(void const *                data,
+               size_t                      size,
+               Container &                 out,
+               zcodec::Type                type /* = zcodec::AUTO*/,
+               zcodec::Options const &     options /* = zcodec::Options()*/,
+               std::pmr::memory_resource * resource /* = nullptr*/)
 {
-    while (stream_.avail_in > 0)
+    out.clear();
+
+    if (type == zcodec::AUTO)
+    {
+        type = zcodec::ZLIB;
+    }
+    std::unique_ptr<zcodec> codec = zcodec::create(type, true, options, resource);
+    if (!codec)
+    {
+        return false;
+    }
+
+    // The output has room for the largest possible result, so one call compresses and finishes everything. More
+    // calls are needed only if the input is too large for the codec to take at once.
+    out.resize(codec->bound(size));
+    zcodec::char_type const * in     = static_cast<zcodec::char_type const *>(data);
+    size_t                    inSize = size;
+    size_t                    length = 0;
+    zcodec::Status             status;
+    do
+    {
+        if (length == out.size())
+        {
+            out.resize(out.size() + std::max(out.size() / 2, MIN_GROWTH));
+        }
+        zcodec::char_type * next  = bytes(out.data()) + length;
+        size_t              space = out.size() - length;
+        status  = codec->compress(in, inSize, next, space, zcodec::FINISH);
+        length  = out.size() - space;
+    }
+    while (status == zcodec::OK);
+
+    // The worst case is usually far larger than the result, so the unused room is released unless it is small
+    out.resize(length);
+    if (out.capacity() - length > std::max(length, MIN_GROWTH))
     {
-        grow(stream_.avail_in + 1);
-        deflate(&stream_, 0);
+        out.shrink_to_fit();
     }
+    return status == zcodec::END;
 }
+
+//! @param	data        Data to decompress
+//! @param	size        Size of the data
+//! @param	out         Receives the decompressed data
+//! @param	sizeHint    Expected size of the decompressed data, or 0
+//! @param	type        Format
+//! @param	resource    Memory resource that provides the zlib state
+
+template <class Container>
+bool zdecompress(void const *                data,
+                 size_t                      size,
+                 Container &                 out,
+                 size_t                      sizeHint /* = 0*/,
+                 zcodec::Type                type /* = zcodec::AUTO*/,
+                 std::pmr::memory_resource * resource /* = nullptr*/)
+{
+    out.clear();
+
+    if (type == zcodec::AUTO)
+    {
+        type = zcodec::detect(static_cast<zcodec::char_type const *>(data), size);
+        if (type == zcodec::AUTO)
+        {
+            type = zcodec::ZLIB;
+        }
+    }
+    std::unique_ptr<zcodec> codec = zcodec::create(type, false, zcodec::Options(), resource);
+    if (!codec)
+    {
+        return false;
+    }
+
+    // The size recorded in the data is not trusted if it is implausible, so that bad data cannot cause a huge
+    // allocation. One more byte is allocated so that the codec can reach the end of the data without running out of
+    // room when the size is exact.
+    size_t expected = sizeHint;
+    if (expected == 0)
+    {
+        expected = std::min(zcodec::content_size(static_cast<zcodec::char_type const *>(data), size),
+                            size * MAX_TRUSTED_RATIO);
+    }
+    if (expected == 0)
+    {
+        expected = size * ASSUMED_RATIO;
+    }
+    out.resize(expected + 1);
+
+    zcodec::char_type const * in     = static_cast<zcodec::char_type const *>(data);
+    size_t                    inSize = size;
+    size_t                    length = 0;
+    for (;;)
+    {
+        if (length == out.size())
+        {
+            out.resize(out.size() + std::max(out.size() / 2, MIN_GROWTH));
+        }
+        zcodec::char_type *  next      = bytes(out.data()) + length;
+        size_t               space     = out.size() - length;
+        size_t const         available = inSize;
+        zcodec::Status const status    = codec->decompress(in, inSize, next, space);
+        size_t const         produced  = (out.size() - length) - space;
+        length += produced;
+
+        // Like zmembuf, concatenated gzip members (or zstd or lz4 frames) are decompressed as one
+        if (status == zcodec::END)
+        {
+            if (inSize == 0 || (type != zcodec::GZIP && type != zcodec::ZSTD && type != zcodec::LZ4) ||
+                zcodec::detect(in, inSize) != type || !codec->reset())
+            {
+                out.resize(length);
+                return true;
+            }
+        }
+
+        // Stop if the data is bad, or if it is truncated (no progress can be made)
+        else if (status != zcodec::OK || (produced == 0 && available == inSize && space > 0))
+        {
+            out.resize(length);
+            return false;
+        }
+    }
+}
+
+template class basic_zmembuf<unsigned char>;
+template class basic_zmembuf<char>;
+template class basic_zmembuf<char, std::char_traits<char>, std::string>;
+
+template bool zcompress(void const *,
+                        size_t,
+                        std::vector<unsigned char> &,
+                        zcodec::Type,
+                        zcodec::Options const &,
+                        std::pmr::memory_resource *);
+template bool zcompress(void const *,
+                        size_t,
+                        std::vector<char> &,
+                        zcodec::Type,
+                        zcodec::Options const &,
+                        std::pmr::memory_resource *);
+template bool zcompress(void const *,
+                        size_t,
+                        std::string &,
+                        zcodec::Type,
+                        zcodec::Options const &,
+                        std::pmr::memory_resource *);
+template bool zdecompress(void const *,
+                          size_t,
+                          std::vector<unsigned char> &,
+                          size_t,
+                          zcodec::Type,
+                          std::pmr::memory_resource *);
+template bool zdecompress(void const *, size_t, std::vector<char> &, size_t, zcodec::Type, std::pmr::memory_resource *);
+template bool zdecompress(void const *, size_t, std::string &, size_t, zcodec::Type, std::pmr::memory_resource *);
@@ -13,20 +13,41 @@
 
 #include "zmstream.h"
 
-izmstream::izmstream()
-    : std::basic_istream<unsigned char, std::char_traits<unsigned char> >(&membuf_)
-    , membuf_(std::ios_base::in)
+template <class CharT, class Traits, class Container>
+basic_izmstream<CharT, Traits, Container>::basic_izmstream(std::pmr::memory_resource * resource /* = nullptr*/)
+    : std::basic_istream<CharT, Traits>(&membuf_)
+    , membuf_(std::ios_base::in, resource)
 {
 }
 
-izmstream::izmstream(container_type const & buf)
-    : std::basic_istream<unsigned char, std::char_traits<unsigned char> >(&membuf_)
-    , membuf_(buf, std::ios_base::in)
+template <class CharT, class Traits, class Container>
+basic_izmstream<CharT, Traits, Container>::basic_izmstream(container_type const &      buf,
+                                                           std::pmr::memory_resource * resource /* = nullptr*/)
+    : std::basic_istream<CharT, Traits>(&membuf_)
+    , membuf_(buf, std::ios_base::in, resource)
 {
 }
 
-ozmstream::ozmstream()
-    : std::basic_ostream<unsigned char, std::char_traits<unsigned char> >(&membuf_)
-    , membuf_(std::ios_base::out)
+template <class CharT, class Traits, class Container>
+basic_izmstream<CharT, Traits, Container>::basic_izmstream(char_type const *           data,
+                                                           size_t                      size,
+                                                           std::pmr::memory_resource * resource /* = nullptr*/)
+    : std::basic_istream<CharT, Traits>(&membuf_)
+    , membuf_(std::ios_base::in, resource)
 {
+    membuf_.borrow(data, size);
 }
+
+template <class CharT, class Traits, class Container>
+basic_ozmstream<CharT, Traits, Container>::basic_ozmstream(std::pmr::memory_resource * resource /* = nullptr*/)
+    : std::basic_ostream<CharT, Traits>(&membuf_)
+    , membuf_(std::ios_base::out, resource)
+{
+}
+
+template class basic_izmstream<unsigned char>;
+template class basic_ozmstream<unsigned char>;
+template class basic_izmstream<char>;
+template class basic_ozmstream<char>;
+template class basic_izmstream<char, std::char_traits<char>, std::string>;
+template class basic_ozmstream<char, std::char_traits<char>, std::string>;
@@ -0,0 +1,338 @@
+/** @file *//********************************************************************************************************
+
+                                                    zparallel.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zparallel.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zparallel.h"
+
+#include "zallocator.h"
+#include "zchecksum.h"
+#include "zlib/zlib.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+// Writes a 32-bit value in little-endian order
+void putLong(unsigned char * p, uLong x)
+{
+    p[0] = (unsigned char)(x & 0xff);
+    p[1] = (unsigned char)((x >> 8) & 0xff);
+    p[2] = (unsigned char)((x >> 16) & 0xff);
+    p[3] = (unsigned char)((x >> 24) & 0xff);
+}
+
+} // anonymous namespace
+
+//! @param	file        File to write. It must be open for writing in binary mode. It is closed by close().
+//! @param	level       Compression level. 0 is no compression, 9 is maximum compression.
+//! @param	threads     Number of compressor threads. If 0, the number of hardware threads is used.
+//! @param	blockSize   Amount of uncompressed data in each block
+//! @param	resource    Memory resource that provides the zlib state of the compressors, or nullptr to use the
+//!                     default allocation. It is used by several threads, so it must be thread-safe (for example,
+//!                     @c std::pmr::synchronized_pool_resource).
+
+zparallel::zparallel(FILE *                      file,
+                     int                         level,
+                     unsigned                    threads,
+                     size_t                      blockSize /* = DEFAULT_BLOCK_SIZE*/,
+                     std::pmr::memory_resource * resource /* = nullptr*/)
+    : file_(file)
+    , resource_(resource)
+    , blockSize_(std::max(blockSize, size_t(DICTIONARY_SIZE)))
+    , level_(level)
+    , total_(0)
+    , submitted_(0)
+    , written_(0)
+    , crc_(crc32(0L, Z_NULL, 0))
+    , compressed_(0)
+    , ok_(true)
+    , stop_(false)
+{
+    if (threads == 0)
+    {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    // Limit the amount of memory in use by limiting the number of blocks in flight
+    maxPending_ = threads * 2 + 2;
+
+    // gzip header: no file name, no modification time, unknown OS
+    static unsigned char const header[10] = { 0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 0xff };
+    ok_ = (fwrite(header, 1, sizeof(header), file_) == sizeof(header));
+    compressed_ = sizeof(header);
+
+    block_.reserve(blockSize_);
+
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        compressors_.emplace_back(&zparallel::compressor, this, level);
+    }
+    writer_ = std::thread(&zparallel::writer, this);
+}
+
+zparallel::~zparallel()
+{
+    close();
+}
+
+//! @param	s   Uncompressed data
+//! @param	n   Number of characters
+
+bool zparallel::write(char_type const * s, size_t n)
+{
+    if (!file_)
+    {
+        return false;
+    }
+
+    while (n > 0)
+    {
+        size_t size = std::min(n, blockSize_ - block_.size());
+        block_.insert(block_.end(), s, s + size);
+        s += size;
+        n -= size;
+
+        if (block_.size() == blockSize_)
+        {
+            submit(Z_SYNC_FLUSH);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ok_;
+}
+
+//! @note	The current block is ended early so that everything written so far can be decompressed by a reader of
+//!         the file.
+
+bool zparallel::flush()
+{
+    if (!file_)
+    {
+        return false;
+    }
+
+    if (!block_.empty())
+    {
+        submit(Z_SYNC_FLUSH);
+    }
+    wait();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ok_ && fflush(file_) == 0;
+}
+
+bool zparallel::close()
+{
+    if (!file_)
+    {
+        return false;
+    }
+
+    // The last block finishes the deflate stream, even if it is empty
+    submit(Z_FINISH);
+    wait();
+
+    // Stop the threads
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    jobReady_.notify_all();
+    resultReady_.notify_all();
+    for (auto & thread : compressors_)
+    {
+        thread.join();
+    }
+    writer_.join();
+    compressors_.clear();
+
+    // gzip trailer: CRC and size (mod 2^32) of the uncompressed data
+    unsigned char trailer[8];
+    putLong(&trailer[0], crc_);
+    putLong(&trailer[4], uLong(total_ & 0xffffffffUL));
+    bool ok = ok_ && fwrite(trailer, 1, sizeof(trailer), file_) == sizeof(trailer);
+    compressed_ += sizeof(trailer);
+
+    if (fclose(file_) != 0)
+    {
+        ok = false;
+    }
+    file_ = nullptr;
+
+    return ok;
+}
+
+//!
+//! @param	flush   zlib flush mode that ends the block
+
+void zparallel::submit(int flush)
+{
+    std::unique_ptr<Job> job(new Job);
+    job->input.swap(block_);
+    job->dictionary = history_;
+    job->level      = level_;
+    job->flush      = flush;
+    job->crc        = 0;
+    job->ok         = false;
+
+    // The next block is primed with the last DICTIONARY_SIZE characters of all the data submitted so far
+    std::vector<char_type> const & input = job->input;
+    if (input.size() >= DICTIONARY_SIZE)
+    {
+        history_.assign(input.end() - DICTIONARY_SIZE, input.end());
+    }
+    else
+    {
+        history_.insert(history_.end(), input.begin(), input.end());
+        if (history_.size() > DICTIONARY_SIZE)
+        {
+            history_.erase(history_.begin(), history_.end() - DICTIONARY_SIZE);
+        }
+    }
+
+    total_ += input.size();
+    block_.reserve(blockSize_);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        blockWritten_.wait(lock, [this] { return submitted_ - written_ < maxPending_; });
+        job->sequence = submitted_++;
+        jobs_.push_back(std::move(job));
+    }
+    jobReady_.notify_one();
+}
+
+size_t zparallel::compressed()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return compressed_;
+}
+
+void zparallel::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    blockWritten_.wait(lock, [this] { return written_ == submitted_; });
+}
+
+//!
+//! @param	level   Initial compression level
+
+void zparallel::compressor(int level)
+{
+    z_stream stream;
+    zallocator::attach(stream, resource_);
+    bool ok = (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+
+    for (;;)
+    {
+        std::unique_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            jobReady_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+            if (jobs_.empty())
+            {
+                break;
+            }
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        // Raw deflate, so the blocks can be concatenated. Each block except the last ends on a byte boundary.
+        job->ok = ok && deflateReset(&stream) == Z_OK;
+        if (job->ok && job->level != level)
+        {
+            level   = job->level;
+            job->ok = (deflateParams(&stream, level, Z_DEFAULT_STRATEGY) == Z_OK);
+        }
+        if (job->ok && !job->dictionary.empty())
+        {
+            job->ok = (deflateSetDictionary(&stream, job->dictionary.data(), uInt(job->dictionary.size())) == Z_OK);
+        }
+
+        if (job->ok)
+        {
+            job->output.resize(deflateBound(&stream, uLong(job->input.size())) + 16);
+            stream.next_in   = job->input.data();
+            stream.avail_in  = uInt(job->input.size());
+            stream.next_out  = job->output.data();
+            stream.avail_out = uInt(job->output.size());
+
+            int status;
+            for (;;)
+            {
+                status = deflate(&stream, job->flush);
+                if (status == Z_STREAM_END ||
+                    (status == Z_OK && stream.avail_out > 0) ||
+                    (status != Z_OK && status != Z_BUF_ERROR))
+                {
+                    break;
+                }
+
+                // Out of room (unlikely given deflateBound)
+                size_t used = job->output.size() - stream.avail_out;
+                job->output.resize(job->output.size() * 2);
+                stream.next_out  = job->output.data() + used;
+                stream.avail_out = uInt(job->output.size() - used);
+            }
+
+            job->ok = (status == Z_OK || status == Z_STREAM_END);
+            job->output.resize(job->output.size() - stream.avail_out);
+            job->crc = zchecksum::crc32(0, job->input.data(), job->input.size());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            size_t sequence = job->sequence;
+            results_[sequence] = std::move(job);
+        }
+        resultReady_.notify_all();
+    }
+
+    deflateEnd(&stream);
+}
+
+void zparallel::writer()
+{
+    for (;;)
+    {
+        std::unique_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            resultReady_.wait(lock, [this] { return stop_ || results_.count(written_) > 0; });
+            auto i = results_.find(written_);
+            if (i == results_.end())
+            {
+                break;
+            }
+            job = std::move(i->second);
+            results_.erase(i);
+        }
+
+        bool ok = job->ok &&
+                  fwrite(job->output.data(), 1, job->output.size(), file_) == job->output.size();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            crc_ = zchecksum::crc32_combine(uint32_t(crc_), uint32_t(job->crc), job->input.size());
+            compressed_ += job->output.size();
+            if (!ok)
+            {
+                ok_ = false;
+            }
+            ++written_;
+        }
+        blockWritten_.notify_all();
+    }
+}
@@ -0,0 +1,67 @@
+/** @file *//********************************************************************************************************
+
+                                                     zpool.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zpool.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zpool.h"
+
+#include <vector>
+
+//!
+//! @param	buffer	Buffer to return
+
+void zpool::recycler::operator()(zmembuf * buffer) const
+{
+    std::vector<std::unique_ptr<zmembuf> > & buffers = idle(output_);
+    if (buffers.size() >= MAX_SIZE)
+    {
+        delete buffer;
+        return;
+    }
+
+    // The next user gets an empty buffer with the default settings: the default format, level, and strategy, and no
+    // dictionary. Unless the format or a setting fixed at its creation changed, the codec and its state are kept.
+    buffer->reset();
+    buffer->set_adaptive(false);  // First, so that set_codec() applies the default level instead of the controller's
+    buffer->set_codec(zcodec::AUTO);
+    buffer->set_flush_policy(zflushpolicy(zflushpolicy::NO_FLUSH));
+    buffer->set_skip_incompressible(false);
+    buffer->set_running_checksum(false);
+    buffer->reset_stats();
+    buffers.emplace_back(buffer);
+}
+
+//!
+//! @param	mode	Direction of the buffer. See zmembuf::zmembuf().
+
+zpool::pointer zpool::acquire(std::ios_base::openmode mode)
+{
+    bool const output = (mode & std::ios_base::out) != 0;
+    std::vector<std::unique_ptr<zmembuf> > & buffers = idle(output);
+
+    if (buffers.empty())
+    {
+        return pointer(new zmembuf(output ? std::ios_base::out : std::ios_base::in), recycler(output));
+    }
+
+    pointer buffer(buffers.back().release(), recycler(output));
+    buffers.pop_back();
+    return buffer;
+}
+
+//!
+//! @param	output	True for the compressing buffers, false for the decompressing buffers
+
+std::vector<std::unique_ptr<zmembuf> > & zpool::idle(bool output)
+{
+    static thread_local std::vector<std::unique_ptr<zmembuf> > buffers[2];
+    return buffers[output ? 1 : 0];
+}
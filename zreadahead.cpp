@@ -0,0 +1,201 @@
+/** @file *//********************************************************************************************************
+
+                                                   zreadahead.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zreadahead.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zreadahead.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+//! @param	source      Source of the decompressed data. It is called by the helper thread.
+//! @param	chunkSize   Size of each chunk
+//! @param	chunkCount  Number of chunks. At least 2 are used, so that the reader and the helper can both have one.
+
+zreadahead::zreadahead(source_type source,
+                       size_t      chunkSize /* = DEFAULT_CHUNK_SIZE*/,
+                       unsigned    chunkCount /* = DEFAULT_CHUNK_COUNT*/)
+    : source_(std::move(source))
+    , chunkSize_(std::min(std::max(chunkSize, size_t(1)), size_t(INT_MAX)))
+    , position_(0)
+    , end_(false)
+    , error_(false)
+    , stop_(false)
+{
+    // The chunks are allocated once and then passed back and forth
+    for (unsigned i = 0; i < std::max(chunkCount, 2u); ++i)
+    {
+        std::unique_ptr<Chunk> chunk(new Chunk);
+        chunk->data.resize(chunkSize_);
+        chunk->size     = 0;
+        chunk->consumed = 0;
+        free_.push_back(std::move(chunk));
+    }
+}
+
+zreadahead::~zreadahead()
+{
+    stop();
+}
+
+//!
+//! @param	position    Offset of the next character of the source in the decompressed data
+
+void zreadahead::start(off_type position)
+{
+    if (helper_.joinable())
+    {
+        return;
+    }
+
+    position_ = position;
+    end_      = false;
+    error_    = false;
+    stop_     = false;
+    helper_   = std::thread(&zreadahead::helper, this);
+}
+
+void zreadahead::stop()
+{
+    if (!helper_.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    workReady_.notify_all();
+    helper_.join();
+
+    // Everything read ahead is discarded
+    if (current_)
+    {
+        free_.push_back(std::move(current_));
+    }
+    while (!ready_.empty())
+    {
+        free_.push_back(std::move(ready_.front()));
+        ready_.pop_front();
+    }
+}
+
+//! @param	s   Where to put the data
+//! @param	n   Maximum number of characters to read
+
+int zreadahead::read(char_type * s, unsigned n)
+{
+    n = std::min(n, unsigned(INT_MAX));
+
+    size_t total = 0;
+    while (total < n)
+    {
+        if ((!current_ || current_->consumed == current_->size) && !next())
+        {
+            break;
+        }
+
+        size_t const size = std::min(size_t(n) - total, current_->size - current_->consumed);
+        memcpy(s + total, current_->data.data() + current_->consumed, size);
+        current_->consumed += size;
+        total              += size;
+    }
+
+    position_ += off_type(total);
+
+    if (total == 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error_)
+        {
+            return -1;
+        }
+    }
+    return int(total);
+}
+
+bool zreadahead::next()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (current_)
+    {
+        free_.push_back(std::move(current_));
+        workReady_.notify_one();
+    }
+
+    // Nothing more can arrive if the helper is not running
+    if (!helper_.joinable())
+    {
+        return false;
+    }
+
+    chunkReady_.wait(lock, [this] { return !ready_.empty() || end_; });
+    if (ready_.empty())
+    {
+        return false;
+    }
+
+    current_ = std::move(ready_.front());
+    ready_.pop_front();
+    return true;
+}
+
+void zreadahead::helper()
+{
+    for (;;)
+    {
+        std::unique_ptr<Chunk> chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            workReady_.wait(lock, [this] { return stop_ || (!end_ && !free_.empty()); });
+            if (stop_)
+            {
+                break;
+            }
+            chunk = std::move(free_.front());
+            free_.pop_front();
+        }
+
+        // Fill the chunk, unless the end of the data is reached
+        size_t size  = 0;
+        int    count = 1;
+        {
+            std::lock_guard<std::mutex> lock(sourceMutex_);
+            while (size < chunkSize_ && (count = source_(chunk->data.data() + size, unsigned(chunkSize_ - size))) > 0)
+            {
+                size += size_t(count);
+            }
+        }
+        chunk->size     = size;
+        chunk->consumed = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (count <= 0)
+            {
+                end_   = true;
+                error_ = (count < 0);
+            }
+            if (size > 0)
+            {
+                ready_.push_back(std::move(chunk));
+            }
+            else
+            {
+                free_.push_back(std::move(chunk));
+            }
+        }
+        chunkReady_.notify_all();
+    }
+}
@@ -0,0 +1,978 @@
+/** @file *//********************************************************************************************************
+
+                                                  zspeculative.cpp
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zspeculative.cpp#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#include "zspeculative.h"
+
+#include "zchecksum.h"
+#include "zlib/zlib.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iterator>
+
+namespace
+{
+
+// Size of the deflate window. A back-reference reaches at most this far.
+size_t const WINDOW_SIZE = 32 * 1024;
+
+// Amount of data decompressed at a time when skipping data to seek
+size_t const SKIP_SIZE = 64 * 1024;
+
+// Reads a deflate stream, least significant bit first
+class BitReader
+{
+public:
+    BitReader(unsigned char const * data, size_t size, std::uint64_t bit)
+    {
+        data_ = data;
+        size_ = size;
+        seek(bit);
+    }
+
+    // Moves to a bit offset
+    void seek(std::uint64_t bit)
+    {
+        next_  = size_t(bit / 8);
+        bits_  = 0;
+        count_ = 0;
+        refill();
+        consume(unsigned(bit % 8));
+    }
+
+    // Ensures that at least 56 bits are buffered. Past the end of the data, the bits are 0.
+    void refill()
+    {
+        if (count_ > 56)
+        {
+            return;
+        }
+        if (next_ + 8 <= size_)
+        {
+            std::uint64_t bytes = 0;
+            for (int i = 7; i >= 0; --i)
+            {
+                bytes = (bytes << 8) | data_[next_ + i];
+            }
+            bits_  |= bytes << count_;
+            next_  += (63 - count_) / 8;
+            count_ |= 56;
+        }
+        else
+        {
+            while (count_ <= 56)
+            {
+                bits_ |= std::uint64_t((next_ < size_) ? data_[next_] : 0) << count_;
+                ++next_;
+                count_ += 8;
+            }
+        }
+    }
+
+    // Returns the next n bits without consuming them. The bits must have been buffered.
+    unsigned peek(unsigned n) const { return unsigned(bits_ & ((std::uint64_t(1) << n) - 1)); }
+
+    // Consumes n buffered bits
+    void consume(unsigned n)
+    {
+        bits_ >>= n;
+        count_ -= n;
+    }
+
+    // Returns and consumes the next n bits (n <= 32)
+    unsigned get(unsigned n)
+    {
+        if (count_ < n)
+        {
+            refill();
+        }
+        unsigned const value = peek(n);
+        consume(n);
+        return value;
+    }
+
+    // Skips to the next byte boundary
+    void align() { consume(count_ & 7); }
+
+    // Returns the bit offset of the next bit
+    std::uint64_t position() const { return std::uint64_t(next_) * 8 - count_; }
+
+    // Returns true if more bits have been consumed than there are in the data
+    bool overrun() const { return position() > std::uint64_t(size_) * 8; }
+
+private:
+    unsigned char const * data_;    // Data
+    size_t size_;                   // Size of the data
+    size_t next_;                   // Offset of the next byte to be buffered
+    std::uint64_t bits_;            // Buffered bits
+    unsigned count_;                // Number of buffered bits
+};
+
+// A canonical Huffman code
+class Huffman
+{
+public:
+    enum
+    {
+        MAX_BITS  = 15,     // Longest code
+        FAST_BITS = 10      // Codes up to this long are decoded with a single lookup
+    };
+
+    // Builds the code from code lengths. Like zlib, an incomplete code is accepted only if its longest code is 1 bit,
+    // and never for the code length code. Returns false if the lengths are invalid.
+    bool build(unsigned char const * lengths, unsigned n, bool codeLengthCode)
+    {
+        std::fill(std::begin(count_), std::end(count_), std::uint16_t(0));
+        for (unsigned i = 0; i < n; ++i)
+        {
+            ++count_[lengths[i]];
+        }
+
+        // No codes at all is valid (for example, a block without distances)
+        std::fill(std::begin(fast_), std::end(fast_), std::uint16_t(0));
+        if (count_[0] == n)
+        {
+            return !codeLengthCode;
+        }
+
+        int left = 1;
+        unsigned longest = 0;
+        for (unsigned length = 1; length <= MAX_BITS; ++length)
+        {
+            left <<= 1;
+            left  -= count_[length];
+            if (left < 0)
+            {
+                return false;   // Over-subscribed
+            }
+            if (count_[length] > 0)
+            {
+                longest = length;
+            }
+        }
+        if (left > 0 && (codeLengthCode || longest != 1))
+        {
+            return false;       // Incomplete
+        }
+
+        // Sort the symbols by code length
+        std::uint16_t offsets[MAX_BITS + 2];
+        offsets[1] = 0;
+        for (unsigned length = 1; length <= MAX_BITS; ++length)
+        {
+            offsets[length + 1] = std::uint16_t(offsets[length] + count_[length]);
+        }
+        for (unsigned i = 0; i < n; ++i)
+        {
+            if (lengths[i] != 0)
+            {
+                symbols_[offsets[lengths[i]]++] = std::uint16_t(i);
+            }
+        }
+
+        // The short codes are decoded with a table indexed by the next FAST_BITS bits. The codes are stored most
+        // significant bit first, so they are reversed.
+        unsigned code  = 0;
+        unsigned index = 0;
+        for (unsigned length = 1; length <= FAST_BITS; ++length)
+        {
+            for (unsigned i = 0; i < count_[length]; ++i, ++index, ++code)
+            {
+                unsigned reversed = 0;
+                for (unsigned b = 0; b < length; ++b)
+                {
+                    reversed |= ((code >> b) & 1) << (length - 1 - b);
+                }
+                std::uint16_t const entry = std::uint16_t((symbols_[index] << 4) | length);
+                for (unsigned j = reversed; j < (1u << FAST_BITS); j += 1u << length)
+                {
+                    fast_[j] = entry;
+                }
+            }
+            code <<= 1;
+        }
+
+        return true;
+    }
+
+    // Decodes a symbol. At least MAX_BITS bits must be buffered. Returns -1 if the code is invalid.
+    int decode(BitReader & in) const
+    {
+        std::uint16_t const entry = fast_[in.peek(FAST_BITS)];
+        if (entry != 0)
+        {
+            in.consume(entry & 15);
+            return entry >> 4;
+        }
+
+        // Longer codes are decoded a bit at a time
+        unsigned const bits  = in.peek(MAX_BITS);
+        int            code  = 0;
+        int            first = 0;
+        int            index = 0;
+        for (unsigned length = 1; length <= MAX_BITS; ++length)
+        {
+            code |= (bits >> (length - 1)) & 1;
+            int const count = count_[length];
+            if (code - first < count)
+            {
+                in.consume(length);
+                return symbols_[index + code - first];
+            }
+            index += count;
+            first  = (first + count) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+private:
+    std::uint16_t fast_[1 << FAST_BITS];    // Symbol and length of short codes, by the next bits
+    std::uint16_t count_[MAX_BITS + 1];     // Number of codes of each length
+    std::uint16_t symbols_[288];            // Symbols sorted by code length
+};
+
+// Base lengths and extra bits of the length symbols
+std::uint16_t const LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+unsigned char const LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+// Base distances and extra bits of the distance symbols
+std::uint16_t const DISTANCE_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+};
+unsigned char const DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Decompressed data, in which values above 255 are markers for data preceding the start
+class Output
+{
+public:
+    Output(std::vector<std::uint16_t> & data)
+        : data_(data)
+        , size_(0)
+    {
+    }
+
+    // Makes room for the longest match
+    void reserve()
+    {
+        if (size_ + 258 > data_.size())
+        {
+            data_.resize(std::max(data_.size() * 2, size_t(64 * 1024)));
+        }
+    }
+
+    // Appends a literal
+    void literal(unsigned value) { data_[size_++] = std::uint16_t(value); }
+
+    // Appends a copy of earlier data. Returns false if the distance reaches beyond the window preceding the start.
+    bool copy(size_t distance, size_t length)
+    {
+        if (distance > size_ + WINDOW_SIZE)
+        {
+            return false;
+        }
+
+        std::uint16_t * const data = data_.data();
+        size_t                from = size_ - distance;    // Wraps around if the data precedes the start
+        for (size_t i = 0; i < length; ++i, ++from)
+        {
+            // Data preceding the start is marked with 256 + its position in the window
+            data[size_ + i] = (from < size_ + i) ? data[from] : std::uint16_t(256 + WINDOW_SIZE + from);
+        }
+        size_ += length;
+        return true;
+    }
+
+    // Appends data from a stored block
+    void stored(unsigned char const * s, size_t n)
+    {
+        if (size_ + n > data_.size())
+        {
+            data_.resize(std::max(data_.size() * 2, size_ + n));
+        }
+        std::copy(s, s + n, data_.begin() + std::ptrdiff_t(size_));
+        size_ += n;
+    }
+
+    // Returns the amount of data
+    size_t size() const { return size_; }
+
+private:
+    std::vector<std::uint16_t> & data_; // Storage
+    size_t size_;                       // Amount of data
+};
+
+// Reads the code lengths of a dynamic block and builds its codes. Returns false if they are invalid.
+bool readCodes(BitReader & in, Huffman & literals, Huffman & distances)
+{
+    static unsigned char const ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    unsigned const literalCount  = in.get(5) + 257;
+    unsigned const distanceCount = in.get(5) + 1;
+    unsigned const codeCount     = in.get(4) + 4;
+    if (literalCount > 286 || distanceCount > 30)
+    {
+        return false;
+    }
+
+    unsigned char lengths[286 + 30] = { 0 };
+    for (unsigned i = 0; i < codeCount; ++i)
+    {
+        lengths[ORDER[i]] = (unsigned char)in.get(3);
+    }
+
+    Huffman codes;
+    if (!codes.build(lengths, 19, true))
+    {
+        return false;
+    }
+
+    std::fill(std::begin(lengths), std::end(lengths), (unsigned char)0);
+    unsigned const total = literalCount + distanceCount;
+    for (unsigned index = 0; index < total;)
+    {
+        in.refill();
+        int const symbol = codes.decode(in);
+        if (symbol < 0)
+        {
+            return false;
+        }
+        if (symbol < 16)
+        {
+            lengths[index++] = (unsigned char)symbol;
+            continue;
+        }
+
+        unsigned char length = 0;
+        unsigned      repeat;
+        if (symbol == 16)
+        {
+            if (index == 0)
+            {
+                return false;
+            }
+            length = lengths[index - 1];
+            repeat = 3 + in.get(2);
+        }
+        else if (symbol == 17)
+        {
+            repeat = 3 + in.get(3);
+        }
+        else
+        {
+            repeat = 11 + in.get(7);
+        }
+        if (index + repeat > total)
+        {
+            return false;
+        }
+        std::fill(lengths + index, lengths + index + repeat, length);
+        index += repeat;
+    }
+
+    // The end-of-block code must exist
+    return lengths[256] != 0 &&
+           literals.build(lengths, literalCount, false) &&
+           distances.build(lengths + literalCount, distanceCount, false);
+}
+
+// Returns the codes of fixed blocks
+void fixedCodes(Huffman const * & literals, Huffman const * & distances)
+{
+    struct Fixed
+    {
+        Huffman literals;
+        Huffman distances;
+
+        Fixed()
+        {
+            unsigned char lengths[288];
+            std::fill(lengths, lengths + 144, (unsigned char)8);
+            std::fill(lengths + 144, lengths + 256, (unsigned char)9);
+            std::fill(lengths + 256, lengths + 280, (unsigned char)7);
+            std::fill(lengths + 280, lengths + 288, (unsigned char)8);
+            literals.build(lengths, 288, false);
+
+            std::fill(lengths, lengths + 30, (unsigned char)5);
+            distances.build(lengths, 30, false);
+        }
+    };
+    static Fixed const fixed;
+
+    literals  = &fixed.literals;
+    distances = &fixed.distances;
+}
+
+// Decompresses the compressed data of a block. Returns false if it is invalid.
+bool inflateBlock(BitReader & in, Huffman const & literals, Huffman const & distances, Output & output)
+{
+    for (;;)
+    {
+        in.refill();
+        output.reserve();
+        if (in.overrun())
+        {
+            return false;
+        }
+
+        int const symbol = literals.decode(in);
+        if (symbol < 256)
+        {
+            if (symbol < 0)
+            {
+                return false;
+            }
+            output.literal(unsigned(symbol));
+            continue;
+        }
+        if (symbol == 256)
+        {
+            return !in.overrun();
+        }
+
+        unsigned const lengthSymbol = unsigned(symbol) - 257;
+        if (lengthSymbol >= 29)
+        {
+            return false;
+        }
+        size_t const length = LENGTH_BASE[lengthSymbol] + in.get(LENGTH_EXTRA[lengthSymbol]);
+
+        in.refill();
+        int const distanceSymbol = distances.decode(in);
+        if (distanceSymbol < 0 || distanceSymbol >= 30)
+        {
+            return false;
+        }
+        size_t const distance = DISTANCE_BASE[distanceSymbol] + in.get(DISTANCE_EXTRA[distanceSymbol]);
+
+        if (!output.copy(distance, length) || in.overrun())
+        {
+            return false;
+        }
+    }
+}
+
+// Decompresses blocks, starting with the one at start, until a block ends at or after stop, the final block ends, or
+// the output reaches a limit. Returns false if the data is invalid.
+bool inflateBlocks(unsigned char const *       data,
+                   size_t                      size,
+                   std::uint64_t               start,
+                   std::uint64_t               stop,
+                   std::atomic<bool> const &   cancelled,
+                   std::vector<std::uint16_t> & storage,
+                   size_t &                    count,
+                   std::uint64_t &             end,
+                   bool &                      final)
+{
+    BitReader in(data, size, start);
+    Output    output(storage);
+    Huffman   literals;
+    Huffman   distances;
+
+    for (;;)
+    {
+        if (cancelled)
+        {
+            return false;
+        }
+
+        in.refill();
+        bool const     last = in.get(1) != 0;
+        unsigned const type = in.get(2);
+
+        if (type == 0)
+        {
+            // Stored block
+            in.align();
+            unsigned const length     = in.get(16);
+            unsigned const complement = in.get(16);
+            size_t const   offset     = size_t(in.position() / 8);
+            if (length != (~complement & 0xffff) || in.overrun() || offset + length > size)
+            {
+                return false;
+            }
+            output.stored(data + offset, length);
+            in.seek(std::uint64_t(offset + length) * 8);
+        }
+        else if (type == 1)
+        {
+            Huffman const * fixedLiterals;
+            Huffman const * fixedDistances;
+            fixedCodes(fixedLiterals, fixedDistances);
+            if (!inflateBlock(in, *fixedLiterals, *fixedDistances, output))
+            {
+                return false;
+            }
+        }
+        else if (type == 2)
+        {
+            if (!readCodes(in, literals, distances) || !inflateBlock(in, literals, distances, output))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+
+        if (last || in.position() >= stop || output.size() >= size_t(zspeculative::MAX_CHUNK_OUTPUT))
+        {
+            count = output.size();
+            end   = in.position();
+            final = last;
+            return true;
+        }
+    }
+}
+
+// Reads a 32-bit little-endian value
+unsigned long getLong(unsigned char const * p)
+{
+    return (unsigned long)p[0] | ((unsigned long)p[1] << 8) | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+} // anonymous namespace
+
+zspeculative::Job::Job(size_t chunk, bool known, std::uint64_t start)
+    : chunk(chunk)
+    , known(known)
+    , start(start)
+    , end(0)
+    , final(false)
+    , size(0)
+    , status(PENDING)
+    , cancelled(false)
+{
+}
+
+//! @param	threads     Number of worker threads. If 0, the number of hardware threads is used.
+//! @param	chunkSize   Amount of compressed data in each chunk. Up to about two chunks per thread are in flight, and
+//!                     each holds up to MAX_CHUNK_OUTPUT decompressed characters (two bytes each) plus one block.
+
+zspeculative::zspeculative(unsigned threads, size_t chunkSize /* = DEFAULT_CHUNK_SIZE*/)
+    : threads_((threads > 0) ? threads : std::max(std::thread::hardware_concurrency(), 1u))
+    , chunkSize_(std::max(chunkSize, size_t(64 * 1024)))
+    , maxPending_(threads_ * 2 + 1)
+    , next_(0)
+    , consumed_(0)
+    , crc_(0)
+    , size_(0)
+    , position_(0)
+    , skipped_(0)
+    , end_(false)
+    , error_(false)
+    , stop_(false)
+{
+}
+
+zspeculative::~zspeculative()
+{
+    close();
+}
+
+//!
+//! @param	name	Name of the file
+
+bool zspeculative::open(char const * name)
+{
+    if (is_open())
+    {
+        return false;
+    }
+
+    if (!mapping_.open(name) || parseHeader(0) == 0)
+    {
+        mapping_.close();
+        return false;
+    }
+
+    position_ = 0;
+    skipped_  = 0;
+    start();
+    return true;
+}
+
+bool zspeculative::close()
+{
+    if (!is_open())
+    {
+        return false;
+    }
+
+    stop();
+    mapping_.close();
+    return !error_;
+}
+
+//! @param	s   Where to put the data
+//! @param	n   Maximum number of characters to read
+
+int zspeculative::read(char_type * s, unsigned n)
+{
+    if (!is_open() || error_)
+    {
+        return -1;
+    }
+
+    n = std::min(n, unsigned(INT_MAX));
+
+    size_t total = 0;
+    while (total < n)
+    {
+        if (consumed_ < output_.size())
+        {
+            size_t const size = std::min(size_t(n) - total, output_.size() - consumed_);
+            memcpy(s + total, output_.data() + consumed_, size);
+            consumed_ += size;
+            total     += size;
+        }
+        else if (!advance())
+        {
+            break;
+        }
+    }
+
+    position_ += off_type(total);
+    return (total == 0 && error_) ? -1 : int(total);
+}
+
+//!
+//! @param	offset	Offset in the decompressed data
+
+bool zspeculative::seek(off_type offset)
+{
+    if (!is_open() || offset < 0)
+    {
+        return false;
+    }
+
+    // The blocks cannot be located without decompressing the ones before them, so go back to the beginning
+    if (offset < position_)
+    {
+        stop();
+        position_ = 0;
+        start();
+    }
+
+    std::vector<char_type> discard(SKIP_SIZE);
+    while (position_ < offset)
+    {
+        int const count = read(discard.data(), unsigned(std::min(off_type(SKIP_SIZE), offset - position_)));
+        if (count <= 0)
+        {
+            return false;
+        }
+        skipped_ += count;
+    }
+    return true;
+}
+
+//!
+//! @param	offset	Offset in the file
+
+size_t zspeculative::parseHeader(size_t offset) const
+{
+    enum
+    {
+        FHCRC    = 1 << 1,
+        FEXTRA   = 1 << 2,
+        FNAME    = 1 << 3,
+        FCOMMENT = 1 << 4
+    };
+
+    char_type const * data = mapping_.data();
+    size_t const      size = mapping_.size();
+    if (size < 10 || offset > size - 10 ||
+        data[offset] != 0x1f || data[offset + 1] != 0x8b || data[offset + 2] != Z_DEFLATED ||
+        (data[offset + 3] & 0xe0) != 0)
+    {
+        return 0;
+    }
+
+    unsigned const flags = data[offset + 3];
+    size_t         p     = offset + 10;
+    if (flags & FEXTRA)
+    {
+        if (p + 2 > size)
+        {
+            return 0;
+        }
+        p += 2 + (size_t(data[p]) | (size_t(data[p + 1]) << 8));
+    }
+    for (unsigned flag : { unsigned(FNAME), unsigned(FCOMMENT) })
+    {
+        if (flags & flag)
+        {
+            void const * zero = (p < size) ? memchr(data + p, 0, size - p) : nullptr;
+            if (!zero)
+            {
+                return 0;
+            }
+            p = size_t(static_cast<char_type const *>(zero) - data) + 1;
+        }
+    }
+    if (flags & FHCRC)
+    {
+        p += 2;
+    }
+
+    return (p < size) ? p : 0;
+}
+
+//!
+//! @param	chunk	Current chunk
+
+void zspeculative::schedule(size_t chunk)
+{
+    size_t const chunks = (mapping_.size() + chunkSize_ - 1) / chunkSize_;
+    for (size_t i = chunk + 1; i < chunks && jobs_.size() < maxPending_; ++i)
+    {
+        if (jobs_.count(i) == 0)
+        {
+            std::shared_ptr<Job> job(new Job(i, false, std::uint64_t(i) * chunkSize_ * 8));
+            jobs_[i] = job;
+            queue_.push_back(job);
+        }
+    }
+    jobReady_.notify_all();
+}
+
+bool zspeculative::advance()
+{
+    if (end_ || error_)
+    {
+        return false;
+    }
+
+    size_t const chunk = size_t(next_ / 8 / chunkSize_);
+
+    std::shared_ptr<Job> job;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        // Chunks that precede the next block are no longer needed
+        while (!jobs_.empty() && jobs_.begin()->first < chunk)
+        {
+            jobs_.begin()->second->cancelled = true;
+            jobs_.erase(jobs_.begin());
+        }
+
+        // Use the speculative job if it found the next block. Otherwise, decompress from the next block.
+        auto i = jobs_.find(chunk);
+        if (i != jobs_.end())
+        {
+            job = i->second;
+            jobDone_.wait(lock, [&job] { return job->status != PENDING; });
+        }
+        if (!job || job->status != DONE || job->start != next_)
+        {
+            if (job)
+            {
+                jobs_.erase(chunk);
+            }
+            job.reset(new Job(chunk, true, next_));
+            jobs_[chunk] = job;
+            queue_.push_front(job);
+            jobReady_.notify_one();
+            schedule(chunk);
+            jobDone_.wait(lock, [&job] { return job->status != PENDING; });
+        }
+
+        jobs_.erase(chunk);
+        schedule(chunk);
+    }
+
+    if (job->status != DONE)
+    {
+        error_ = true;
+        return false;
+    }
+
+    // Replace the markers with the data preceding the chunk
+    output_.resize(job->size);
+    std::uint16_t const * symbols = job->output.data();
+    for (size_t i = 0; i < job->size; ++i)
+    {
+        unsigned const symbol = symbols[i];
+        if (symbol < 256)
+        {
+            output_[i] = char_type(symbol);
+            continue;
+        }
+
+        size_t const distance = WINDOW_SIZE - (symbol - 256);
+        if (distance > history_.size())
+        {
+            error_ = true;      // Refers to data before the beginning of the member
+            return false;
+        }
+        output_[i] = history_[history_.size() - distance];
+    }
+    consumed_ = 0;
+
+    // Keep the last 32 KB for the next chunk
+    if (output_.size() >= WINDOW_SIZE)
+    {
+        history_.assign(output_.end() - WINDOW_SIZE, output_.end());
+    }
+    else
+    {
+        history_.insert(history_.end(), output_.begin(), output_.end());
+        if (history_.size() > WINDOW_SIZE)
+        {
+            history_.erase(history_.begin(), history_.end() - WINDOW_SIZE);
+        }
+    }
+
+    crc_  = zchecksum::crc32(uint32_t(crc_), output_.data(), output_.size());
+    size_ = (size_ + (unsigned long)output_.size()) & 0xffffffffUL;
+    next_ = job->end;
+
+    // At the end of a member, check its trailer and continue with the next member, if any
+    if (job->final)
+    {
+        size_t const trailer = size_t((next_ + 7) / 8);
+        if (trailer + 8 > mapping_.size() ||
+            getLong(mapping_.data() + trailer) != crc_ || getLong(mapping_.data() + trailer + 4) != size_)
+        {
+            error_ = true;
+            output_.clear();
+            return false;
+        }
+
+        // Like zlib, anything following the last member that is not a gzip header is ignored
+        size_t const data = parseHeader(trailer + 8);
+        if (data == 0)
+        {
+            end_ = true;
+        }
+        else
+        {
+            next_ = std::uint64_t(data) * 8;
+            history_.clear();
+            crc_  = crc32(0L, Z_NULL, 0);
+            size_ = 0;
+        }
+    }
+
+    return true;
+}
+
+//!
+//! @param	job	Job to do
+
+bool zspeculative::decompress(Job & job) const
+{
+    char_type const *   data = mapping_.data();
+    size_t const        size = mapping_.size();
+    std::uint64_t const stop = std::uint64_t(job.chunk + 1) * chunkSize_ * 8;
+
+    if (job.known)
+    {
+        return inflateBlocks(data, size, job.start, stop, job.cancelled, job.output, job.size, job.end, job.final);
+    }
+
+    // Search for the first position in the chunk where a dynamic block can be decompressed. A final block is
+    // unlikely to be useful, so they are not considered.
+    for (std::uint64_t bit = job.start; bit < stop && bit / 8 + 1 < size && !job.cancelled; ++bit)
+    {
+        size_t const   offset = size_t(bit / 8);
+        unsigned const header = ((unsigned(data[offset]) | (unsigned(data[offset + 1]) << 8)) >> (bit % 8)) & 7;
+        if (header == 4 &&
+            inflateBlocks(data, size, bit, stop, job.cancelled, job.output, job.size, job.end, job.final))
+        {
+            job.start = bit;
+            return true;
+        }
+    }
+    return false;
+}
+
+void zspeculative::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        for (auto & job : jobs_)
+        {
+            job.second->cancelled = true;
+        }
+    }
+    jobReady_.notify_all();
+    for (auto & worker : workers_)
+    {
+        worker.join();
+    }
+    workers_.clear();
+
+    jobs_.clear();
+    queue_.clear();
+    output_.clear();
+}
+
+void zspeculative::start()
+{
+    next_     = std::uint64_t(parseHeader(0)) * 8;
+    consumed_ = 0;
+    crc_      = crc32(0L, Z_NULL, 0);
+    size_     = 0;
+    end_      = false;
+    error_    = false;
+    stop_     = false;
+    history_.clear();
+    history_.reserve(WINDOW_SIZE);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        schedule(size_t(next_ / 8 / chunkSize_));
+    }
+    for (unsigned i = 0; i < threads_; ++i)
+    {
+        workers_.emplace_back(&zspeculative::worker, this);
+    }
+}
+
+void zspeculative::worker()
+{
+    for (;;)
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            jobReady_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (stop_)
+            {
+                break;
+            }
+            job = queue_.front();
+            queue_.pop_front();
+        }
+
+        bool const ok = !job->cancelled && decompress(*job);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job->status = ok ? DONE : FAILED;
+        }
+        jobDone_.notify_all();
+    }
+}
@@ -0,0 +1,64 @@
+/** @file *//********************************************************************************************************
+
+                                                  zstatsmacros.h
+
+                                            Copyright 2003, John J. Bolton
+    --------------------------------------------------------------------------------------------------------------
+
+    $Header: //depot/Libraries/zstream/zstatsmacros.h#1 $
+
+    $NoKeywords: $
+
+ *********************************************************************************************************************/
+
+#pragma once
+
+// Collects the statistics of zstats. This header is private to the library, so that the macros do not leak into the
+// users' code.
+//
+// The arguments of the macros must have no effect other than on the statistics, because they are not evaluated when
+// the statistics are disabled.
+
+#include "zstats.h"
+
+#include <chrono>
+
+#if defined(ZSTREAM_STATS) && ZSTREAM_STATS
+
+// Adds the time spent in a scope to a counter.
+class zstats_timer
+{
+public:
+    // Constructor
+    explicit zstats_timer(unsigned long long & counter)
+        : counter_(counter)
+        , start_(std::chrono::steady_clock::now())
+    {
+    }
+
+    // Destructor
+    ~zstats_timer()
+    {
+        counter_ += (unsigned long long)
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_)
+                    .count();
+    }
+
+private:
+    unsigned long long & counter_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Adds n to a statistic
+#define ZSTATS_ADD(counter, n) ((counter) += (unsigned long long)(n))
+
+// Adds the time spent in the rest of the scope to a statistic
+#define ZSTATS_TIME(counter) zstats_timer zstatsTimer_(counter)
+
+#else // defined(ZSTREAM_STATS) && ZSTREAM_STATS
+
+// The arguments are not evaluated, but they are still considered to be used
+#define ZSTATS_ADD(counter, n) ((void)sizeof((counter) += (unsigned long long)(n)))
+#define ZSTATS_TIME(counter) ((void)sizeof(counter))
+
+#endif // defined(ZSTREAM_STATS) && ZSTREAM_STATS